@@ -0,0 +1,281 @@
+#include "accuracy.h"
+#include "constants.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+namespace Accuracy {
+
+namespace {
+
+// b_crit² in units of rs², and u = rs/r of the photon sphere
+constexpr double CRITICAL_B2{27.0 / 4.0};
+constexpr double PHOTON_SPHERE_U{2.0 / 3.0};
+
+constexpr double QUADRATURE_TOLERANCE{1e-12};  // Radians of turning angle
+constexpr int QUADRATURE_PANELS{8};
+constexpr int QUADRATURE_DEPTH{40};
+
+// Adaptive Simpson on [a, b], refining halves until they agree to tolerance
+template <typename F>
+double simpson(const F& f, double a, double b, double fa, double fm, double fb, double whole,
+               double tolerance, int depth) {
+    const double m{0.5 * (a + b)};
+    const double flm{f(0.5 * (a + m))};
+    const double frm{f(0.5 * (m + b))};
+    const double left{(m - a) / 6.0 * (fa + 4.0 * flm + fm)};
+    const double right{(b - m) / 6.0 * (fm + 4.0 * frm + fb)};
+    const double delta{left + right - whole};
+    if (depth <= 0 || std::abs(delta) <= 15.0 * tolerance) {
+        return left + right + delta / 15.0;
+    }
+    return simpson(f, a, m, fa, flm, fm, left, 0.5 * tolerance, depth - 1) +
+           simpson(f, m, b, fm, frm, fb, right, 0.5 * tolerance, depth - 1);
+}
+
+// Integral of f over [a, b] to an absolute tolerance, started on a few
+// panels so that a narrow peak is not missed by the first estimate
+template <typename F>
+double integrate(const F& f, double a, double b, double tolerance) {
+    double sum{0.0};
+    const double width{(b - a) / QUADRATURE_PANELS};
+    for (int i{0}; i < QUADRATURE_PANELS; ++i) {
+        const double lo{a + i * width};
+        const double hi{i + 1 == QUADRATURE_PANELS ? b : lo + width};
+        const double flo{f(lo)};
+        const double fmid{f(0.5 * (lo + hi))};
+        const double fhi{f(hi)};
+        const double whole{(hi - lo) / 6.0 * (flo + 4.0 * fmid + fhi)};
+        sum += simpson(f, lo, hi, flo, fmid, fhi, whole, tolerance / QUADRATURE_PANELS, QUADRATURE_DEPTH);
+    }
+    return sum;
+}
+
+// (du/dφ)² = 1/b² - u² + u³ in units of rs
+double orbitPotential(double u, double b) {
+    return 1.0 / (b * b) - u * u + u * u * u;
+}
+
+// Periapsis u of a ray that turns (b > b_crit): the smallest positive
+// root, between u = 0 and the photon sphere, found by bisection
+double turningPoint(double b) {
+    double lo{0.0};
+    double hi{PHOTON_SPHERE_U};
+    for (;;) {
+        const double mid{0.5 * (lo + hi)};
+        if (mid <= lo || mid >= hi) {
+            return lo;
+        }
+        (orbitPotential(mid, b) > 0.0 ? lo : hi) = mid;
+    }
+}
+
+// Turning angle from u to the periapsis up. With 1/b² - u² + u³ =
+// (up - u) P(u) and u = up - s², the integrand 2 / sqrt(P) has no
+// singularity at the turning point.
+double toTurningPoint(double u, double up) {
+    auto f = [up](double s) {
+        const double v{up - s * s};
+        const double p{up + v - (v * v + v * up + up * up)};
+        return 2.0 / std::sqrt(p);
+    };
+    return integrate(f, 0.0, std::sqrt(std::max(up - u, 0.0)), QUADRATURE_TOLERANCE);
+}
+
+// Turning angle between u1 < u2 on a stretch without turning point
+double between(double u1, double u2, double b) {
+    auto f = [b](double u) { return 1.0 / std::sqrt(orbitPotential(u, b)); };
+    return integrate(f, u1, u2, QUADRATURE_TOLERANCE);
+}
+
+// Largest |residual| so far, where a ray that blew up counts as infinite
+void track(double& worst, double residual) {
+    worst = std::max(worst, std::isfinite(residual) ? std::abs(residual) : HUGE_VAL);
+}
+
+} // namespace
+
+double nullResidual(const Ray& ray) {
+    const double f{1.0 - BlackHole::rs / ray.r};
+    const double rvphi{ray.r * ray.v_phi};
+    return (ray.v_r * ray.v_r + f * rvphi * rvphi) / (ray.E * ray.E) - 1.0;
+}
+
+double angularMomentumDrift(const Ray& ray) {
+    if (ray.L == 0.0) {
+        return 0.0;
+    }
+    return (ray.r * ray.r * ray.v_phi - ray.L) / ray.L;
+}
+
+double weakFieldDeflection(double b, double x1, double x2) {
+    return BlackHole::rs / b * (x2 / std::hypot(x2, b) - x1 / std::hypot(x1, b));
+}
+
+double alongPath(const Ray& ray) {
+    return ray.r * std::cos(ray.phi - ray.initialVelocityAngle);
+}
+
+bool exactDeflection(const Ray& start, const Ray& end, double& deflection) {
+    if (end.isCaptured() || !std::isfinite(end.r) || start.r <= 1.5 * BlackHole::rs) {
+        return false;
+    }
+    const bool inbound{start.v_r < 0.0};
+    const bool outbound{end.v_r >= 0.0};
+    const double b{std::abs(start.L / start.E) / BlackHole::rs};
+    const double u1{BlackHole::rs / start.r};
+    const double u2{BlackHole::rs / end.r};
+
+    // Turning angle from start to end
+    double turned{0.0};
+    if (start.L != 0.0 && b * b > CRITICAL_B2) {
+        const double up{turningPoint(b)};
+        const double i1{toTurningPoint(u1, up)};
+        const double i2{toTurningPoint(u2, up)};
+        if (inbound) {
+            turned = outbound ? i1 + i2 : i1 - i2;
+        } else if (outbound) {
+            turned = i2 - i1;
+        } else {
+            return false;
+        }
+    } else if (inbound == outbound) {
+        // Without a turning point the ray keeps its radial direction
+        return false;
+    } else if (start.L != 0.0) {
+        turned = inbound ? between(u1, u2, b) : between(u2, u1, b);
+    }
+
+    // The exact state at end's radius; E and L fix the speed and direction
+    Ray exact{end};
+    const double f{1.0 - BlackHole::rs / end.r};
+    const double vr2{start.E * start.E - f * start.L * start.L / (end.r * end.r)};
+    exact.phi = start.phi + (start.L >= 0.0 ? turned : -turned);
+    exact.v_phi = start.L / (end.r * end.r);
+    exact.v_r = outbound ? std::sqrt(std::max(vr2, 0.0)) : -std::sqrt(std::max(vr2, 0.0));
+    exact.updateDeflection();
+    deflection = exact.deflection;
+    return true;
+}
+
+bool nearCritical(const Ray& ray) {
+    const double criticalB{1.5 * std::sqrt(3.0) * BlackHole::rs};
+    return std::abs(std::abs(ray.L / ray.E) / criticalB - 1.0) < Simulation::ACCURACY_CRITICAL_BAND;
+}
+
+bool Setting::operator==(const Setting& other) const {
+    if (backend != other.backend || stepSize != other.stepSize) {
+        return false;
+    }
+    if (backend == Simulation::Backend::ADAPTIVE && rtol != other.rtol) {
+        return false;
+    }
+    return backend != Simulation::Backend::GEOMETRIZED || precision == other.precision;
+}
+
+const char* Setting::integrator() const {
+    switch (backend) {
+        case Simulation::Backend::BATCH: return "batch";
+        case Simulation::Backend::ADAPTIVE: return "adaptive";
+        case Simulation::Backend::CARTESIAN: return "cartesian";
+        case Simulation::Backend::GEOMETRIZED: return "geometrized";
+        default: return "ray";
+    }
+}
+
+std::string Setting::flags() const {
+    std::ostringstream out;
+    out << "--integrator " << integrator();
+    if (backend == Simulation::Backend::GEOMETRIZED && precision == Simulation::Precision::FLOAT) {
+        out << " --precision float";
+    }
+    if (backend == Simulation::Backend::ADAPTIVE) {
+        out << " --tolerance " << rtol;
+    } else {
+        out << " --step " << stepSize;
+    }
+    return out.str();
+}
+
+Run run(const std::vector<Ray>& rays, const Simulation::Settings& base, const Setting& setting,
+        double lambda) {
+    Simulation::Settings settings{base};
+    settings.backend = setting.backend;
+    settings.precision = setting.precision;
+    settings.stepSize = setting.stepSize;
+    settings.adaptive.rtol = setting.rtol;
+
+    std::vector<Ray> started{rays};
+    for (Ray& ray : started) {
+        ray.startFrame = 0;
+    }
+    Simulation::Simulator sim{std::move(started), settings};
+
+    Run result{setting, {}, std::vector<double>(rays.size(), 0.0), std::vector<double>(rays.size(), 0.0),
+               0, 0, 0.0};
+    auto sample = [&](std::size_t id) {
+        track(result.nullDrift[id], nullResidual(sim.rays[id]));
+        track(result.angularDrift[id], angularMomentumDrift(sim.rays[id]));
+    };
+
+    // Rays leave active the step they finish; their last state is sampled
+    // from frozen
+    const long long frames{std::llround(lambda / setting.stepSize)};
+    std::size_t frozenSeen{0};
+    for (long long i{0}; i < frames && !sim.finished(); ++i) {
+        const auto start{std::chrono::steady_clock::now()};
+        sim.step();
+        result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        sim.syncAngles();
+        for (const std::size_t id : sim.active) {
+            sample(id);
+        }
+        for (; frozenSeen < sim.frozen.size(); ++frozenSeen) {
+            sample(sim.frozen[frozenSeen]);
+        }
+    }
+
+    result.steps = sim.totalSteps;
+    result.rhsEvaluations = sim.rhsEvaluations;
+    result.rays = std::move(sim.rays);
+    return result;
+}
+
+Score score(const std::vector<Ray>& rays, const Run& run, const Run& reference) {
+    Score result{0, 0, 0, 0.0, 0.0, 0.0, 0.0};
+    std::vector<double> errors;
+    for (std::size_t i{0}; i < run.rays.size(); ++i) {
+        const Ray& ray{run.rays[i]};
+        const Ray& ref{reference.rays[i]};
+        if (nearCritical(ref)) {
+            ++result.excluded;
+            continue;
+        }
+        if (ray.isCaptured() != ref.isCaptured()) {
+            ++result.fateMismatches;
+            continue;
+        }
+        if (ref.isCaptured()) {
+            continue;
+        }
+
+        ++result.compared;
+        double expected{ref.deflection};
+        exactDeflection(rays[i], ray, expected);
+        const double error{std::abs(ray.deflection - expected)};
+        errors.push_back(std::isnan(error) ? HUGE_VAL : error);
+        result.maxNullDrift = std::max(result.maxNullDrift, run.nullDrift[i]);
+        result.maxAngularDrift = std::max(result.maxAngularDrift, run.angularDrift[i]);
+    }
+    if (!errors.empty()) {
+        std::sort(errors.begin(), errors.end());
+        result.maxError = errors.back();
+        result.medianError = errors[errors.size() / 2];
+    }
+    return result;
+}
+
+} // namespace Accuracy
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ray.h"
+#include "simulation.h"
+
+// Accuracy versus cost of the Schwarzschild integrators. A photon's E and L
+// are exact constants and its state must stay on the null cone, so their
+// drift measures integration error without any reference. Deflections are
+// checked against a tight adaptive run at the same affine parameter, the
+// exact orbit (by quadrature of the orbit equation) and the first-order
+// weak-field formula.
+namespace Accuracy {
+    // (v_r² + f r² v_phi²) / E² - 1: 0 on a null geodesic, since E was
+    // derived from the starting state under that condition
+    double nullResidual(const Ray& ray);
+
+    // (r² v_phi - L) / L, the relative drift of the angular momentum;
+    // 0 for radial rays
+    double angularMomentumDrift(const Ray& ray);
+
+    // First-order deflection 2 rs / b of a full pass, restricted to the
+    // stretch of the unbent path between x1 and x2 (distances along the
+    // initial direction, measured from the point of closest approach)
+    double weakFieldDeflection(double b, double x1, double x2);
+
+    // Distance of a ray along its initial direction from the closest
+    // approach of the unbent path
+    double alongPath(const Ray& ray);
+
+    // Deflection of the exact orbit with start's E and L at end's radius,
+    // in the wrapped measure of Ray::updateDeflection: the turning angle
+    // comes from integrating dφ/du = 1 / sqrt(1/b² - u² + rs u³), u = 1/r,
+    // and the direction from the conserved quantities. False when the ray
+    // was captured, started inside the photon sphere, or reached end's
+    // radius in a way a single pass cannot (heading in again after leaving).
+    bool exactDeflection(const Ray& start, const Ray& end, double& deflection);
+
+    // Impact parameter within Simulation::ACCURACY_CRITICAL_BAND of the
+    // critical one, where orbits amplify any error without bound
+    bool nearCritical(const Ray& ray);
+
+    // One integrator setting of a sweep
+    struct Setting {
+        Simulation::Backend backend;
+        Simulation::Precision precision;
+        double stepSize;    // Affine parameter per step
+        double rtol;        // ADAPTIVE only
+
+        bool operator==(const Setting& other) const;
+
+        // --integrator name, and the command line flags selecting this setting
+        const char* integrator() const;
+        std::string flags() const;
+    };
+
+    // Rays run under one setting, with the largest |drift| each ray showed
+    struct Run {
+        Setting setting;
+        std::vector<Ray> rays;
+        std::vector<double> nullDrift;
+        std::vector<double> angularDrift;
+        long long steps;
+        long long rhsEvaluations;
+        double seconds;     // Stepping only, without drift sampling
+    };
+
+    // Start every ray at step 0 and integrate for lambda of affine
+    // parameter, so that all settings cover the same stretch of every
+    // trajectory. Drift is sampled after every step.
+    Run run(const std::vector<Ray>& rays, const Simulation::Settings& base, const Setting& setting,
+            double lambda);
+
+    // A run's deflection errors. Each ray is measured against the exact
+    // orbit at the radius it ended on, which does not depend on where the
+    // last step happened to stop; a ray without one (see exactDeflection)
+    // against the reference run at the same affine parameter. Fates come
+    // from the reference. Rays near the critical impact parameter are left
+    // out.
+    struct Score {
+        int compared;        // Rays neither run captured, outside the band
+        int excluded;        // Rays in the band
+        int fateMismatches;  // Outside the band, captured in one run only
+        double maxError;     // Deflection error in radians; NaN counts as infinite
+        double medianError;
+        double maxNullDrift;
+        double maxAngularDrift;
+
+        // Within target, with every fate right
+        bool meets(double target) const { return fateMismatches == 0 && maxError <= target; }
+    };
+
+    Score score(const std::vector<Ray>& rays, const Run& run, const Run& reference);
+}
@@ -0,0 +1,519 @@
+// Microbenchmarks for the simulation hot paths. No window or GL context is
+// needed. Results go to stdout or --output as JSON or CSV, one record per
+// case: ns per operation, operations per second and heap bytes allocated
+// per operation inside the timed loop.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "metric.h"
+#include "physics.h"
+#include "ray.h"
+#include "ray_batch.h"
+#include "simulation.h"
+#include "camera.h"
+#include "trail_index.h"
+#include "trail_store.h"
+#include "trail_vertices.h"
+
+// Count every heap allocation so cases can report bytes allocated
+namespace {
+std::atomic<std::size_t> allocatedBytes{0};
+}
+
+void* operator new(std::size_t size) {
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p{std::malloc(size ? size : 1)}) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct BenchOptions {
+    std::string format{"json"};
+    std::string output;
+    std::string filter;
+    std::size_t maxRays{1000000};
+    std::size_t maxTrail{100000};
+    double minTime{0.2};   // Seconds per case
+};
+
+struct Result {
+    std::string name;
+    std::size_t rays;
+    std::size_t trail;
+    long iterations;
+    double nsPerOp;
+    double opsPerSec;
+    double bytesPerOp;
+};
+
+// Results consumed here so the optimizer cannot drop the work
+volatile double sink{0.0};
+
+// Run fn (which performs opsPerIteration operations) until minTime has
+// passed, after one untimed warm-up call
+Result measure(const BenchOptions& options, const std::string& name, std::size_t rays,
+               std::size_t trail, std::size_t opsPerIteration, const std::function<void()>& fn) {
+    fn();
+
+    const std::size_t bytesBefore{allocatedBytes.load()};
+    const auto start{std::chrono::steady_clock::now()};
+    long iterations{0};
+    double seconds{0.0};
+    do {
+        fn();
+        ++iterations;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < options.minTime);
+    const std::size_t bytes{allocatedBytes.load() - bytesBefore};
+
+    const double ops{static_cast<double>(iterations) * static_cast<double>(opsPerIteration)};
+    Result result{name, rays, trail, iterations, 1e9 * seconds / ops, ops / seconds,
+                  static_cast<double>(bytes) / ops};
+    std::cerr << name << " rays=" << rays << " trail=" << trail << ": "
+              << result.nsPerOp << " ns/op, " << result.bytesPerOp << " B/op\n";
+    return result;
+}
+
+// Beam rays with impact parameters well above critical: never captured, so
+// every call does real work however long the case runs
+std::vector<Ray> makeRays(std::size_t count) {
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (std::size_t i{0}; i < count; ++i) {
+        const double t{count > 1 ? static_cast<double>(i) / static_cast<double>(count - 1) : 0.5};
+        const double y{5e10 + t * 2.5e10};
+        rays.emplace_back(Visual::PARALLEL_START_X, y, Physics::c, 0.0);
+        rays.back().trailSlot = i;
+    }
+    return rays;
+}
+
+// A curving path (slow spiral) typical of a bent trail
+std::vector<glm::vec2> makePath(std::size_t length) {
+    std::vector<glm::vec2> path;
+    path.reserve(length);
+    for (std::size_t i{0}; i < length; ++i) {
+        const double angle{1e-3 * static_cast<double>(i)};
+        const double radius{5e10 * (1.0 - 2e-6 * static_cast<double>(i))};
+        path.push_back(glm::vec2(static_cast<float>(radius * std::cos(angle)),
+                                 static_cast<float>(radius * std::sin(angle))));
+    }
+    return path;
+}
+
+bool selected(const BenchOptions& options, const std::string& name) {
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+void benchIntegrators(const BenchOptions& options, std::size_t n, std::vector<Result>& results) {
+    const double noEscape{1e300};
+
+    if (selected(options, "geodesicRHS")) {
+        const std::vector<Ray> rays{makeRays(n)};
+        results.push_back(measure(options, "geodesicRHS", n, 0, n, [&] {
+            double rhs[4];
+            double total{0.0};
+            for (const auto& ray : rays) {
+                Physics::geodesicRHS(ray, rhs);
+                total += rhs[2];
+            }
+            sink = total;
+        }));
+    }
+
+    if (selected(options, "geodesicRHSCartesian")) {
+        const std::vector<Ray> rays{makeRays(n)};
+        std::vector<Physics::CartesianState> states;
+        for (const auto& ray : rays) {
+            states.push_back(Physics::toCartesian(ray));
+        }
+        results.push_back(measure(options, "geodesicRHSCartesian", n, 0, n, [&] {
+            double rhs[4];
+            double total{0.0};
+            for (std::size_t i{0}; i < states.size(); ++i) {
+                const double y[4]{states[i].x, states[i].y, states[i].vx, states[i].vy};
+                Physics::geodesicRHSCartesian(y, rays[i].E, rhs);
+                total += rhs[2];
+            }
+            sink = total;
+        }));
+    }
+
+    if (selected(options, "rk4Step")) {
+        std::vector<Ray> rays{makeRays(n)};
+        results.push_back(measure(options, "rk4Step", n, 0, n, [&] {
+            for (auto& ray : rays) {
+                Physics::rk4Step(ray, Simulation::INTEGRATION_STEP);
+            }
+        }));
+    }
+
+    // The same step in each metric policy, statically dispatched
+    auto benchMetric = [&](const char* name, const auto& metric) {
+        if (!selected(options, name)) {
+            return;
+        }
+        std::vector<Ray> rays{makeRays(n)};
+        for (Ray& ray : rays) {
+            metric.constants(ray, ray.E, ray.L);
+        }
+        results.push_back(measure(options, name, n, 0, n, [&] {
+            for (auto& ray : rays) {
+                Physics::rk4Step(ray, Simulation::INTEGRATION_STEP, metric);
+            }
+        }));
+    };
+    Physics::MetricSettings metricSettings;
+    metricSettings.charge = 0.5;
+    metricSettings.spin = 0.5;
+    benchMetric("rk4Step/schwarzschild", Physics::Schwarzschild{metricSettings});
+    benchMetric("rk4Step/reissner-nordstrom", Physics::ReissnerNordstrom{metricSettings});
+    benchMetric("rk4Step/kerr", Physics::KerrEquatorial{metricSettings});
+    benchMetric("rk4Step/flat", Physics::Flat{metricSettings});
+
+    for (const char* kernel : {"scalar", "avx2", "avx512"}) {
+        const std::string name{std::string("rk4StepBatch/") + kernel};
+        if (!selected(options, name) || !Physics::setBatchKernel(kernel)) {
+            continue;
+        }
+        RayBatch batch{RayBatch::fromRays(makeRays(n))};
+        std::vector<unsigned char> stepped;
+        results.push_back(measure(options, name, n, 0, n, [&] {
+            Physics::rk4StepBatch(batch, Simulation::INTEGRATION_STEP, noEscape, 0, stepped);
+        }));
+    }
+
+    // Geometrized kernels: float packs twice the lanes of double
+    auto benchGeo = [&](auto& batch, const char* precision, const char* kernel) {
+        const std::string name{std::string("geoStepBatch/") + precision + "/" + kernel};
+        if (!selected(options, name) || !Physics::setBatchKernel(kernel)) {
+            return;
+        }
+        for (const Ray& ray : makeRays(n)) {
+            batch.push(ray, batch.size());
+        }
+        std::vector<unsigned char> stepped(batch.size());
+        results.push_back(measure(options, name, n, 0, n, [&] {
+            Physics::rk4StepBatch(batch, Simulation::INTEGRATION_STEP / Units::AFFINE, noEscape, 0,
+                                  stepped.data(), 0, batch.size());
+        }));
+    };
+    for (const char* kernel : {"scalar", "avx2", "avx512"}) {
+        GeoBatch<double> geoDouble;
+        benchGeo(geoDouble, "double", kernel);
+        GeoBatch<float> geoFloat;
+        benchGeo(geoFloat, "float", kernel);
+    }
+    Physics::setBatchKernel("auto");
+
+    for (const TrailPolicy policy : {TrailPolicy::RING, TrailPolicy::DECIMATE}) {
+        const std::string name{policy == TrailPolicy::RING ? "Ray::integrate/ring" : "Ray::integrate/decimate"};
+        if (!selected(options, name)) {
+            continue;
+        }
+        TrailSettings settings;
+        settings.policy = policy;
+        settings.capacity = 16;
+        TrailStore trails{n, settings};
+        std::vector<Ray> rays{makeRays(n)};
+        int frame{0};
+        results.push_back(measure(options, name, n, 0, n, [&] {
+            for (auto& ray : rays) {
+                ray.integrate(Simulation::INTEGRATION_STEP, noEscape, frame, trails);
+            }
+            ++frame;
+        }));
+    }
+
+    // The CARTESIAN backend's per-step work: step and trail point, with
+    // angles left to storePolar
+    for (const TrailPolicy policy : {TrailPolicy::RING, TrailPolicy::DECIMATE}) {
+        const std::string name{policy == TrailPolicy::RING ? "cartesian/ring" : "cartesian/decimate"};
+        if (!selected(options, name)) {
+            continue;
+        }
+        TrailSettings settings;
+        settings.policy = policy;
+        settings.capacity = 16;
+        TrailStore trails{n, settings};
+        std::vector<Ray> rays{makeRays(n)};
+        std::vector<Physics::CartesianState> states;
+        for (const auto& ray : rays) {
+            states.push_back(Physics::toCartesian(ray));
+        }
+        results.push_back(measure(options, name, n, 0, n, [&] {
+            for (std::size_t i{0}; i < rays.size(); ++i) {
+                Physics::CartesianState& state{states[i]};
+                rays[i].r = Physics::rk4StepCartesian(state, rays[i].E, Simulation::INTEGRATION_STEP);
+                trails.push(i, glm::vec2(static_cast<float>(state.x), static_cast<float>(state.y)));
+            }
+        }));
+    }
+
+    if (selected(options, "storePolar")) {
+        std::vector<Ray> rays{makeRays(n)};
+        std::vector<Physics::CartesianState> states;
+        for (const auto& ray : rays) {
+            states.push_back(Physics::toCartesian(ray));
+        }
+        results.push_back(measure(options, "storePolar", n, 0, n, [&] {
+            for (std::size_t i{0}; i < rays.size(); ++i) {
+                Physics::storePolar(states[i], rays[i]);
+            }
+        }));
+    }
+
+    if (selected(options, "Ray::recordPosition")) {
+        TrailSettings settings;
+        settings.policy = TrailPolicy::RING;
+        settings.capacity = 16;
+        TrailStore trails{n, settings};
+        const std::vector<Ray> rays{makeRays(n)};
+        results.push_back(measure(options, "Ray::recordPosition", n, 0, n, [&] {
+            for (const auto& ray : rays) {
+                ray.recordPosition(trails);
+            }
+        }));
+    }
+
+    if (selected(options, "Ray::updateDeflection")) {
+        std::vector<Ray> rays{makeRays(n)};
+        results.push_back(measure(options, "Ray::updateDeflection", n, 0, n, [&] {
+            for (auto& ray : rays) {
+                ray.updateDeflection();
+            }
+        }));
+    }
+}
+
+// Recycling a full pool: rays beyond the escape distance, heading out, so
+// each spawned burst finishes on its first step and frees its slots for the
+// next. Reported per ray, spawn and the retiring step together.
+void benchSpawn(const BenchOptions& options, std::size_t n, std::vector<Result>& results) {
+    if (!selected(options, "Simulator::spawn")) {
+        return;
+    }
+    std::vector<Ray> burst;
+    burst.reserve(n);
+    for (std::size_t i{0}; i < n; ++i) {
+        const double angle{6.2831853 * static_cast<double>(i) / static_cast<double>(n)};
+        const double r{2.0 * Simulation::MAX_DISTANCE};
+        burst.emplace_back(r * std::cos(angle), r * std::sin(angle),
+                           Physics::c * std::cos(angle), Physics::c * std::sin(angle));
+    }
+    Simulation::Simulator sim{burst};
+    sim.step();
+    results.push_back(measure(options, "Simulator::spawn/recycle", n, 0, n, [&] {
+        sink = static_cast<double>(sim.spawn(burst));
+        sim.step();
+    }));
+}
+
+void benchTrails(const BenchOptions& options, std::size_t length, std::vector<Result>& results) {
+    const std::vector<glm::vec2> path{makePath(length)};
+
+    for (const TrailPolicy policy : {TrailPolicy::RING, TrailPolicy::DECIMATE}) {
+        const std::string name{policy == TrailPolicy::RING ? "TrailStore::push/ring" : "TrailStore::push/decimate"};
+        if (!selected(options, name)) {
+            continue;
+        }
+        TrailSettings settings;
+        settings.policy = policy;
+        settings.capacity = length;
+        TrailStore trails{1, settings};
+        results.push_back(measure(options, name, 1, length, length, [&] {
+            trails.clear(0);
+            for (const glm::vec2 p : path) {
+                trails.push(0, p);
+            }
+        }));
+    }
+
+    // Vertex building for the immediate-mode path: up to 10^7 vertices
+    if (selected(options, "buildTrailVertices")) {
+        for (std::size_t n{100}; n <= options.maxRays && n * length <= 10000000; n *= 100) {
+            TrailSettings settings;
+            settings.policy = TrailPolicy::RING;
+            settings.capacity = length;
+            TrailStore trails{n, settings};
+            const std::vector<Ray> rays{makeRays(n)};
+            for (std::size_t slot{0}; slot < n; ++slot) {
+                for (const glm::vec2 p : path) {
+                    trails.push(slot, p);
+                }
+            }
+            Rendering::TrailVertices vertices;
+            results.push_back(measure(options, "buildTrailVertices", n, length, n * length, [&] {
+                Rendering::buildTrailVertices(rays, trails, 0, vertices);
+            }));
+        }
+    }
+
+    // The same trails culled and thinned through the index, from the whole
+    // scene to a deep zoom on one stretch of them. Reported per stored
+    // point, so the ratio to buildTrailVertices is the saving.
+    if (selected(options, "TrailIndex") || selected(options, "buildTrailVertices/")) {
+        for (std::size_t n{100}; n <= options.maxRays && n * length <= 10000000; n *= 100) {
+            TrailSettings settings;
+            settings.policy = TrailPolicy::RING;
+            settings.capacity = length;
+            TrailStore trails{n, settings};
+            const std::vector<Ray> rays{makeRays(n)};
+            for (std::size_t slot{0}; slot < n; ++slot) {
+                // Spread the trails around the hole
+                const float angle{6.2831853f * static_cast<float>(slot) / static_cast<float>(n)};
+                const float c{std::cos(angle)};
+                const float s{std::sin(angle)};
+                for (const glm::vec2 p : path) {
+                    trails.push(slot, glm::vec2(c * p.x - s * p.y, s * p.x + c * p.y));
+                }
+            }
+
+            if (selected(options, "TrailIndex::update")) {
+                results.push_back(measure(options, "TrailIndex::update", n, length, n * length, [&] {
+                    Rendering::TrailIndex index{trails};
+                    for (std::size_t slot{0}; slot < n; ++slot) {
+                        index.update(trails, slot);
+                    }
+                }));
+            }
+
+            Rendering::TrailIndex index{trails};
+            for (std::size_t slot{0}; slot < n; ++slot) {
+                index.update(trails, slot);
+            }
+            for (const double zoom : {1.0, 16.0, 256.0}) {
+                Rendering::Camera camera;
+                camera.look(glm::dvec2(5e10, 0.0), zoom);
+                const Rendering::View view{camera.view(Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT, Visual::WINDOW_WIDTH)};
+                const std::string suffix{"/zoom-" + std::to_string(static_cast<int>(zoom))};
+
+                std::vector<Rendering::ChunkRef> chunks;
+                if (selected(options, "TrailIndex::query" + suffix)) {
+                    results.push_back(measure(options, "TrailIndex::query" + suffix, n, length, n * length, [&] {
+                        chunks.clear();
+                        index.query(view, chunks);
+                        sink = static_cast<double>(chunks.size());
+                    }));
+                }
+
+                Rendering::TrailVertices vertices;
+                const std::string name{"buildTrailVertices/culled" + suffix};
+                if (selected(options, name)) {
+                    results.push_back(measure(options, name, n, length, n * length, [&] {
+                        Rendering::buildTrailVertices(rays, trails, 0, index, view, vertices);
+                    }));
+                    std::cerr << "  kept " << vertices.positions.size() << " of " << n * length << " points\n";
+                }
+            }
+        }
+    }
+}
+
+bool writeResults(const std::vector<Result>& results, const BenchOptions& options, std::ostream& out) {
+    out.precision(6);
+    if (options.format == "csv") {
+        out << "name,rays,trail,iterations,ns_per_op,ops_per_sec,bytes_per_op\n";
+        for (const auto& r : results) {
+            out << r.name << ',' << r.rays << ',' << r.trail << ',' << r.iterations << ','
+                << r.nsPerOp << ',' << r.opsPerSec << ',' << r.bytesPerOp << '\n';
+        }
+    } else {
+        out << "{\n  \"kernel\": \"" << Physics::batchKernelName() << "\",\n  \"benchmarks\": [\n";
+        for (std::size_t i{0}; i < results.size(); ++i) {
+            const Result& r{results[i]};
+            out << "    {\"name\": \"" << r.name << "\", \"rays\": " << r.rays
+                << ", \"trail\": " << r.trail << ", \"iterations\": " << r.iterations
+                << ", \"ns_per_op\": " << r.nsPerOp << ", \"ops_per_sec\": " << r.opsPerSec
+                << ", \"bytes_per_op\": " << r.bytesPerOp << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+    return static_cast<bool>(out);
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --format F      json or csv (default json)\n"
+              << "  --output FILE   Write results to FILE instead of stdout\n"
+              << "  --filter NAME   Only run cases whose name contains NAME\n"
+              << "  --max-rays N    Largest ray count (default 1000000)\n"
+              << "  --max-trail N   Longest trail (default 100000)\n"
+              << "  --min-time S    Seconds per case (default 0.2)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i{1}; i < argc; ++i) {
+        const char* arg{argv[i]};
+        const bool hasValue{i + 1 < argc};
+        if (std::strcmp(arg, "--format") == 0 && hasValue) {
+            options.format = argv[++i];
+        } else if (std::strcmp(arg, "--output") == 0 && hasValue) {
+            options.output = argv[++i];
+        } else if (std::strcmp(arg, "--filter") == 0 && hasValue) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(arg, "--max-rays") == 0 && hasValue) {
+            options.maxRays = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(arg, "--max-trail") == 0 && hasValue) {
+            options.maxTrail = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(arg, "--min-time") == 0 && hasValue) {
+            options.minTime = std::atof(argv[++i]);
+        } else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            std::cerr << "Unknown or incomplete option: " << arg << "\n";
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (options.format != "json" && options.format != "csv") {
+        std::cerr << "Unknown format: " << options.format << "\n";
+        return -1;
+    }
+
+    std::vector<Result> results;
+    for (std::size_t n{100}; n <= options.maxRays; n *= 10) {
+        benchIntegrators(options, n, results);
+        benchSpawn(options, n, results);
+    }
+    for (std::size_t length{100}; length <= options.maxTrail; length *= 10) {
+        benchTrails(options, length, results);
+    }
+
+    if (options.output.empty()) {
+        return writeResults(results, options, std::cout) ? 0 : -1;
+    }
+    std::ofstream out(options.output);
+    if (!out || !writeResults(results, options, out)) {
+        std::cerr << "Failed to write " << options.output << "\n";
+        return -1;
+    }
+    return 0;
+}
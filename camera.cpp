@@ -0,0 +1,45 @@
+#include "camera.h"
+#include "constants.h"
+#include <algorithm>
+
+namespace Rendering {
+
+Camera::Camera() : center{0.0, 0.0}, zoom{1.0} {
+}
+
+void Camera::look(glm::dvec2 target, double targetZoom) {
+    // Keep the center over the region trails can reach
+    const double limit{Simulation::MAX_DISTANCE};
+    center = glm::clamp(target, glm::dvec2(-limit), glm::dvec2(limit));
+    zoom = std::max(Visual::MIN_ZOOM, std::min(targetZoom, Visual::MAX_ZOOM));
+}
+
+void Camera::zoomAt(glm::dvec2 anchor, double factor) {
+    const double previous{zoom};
+    look(center, zoom * factor);
+    look(anchor + (center - anchor) * (previous / zoom), zoom);
+}
+
+void Camera::pan(glm::dvec2 offset) {
+    look(center + offset, zoom);
+}
+
+void Camera::reset() {
+    center = glm::dvec2(0.0, 0.0);
+    zoom = 1.0;
+}
+
+glm::dvec2 Camera::halfExtents(float halfWidth, float halfHeight) const {
+    return glm::dvec2(halfWidth, halfHeight) / zoom;
+}
+
+View Camera::view(float halfWidth, float halfHeight, int pixelWidth) const {
+    const glm::dvec2 half{halfExtents(halfWidth, halfHeight)};
+    View out;
+    out.lo = glm::vec2(center - half);
+    out.hi = glm::vec2(center + half);
+    out.pixel = pixelWidth > 0 ? static_cast<float>(2.0 * half.x / pixelWidth) : 0.0f;
+    return out;
+}
+
+} // namespace Rendering
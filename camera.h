@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "trail_index.h"
+
+namespace Rendering {
+    // Pan and zoom over the simulation plane. The view is centered on
+    // center and shows the frame's base half extents divided by zoom.
+    struct Camera {
+        glm::dvec2 center;   // Meters
+        double zoom;         // 1 = the default view
+
+        Camera();
+
+        // Look at center with zoom, both clamped to the allowed range
+        void look(glm::dvec2 center, double zoom);
+
+        // Multiply zoom by factor, keeping the plane point anchor where it is
+        // on screen
+        void zoomAt(glm::dvec2 anchor, double factor);
+
+        // Move the view by offset meters
+        void pan(glm::dvec2 offset);
+
+        // Back to the default view
+        void reset();
+
+        // Visible half extents for the frame's base half extents
+        glm::dvec2 halfExtents(float halfWidth, float halfHeight) const;
+
+        // Visible rectangle and pixel size for a frame pixelWidth pixels wide
+        View view(float halfWidth, float halfHeight, int pixelWidth) const;
+    };
+}
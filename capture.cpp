@@ -0,0 +1,93 @@
+#include "capture.h"
+#include "constants.h"
+#include "offscreen.h"
+#include "profiler.h"
+#include "video_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace Capture {
+
+int run(Rendering::RenderEngine& engine, const Options& options) {
+    const int width{options.captureWidth};
+    const int height{options.captureHeight};
+    Rendering::OffscreenTarget target{width, height};
+    if (!target.ready()) {
+        return -1;
+    }
+    VideoWriter writer{options.capture, width, height, options.captureFps,
+                       static_cast<std::size_t>(Visual::CAPTURE_QUEUE_DEPTH)};
+    if (!writer.ok()) {
+        return -1;
+    }
+
+    // The smallest view with the frame's aspect ratio that contains the
+    // window's, with the star field widened to fill it
+    const float aspect{static_cast<float>(width) / static_cast<float>(height)};
+    const float viewWidth{std::max(Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT * aspect)};
+    const float viewHeight{viewWidth / aspect};
+    const double frameTime{1.0 / options.captureFps};
+    engine.coverStars(viewWidth, viewHeight);
+
+    std::cout << "Capturing " << options.captureFrames << " frames at " << width << "x" << height
+              << ", " << options.captureFps << " fps\n";
+
+    // Hand the oldest frame read back to the writer; waits only if the
+    // writer's queue is full
+    bool readable{true};
+    auto collect = [&]() {
+        PROFILE_SCOPE("capture/collect");
+        readable = target.collect(writer.acquire()) && readable;
+        writer.submit();
+    };
+
+    const auto start{std::chrono::steady_clock::now()};
+    long long steps{0};
+    int frames{0};
+    for (; frames < options.captureFrames && readable; ++frames) {
+        target.bind();
+        engine.beginFrame(viewWidth, viewHeight);
+        steps += engine.advance(frameTime);
+        engine.drawFrame();
+
+        if (target.pending() == Rendering::OffscreenTarget::PIXEL_BUFFERS) {
+            collect();
+        }
+        target.read();
+        PROFILE_FRAME();
+
+        if ((frames + 1) % Simulation::PROGRESS_INTERVAL == 0) {
+            std::cout << "Captured " << frames + 1 << " / " << options.captureFrames << " frames\n";
+        }
+    }
+    while (target.pending() > 0) {
+        collect();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    const double renderSeconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+
+    const bool written{writer.close()};
+    const double seconds{std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+    if (!readable) {
+        std::cerr << "Failed to read back frame " << frames << "\n";
+    }
+
+    // Backpressure: time the render loop waited for the writer to free a buffer
+    const WriterStats stats{writer.stats()};
+    const double framesPerSec{seconds > 0.0 ? static_cast<double>(stats.frames) / seconds : 0.0};
+    const double encodeMs{stats.frames > 0 ? 1000.0 * stats.encodeSeconds / static_cast<double>(stats.frames) : 0.0};
+    std::cout << "Frames:     " << stats.frames << "\n"
+              << "Steps:      " << steps << "\n"
+              << "Elapsed:    " << seconds << " s (rendering " << renderSeconds << " s)\n"
+              << "Frames/sec: " << framesPerSec << "\n"
+              << "Encode:     " << encodeMs << " ms/frame on the writer thread\n"
+              << "Queue peak: " << stats.maxQueued << " / " << Visual::CAPTURE_QUEUE_DEPTH << " frames\n"
+              << "Stalls:     " << stats.stalls << " (" << stats.stallSeconds << " s waiting for the writer)\n";
+    if (stats.stalls > 0) {
+        std::cout << "Writer-bound: the encoder or disk is slower than rendering\n";
+    }
+    return written && readable ? 0 : -1;
+}
+
+} // namespace Capture
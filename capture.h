@@ -0,0 +1,16 @@
+#pragma once
+
+#include "options.h"
+#include "rendering.h"
+
+// Offscreen video capture.
+// Renders options.captureFrames frames of the engine's scene into an
+// offscreen target at the capture resolution, advancing the simulation by
+// exactly 1 / captureFps seconds of clock time per frame, and streams them
+// through a VideoWriter. The window may stay hidden; only its GL context is
+// used, so a software context works too.
+namespace Capture {
+    // Capture and print the achieved frames/sec and writer backpressure;
+    // returns the process exit code
+    int run(Rendering::RenderEngine& engine, const Options& options);
+}
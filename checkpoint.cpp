@@ -0,0 +1,527 @@
+#include "checkpoint.h"
+#include "metric.h"
+#include "profiler.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace Checkpoint {
+
+namespace {
+
+constexpr char MAGIC[8]{'B', 'H', 'C', 'K', 'P', 'T', '0', '1'};
+constexpr char END_MAGIC[8]{'B', 'H', 'C', 'K', 'E', 'N', 'D', '1'};
+constexpr std::uint32_t VERSION{2};
+
+// File I/O buffer; snapshots are written and read in large sequential runs
+constexpr std::size_t IO_BUFFER{1 << 20};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t backend;
+    double stepSize;
+    std::uint64_t rayCount;
+    std::uint64_t pendingCount;
+    std::uint64_t activeCount;
+    std::uint64_t frozenCount;
+    std::int64_t totalSteps;
+    std::int64_t rhsEvaluations;
+    std::int32_t frame;
+    std::uint32_t seed;
+    double rtol;
+    double minStep;
+    double maxStep;
+    std::uint64_t trailCapacity;
+    std::uint32_t trailPolicy;
+    float trailTolerance;
+    std::uint32_t metric;
+    std::uint32_t reserved;
+    double charge;
+    double spin;
+};
+
+struct RayRecord {
+    double r;
+    double phi;
+    double v_r;
+    double v_phi;
+    double E;
+    double L;
+    double initialVelocityAngle;
+    double deflection;
+    std::uint64_t trailSlot;
+    std::int32_t startFrame;
+    std::uint8_t scenario;
+    std::uint8_t reserved[3];
+};
+
+struct AdaptiveRecord {
+    std::uint8_t started;
+    std::uint8_t captured;
+    std::uint8_t reserved[6];
+    double lambda;
+    double lambdaPrev;
+    double frameLambda;
+    double captureLambda;
+    double h;
+    double y[4];
+    double k1[4];
+    double cont[5][4];
+};
+
+// GEOMETRIZED backend: the precision once, then one GeoRecord per active ray
+// in batch order. Float state is stored widened, which is exact.
+struct GeoHeader {
+    std::uint32_t precision;
+    std::uint32_t reserved;
+};
+
+struct GeoRecord {
+    double r;
+    double phi;
+    double v_r;
+    double v_phi;
+    double E;
+};
+
+static_assert(sizeof(FileHeader) == 144, "checkpoint header layout");
+static_assert(sizeof(RayRecord) == 80, "checkpoint ray layout");
+static_assert(sizeof(AdaptiveRecord) == 272, "checkpoint solver layout");
+static_assert(sizeof(Physics::CartesianState) == 48, "checkpoint Cartesian layout");
+static_assert(sizeof(GeoRecord) == 40, "checkpoint geometrized layout");
+
+// Copy a geometrized batch between precisions
+template <typename From, typename To>
+void copyGeo(const GeoBatch<From>& from, GeoBatch<To>& to) {
+    to.r.assign(from.r.begin(), from.r.end());
+    to.phi.assign(from.phi.begin(), from.phi.end());
+    to.v_r.assign(from.v_r.begin(), from.v_r.end());
+    to.v_phi.assign(from.v_phi.begin(), from.v_phi.end());
+    to.E.assign(from.E.begin(), from.E.end());
+    to.startFrame = from.startFrame;
+    to.ids = from.ids;
+}
+
+bool writeIds(std::FILE* file, const std::vector<std::size_t>& ids) {
+    std::vector<std::uint64_t> out(ids.begin(), ids.end());
+    return std::fwrite(out.data(), sizeof(std::uint64_t), out.size(), file) == out.size();
+}
+
+bool readIds(std::FILE* file, std::size_t count, std::size_t rayCount, std::vector<std::size_t>& ids) {
+    std::vector<std::uint64_t> in(count);
+    if (std::fread(in.data(), sizeof(std::uint64_t), count, file) != count) {
+        return false;
+    }
+    ids.resize(count);
+    for (std::size_t i{0}; i < count; ++i) {
+        if (in[i] >= rayCount) {
+            return false;
+        }
+        ids[i] = static_cast<std::size_t>(in[i]);
+    }
+    return true;
+}
+
+} // namespace
+
+Snapshot::Snapshot() : frame{0}, totalSteps{0}, rhsEvaluations{0} {
+}
+
+void Snapshot::take(const Simulation::Simulator& sim) {
+    PROFILE_SCOPE("Checkpoint::take");
+    settings.backend = sim.backend;
+    settings.stepSize = sim.stepSize;
+    settings.adaptive = sim.adaptiveSettings;
+    settings.trails = sim.trails.settings;
+    settings.seed = sim.seed;
+    settings.precision = sim.precision;
+    settings.metric = Physics::activeMetric();
+    frame = sim.frame;
+    totalSteps = sim.totalSteps;
+    rhsEvaluations = sim.rhsEvaluations;
+
+    // Copy-assignment keeps capacity, so repeated checkpoints do not allocate
+    rays = sim.rays;
+    pending = sim.pending;
+    active = sim.active;
+    frozen = sim.frozen;
+    adaptive = sim.adaptive;
+    cartesian = sim.cartesian;
+    geometrized.clear();
+    if (sim.backend == Simulation::Backend::GEOMETRIZED) {
+        if (sim.precision == Simulation::Precision::FLOAT) {
+            copyGeo(sim.geoFloat, geometrized);
+        } else {
+            geometrized = sim.geoDouble;
+        }
+    }
+    trails = sim.trails;
+}
+
+bool save(const std::string& path, const Snapshot& snapshot) {
+    PROFILE_SCOPE("Checkpoint::save");
+    const std::string temp{path + ".tmp"};
+    std::FILE* file{std::fopen(temp.c_str(), "wb")};
+    if (!file) {
+        std::cerr << "Failed to open " << temp << " for writing\n";
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, IO_BUFFER);
+
+    const Simulation::Settings& settings{snapshot.settings};
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.backend = static_cast<std::uint32_t>(settings.backend);
+    header.stepSize = settings.stepSize;
+    header.rayCount = snapshot.rays.size();
+    header.pendingCount = snapshot.pending.size();
+    header.activeCount = snapshot.active.size();
+    header.frozenCount = snapshot.frozen.size();
+    header.totalSteps = snapshot.totalSteps;
+    header.rhsEvaluations = snapshot.rhsEvaluations;
+    header.frame = snapshot.frame;
+    header.seed = settings.seed;
+    header.rtol = settings.adaptive.rtol;
+    header.minStep = settings.adaptive.minStep;
+    header.maxStep = settings.adaptive.maxStep;
+    header.trailCapacity = snapshot.trails.settings.capacity;
+    header.trailPolicy = static_cast<std::uint32_t>(snapshot.trails.settings.policy);
+    header.trailTolerance = snapshot.trails.settings.tolerance;
+    header.metric = static_cast<std::uint32_t>(settings.metric.kind);
+    header.charge = settings.metric.charge;
+    header.spin = settings.metric.spin;
+    bool ok{std::fwrite(&header, sizeof(header), 1, file) == 1};
+
+    std::vector<RayRecord> rays(snapshot.rays.size());
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        const Ray& ray{snapshot.rays[i]};
+        rays[i] = RayRecord{ray.r, ray.phi, ray.v_r, ray.v_phi, ray.E, ray.L,
+                            ray.initialVelocityAngle, ray.deflection, ray.trailSlot, ray.startFrame,
+                            static_cast<std::uint8_t>(ray.scenario), {}};
+    }
+    ok = ok && std::fwrite(rays.data(), sizeof(RayRecord), rays.size(), file) == rays.size();
+    ok = ok && writeIds(file, snapshot.pending) && writeIds(file, snapshot.active) &&
+         writeIds(file, snapshot.frozen);
+
+    if (settings.backend == Simulation::Backend::ADAPTIVE) {
+        std::vector<AdaptiveRecord> states(snapshot.adaptive.size());
+        for (std::size_t i{0}; i < states.size(); ++i) {
+            const Physics::AdaptiveState& s{snapshot.adaptive[i]};
+            AdaptiveRecord& r{states[i]};
+            r = AdaptiveRecord{};
+            r.started = s.started;
+            r.captured = s.captured;
+            r.lambda = s.lambda;
+            r.lambdaPrev = s.lambdaPrev;
+            r.frameLambda = s.frameLambda;
+            r.captureLambda = s.captureLambda;
+            r.h = s.h;
+            std::memcpy(r.y, s.y, sizeof(r.y));
+            std::memcpy(r.k1, s.k1, sizeof(r.k1));
+            std::memcpy(r.cont, s.cont, sizeof(r.cont));
+        }
+        ok = ok && std::fwrite(states.data(), sizeof(AdaptiveRecord), states.size(), file) == states.size();
+    }
+    if (settings.backend == Simulation::Backend::CARTESIAN) {
+        const std::vector<Physics::CartesianState>& states{snapshot.cartesian};
+        ok = ok && std::fwrite(states.data(), sizeof(Physics::CartesianState), states.size(), file) == states.size();
+    }
+    if (settings.backend == Simulation::Backend::GEOMETRIZED) {
+        const GeoBatch<double>& geo{snapshot.geometrized};
+        const GeoHeader geoHeader{static_cast<std::uint32_t>(settings.precision), 0};
+        std::vector<GeoRecord> states(geo.size());
+        for (std::size_t i{0}; i < states.size(); ++i) {
+            states[i] = GeoRecord{geo.r[i], geo.phi[i], geo.v_r[i], geo.v_phi[i], geo.E[i]};
+        }
+        ok = ok && std::fwrite(&geoHeader, sizeof(geoHeader), 1, file) == 1;
+        ok = ok && std::fwrite(states.data(), sizeof(GeoRecord), states.size(), file) == states.size();
+    }
+
+    ok = ok && snapshot.trails.write(file);
+    ok = ok && std::fwrite(END_MAGIC, sizeof(END_MAGIC), 1, file) == 1;
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Failed to write " << temp << "\n";
+        std::remove(temp.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to replace " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool load(const std::string& path, Snapshot& snapshot) {
+    std::FILE* file{std::fopen(path.c_str(), "rb")};
+    if (!file) {
+        std::cerr << "Failed to open checkpoint " << path << "\n";
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, IO_BUFFER);
+
+    auto fail = [&](const char* reason) {
+        std::cerr << "Checkpoint " << path << " " << reason << "\n";
+        std::fclose(file);
+        return false;
+    };
+
+    FileHeader header{};
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        return fail("is not a checkpoint");
+    }
+    if (header.version != VERSION) {
+        return fail("was written by another version");
+    }
+    if (header.backend > static_cast<std::uint32_t>(Simulation::Backend::GEOMETRIZED) ||
+        header.trailPolicy > static_cast<std::uint32_t>(TrailPolicy::DECIMATE) ||
+        header.metric > static_cast<std::uint32_t>(Physics::MetricKind::FLAT) ||
+        header.pendingCount + header.activeCount + header.frozenCount != header.rayCount ||
+        header.trailCapacity < 2 || header.frame < 0 || !(header.stepSize > 0.0)) {
+        return fail("is inconsistent");
+    }
+    const std::size_t rayCount{static_cast<std::size_t>(header.rayCount)};
+
+    Simulation::Settings& settings{snapshot.settings};
+    settings.backend = static_cast<Simulation::Backend>(header.backend);
+    settings.stepSize = header.stepSize;
+    settings.seed = header.seed;
+    settings.adaptive = Physics::AdaptiveSettings{header.rtol, header.minStep, header.maxStep};
+    settings.trails.policy = static_cast<TrailPolicy>(header.trailPolicy);
+    settings.trails.capacity = static_cast<std::size_t>(header.trailCapacity);
+    settings.trails.tolerance = header.trailTolerance;
+    settings.metric.kind = static_cast<Physics::MetricKind>(header.metric);
+    settings.metric.charge = header.charge;
+    settings.metric.spin = header.spin;
+    snapshot.frame = header.frame;
+    snapshot.totalSteps = header.totalSteps;
+    snapshot.rhsEvaluations = header.rhsEvaluations;
+
+    std::vector<RayRecord> rays(rayCount);
+    if (std::fread(rays.data(), sizeof(RayRecord), rayCount, file) != rayCount) {
+        return fail("is truncated");
+    }
+    snapshot.rays.assign(rayCount, Ray{1.0, 0.0, 0.0, 0.0});
+    for (std::size_t i{0}; i < rayCount; ++i) {
+        const RayRecord& r{rays[i]};
+        if (r.trailSlot >= rayCount || r.scenario > static_cast<std::uint8_t>(RayScenario::ORBITING)) {
+            return fail("is inconsistent");
+        }
+        Ray& ray{snapshot.rays[i]};
+        ray.r = r.r;
+        ray.phi = r.phi;
+        ray.v_r = r.v_r;
+        ray.v_phi = r.v_phi;
+        ray.E = r.E;
+        ray.L = r.L;
+        ray.initialVelocityAngle = r.initialVelocityAngle;
+        ray.deflection = r.deflection;
+        ray.trailSlot = static_cast<std::size_t>(r.trailSlot);
+        ray.startFrame = r.startFrame;
+        ray.scenario = static_cast<RayScenario>(r.scenario);
+    }
+
+    if (!readIds(file, static_cast<std::size_t>(header.pendingCount), rayCount, snapshot.pending) ||
+        !readIds(file, static_cast<std::size_t>(header.activeCount), rayCount, snapshot.active) ||
+        !readIds(file, static_cast<std::size_t>(header.frozenCount), rayCount, snapshot.frozen)) {
+        return fail("is truncated or inconsistent");
+    }
+
+    // Every ray must be in exactly one set
+    std::vector<unsigned char> seen(rayCount, 0);
+    for (const std::vector<std::size_t>* set : {&snapshot.pending, &snapshot.active, &snapshot.frozen}) {
+        for (const std::size_t id : *set) {
+            if (seen[id]++) {
+                return fail("is inconsistent");
+            }
+        }
+    }
+
+    snapshot.adaptive.clear();
+    if (settings.backend == Simulation::Backend::ADAPTIVE) {
+        std::vector<AdaptiveRecord> states(rayCount);
+        if (std::fread(states.data(), sizeof(AdaptiveRecord), rayCount, file) != rayCount) {
+            return fail("is truncated");
+        }
+        snapshot.adaptive.resize(rayCount);
+        for (std::size_t i{0}; i < rayCount; ++i) {
+            const AdaptiveRecord& r{states[i]};
+            Physics::AdaptiveState& s{snapshot.adaptive[i]};
+            s.started = r.started != 0;
+            s.captured = r.captured != 0;
+            s.lambda = r.lambda;
+            s.lambdaPrev = r.lambdaPrev;
+            s.frameLambda = r.frameLambda;
+            s.captureLambda = r.captureLambda;
+            s.h = r.h;
+            std::memcpy(s.y, r.y, sizeof(s.y));
+            std::memcpy(s.k1, r.k1, sizeof(s.k1));
+            std::memcpy(s.cont, r.cont, sizeof(s.cont));
+        }
+    }
+
+    snapshot.cartesian.clear();
+    if (settings.backend == Simulation::Backend::CARTESIAN) {
+        snapshot.cartesian.resize(rayCount);
+        if (std::fread(snapshot.cartesian.data(), sizeof(Physics::CartesianState), rayCount, file) != rayCount) {
+            return fail("is truncated");
+        }
+    }
+
+    snapshot.geometrized.clear();
+    if (settings.backend == Simulation::Backend::GEOMETRIZED) {
+        GeoHeader geoHeader{};
+        const std::size_t activeCount{snapshot.active.size()};
+        std::vector<GeoRecord> states(activeCount);
+        if (std::fread(&geoHeader, sizeof(geoHeader), 1, file) != 1 ||
+            std::fread(states.data(), sizeof(GeoRecord), activeCount, file) != activeCount) {
+            return fail("is truncated");
+        }
+        if (geoHeader.precision > static_cast<std::uint32_t>(Simulation::Precision::FLOAT)) {
+            return fail("is inconsistent");
+        }
+        settings.precision = static_cast<Simulation::Precision>(geoHeader.precision);
+        GeoBatch<double>& geo{snapshot.geometrized};
+        for (std::size_t i{0}; i < activeCount; ++i) {
+            const GeoRecord& r{states[i]};
+            const std::size_t id{snapshot.active[i]};
+            geo.r.push_back(r.r);
+            geo.phi.push_back(r.phi);
+            geo.v_r.push_back(r.v_r);
+            geo.v_phi.push_back(r.v_phi);
+            geo.E.push_back(r.E);
+            geo.startFrame.push_back(snapshot.rays[id].startFrame);
+            geo.ids.push_back(id);
+        }
+    }
+
+    snapshot.trails = TrailStore{rayCount, settings.trails};
+    char end[sizeof(END_MAGIC)]{};
+    if (!snapshot.trails.read(file) || std::fread(end, sizeof(end), 1, file) != 1 ||
+        std::memcmp(end, END_MAGIC, sizeof(END_MAGIC)) != 0) {
+        return fail("is truncated or inconsistent");
+    }
+    std::fclose(file);
+    return true;
+}
+
+void restore(Snapshot& snapshot, Simulation::Simulator& sim) {
+    sim.frame = snapshot.frame;
+    sim.totalSteps = snapshot.totalSteps;
+    sim.rhsEvaluations = snapshot.rhsEvaluations;
+    sim.trails = std::move(snapshot.trails);
+    sim.pending = std::move(snapshot.pending);
+    sim.active = std::move(snapshot.active);
+    sim.frozen = std::move(snapshot.frozen);
+    sim.active.reserve(sim.rays.size());
+    sim.frozen.reserve(sim.rays.size());
+    if (sim.backend == Simulation::Backend::ADAPTIVE) {
+        sim.adaptive = std::move(snapshot.adaptive);
+    }
+    if (sim.backend == Simulation::Backend::CARTESIAN) {
+        sim.cartesian = std::move(snapshot.cartesian);
+    }
+
+    // The batch mirrors the active set in order and holds nothing the rays
+    // do not, so it is rebuilt rather than saved
+    if (sim.backend == Simulation::Backend::BATCH) {
+        sim.batch = RayBatch{};
+        for (const std::size_t id : sim.active) {
+            sim.batch.push(sim.rays[id], id);
+        }
+        sim.stepped.assign(sim.active.size(), 0);
+    }
+
+    // The geometrized batch is saved: converting the rays again would not
+    // reproduce its rounding
+    if (sim.backend == Simulation::Backend::GEOMETRIZED) {
+        if (sim.precision == Simulation::Precision::FLOAT) {
+            copyGeo(snapshot.geometrized, sim.geoFloat);
+        } else {
+            sim.geoDouble = std::move(snapshot.geometrized);
+        }
+        sim.stepped.assign(sim.active.size(), 0);
+    }
+}
+
+Writer::Writer(const std::string& filePath, int everySteps, const Simulation::Simulator& sim)
+    : path{filePath}, interval{everySteps}, nextFrame{(sim.frame / everySteps + 1) * everySteps}, busy{false}, failed{false}, stopping{false},
+      savedFrame{-1} {
+    writer = std::thread(&Writer::writerLoop, this);
+}
+
+Writer::~Writer() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    changed.notify_all();
+    writer.join();
+}
+
+void Writer::capture(const Simulation::Simulator& sim) {
+    if (sim.frame < nextFrame) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock{mutex};
+    if (busy) {
+        return;
+    }
+    submit(sim);
+    lock.unlock();
+    changed.notify_all();
+}
+
+bool Writer::save(const Simulation::Simulator& sim) {
+    std::unique_lock<std::mutex> lock{mutex};
+    changed.wait(lock, [this] { return !busy; });
+    failed = false;
+    submit(sim);
+    changed.notify_all();
+    changed.wait(lock, [this] { return !busy; });
+    return !failed;
+}
+
+int Writer::lastFrame() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return savedFrame;
+}
+
+void Writer::submit(const Simulation::Simulator& sim) {
+    snapshot.take(sim);
+    busy = true;
+    nextFrame = (sim.frame / interval + 1) * interval;
+}
+
+void Writer::writerLoop() {
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;) {
+        changed.wait(lock, [this] { return busy || stopping; });
+        if (!busy) {
+            return;
+        }
+
+        // The simulation thread leaves the snapshot alone while busy
+        lock.unlock();
+        const bool ok{Checkpoint::save(path, snapshot)};
+        lock.lock();
+        if (ok) {
+            savedFrame = snapshot.frame;
+        } else {
+            failed = true;
+        }
+        busy = false;
+        changed.notify_all();
+    }
+}
+
+} // namespace Checkpoint
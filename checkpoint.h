@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dopri.h"
+#include "physics.h"
+#include "ray.h"
+#include "simulation.h"
+#include "trail_store.h"
+
+// Checkpoint and restart.
+//
+// A checkpoint is a versioned binary snapshot of everything a simulator
+// needs to continue: its settings, metric and seed, step and work counters,
+// every ray's full state, the pending/active/frozen sets in their exact
+// order, adaptive, Cartesian or geometrized solver state and the trail store
+// including its decimation state. A simulator restored from one produces
+// bit-identical results to the run that wrote it.
+namespace Checkpoint {
+    // Simulator state at one step
+    struct Snapshot {
+        Simulation::Settings settings;   // threads is not saved
+        int frame;
+        long long totalSteps;
+        long long rhsEvaluations;
+        std::vector<Ray> rays;
+        std::vector<std::size_t> pending;
+        std::vector<std::size_t> active;
+        std::vector<std::size_t> frozen;
+        std::vector<Physics::AdaptiveState> adaptive;  // ADAPTIVE backend only
+        std::vector<Physics::CartesianState> cartesian; // CARTESIAN backend only
+        GeoBatch<double> geometrized;   // GEOMETRIZED backend only, at either precision
+        TrailStore trails;
+
+        Snapshot();
+
+        // Copy a simulator's state, reusing this snapshot's buffers
+        void take(const Simulation::Simulator& sim);
+    };
+
+    // Write a snapshot to path via a temporary file, so an interrupted write
+    // never replaces the previous checkpoint
+    bool save(const std::string& path, const Snapshot& snapshot);
+
+    // Read a snapshot; false (with a message) if missing, truncated,
+    // inconsistent or of another version
+    bool load(const std::string& path, Snapshot& snapshot);
+
+    // Put a simulator built from the snapshot's rays and settings into the
+    // snapshot's state. Consumes the snapshot's buffers.
+    void restore(Snapshot& snapshot, Simulation::Simulator& sim);
+
+    // Checkpoints a simulator at every multiple of interval steps. Feed it
+    // through Simulator::checkpoints; the state is copied on the simulation
+    // thread and written by a background thread. A checkpoint that falls due
+    // while the previous one is still being written waits for the next step.
+    struct Writer {
+        Writer(const std::string& path, int interval, const Simulation::Simulator& sim);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Called after every step
+        void capture(const Simulation::Simulator& sim);
+
+        // Checkpoint now and wait until it is on disk; false on a write error
+        bool save(const Simulation::Simulator& sim);
+
+        // Step of the last checkpoint on disk (-1 before the first)
+        int lastFrame() const;
+
+    private:
+        std::string path;
+        int interval;
+        int nextFrame;
+
+        Snapshot snapshot;      // Owned by the writer thread while busy
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        bool busy;
+        bool failed;
+        bool stopping;
+        int savedFrame;
+        std::thread writer;
+
+        void writerLoop();
+
+        // Hand the simulator's current state to the writer (caller holds lock)
+        void submit(const Simulation::Simulator& sim);
+    };
+}
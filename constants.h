@@ -13,7 +13,16 @@ namespace Physics {
 // Black hole parameters
 namespace BlackHole {
     constexpr double MASS{8.54e36};         // Sagittarius A* mass (kg)
-    const double rs{2.0 * Physics::G * MASS / (Physics::c * Physics::c)};  // Schwarzschild radius
+    constexpr double rs{2.0 * Physics::G * MASS / (Physics::c * Physics::c)};  // Schwarzschild radius
+}
+
+// Geometrized units used inside the GEOMETRIZED integrator: lengths in
+// Schwarzschild radii (rs = 1) and velocities in units of c. Everything
+// outside it stays SI; state converts on entering and leaving a GeoBatch.
+namespace Units {
+    constexpr double LENGTH{BlackHole::rs};                 // Meters per unit length
+    constexpr double AFFINE{BlackHole::rs / Physics::c};    // λ per unit affine parameter
+    constexpr double SPEED{LENGTH / AFFINE};                // dr/dλ per unit (= c)
 }
 
 // Visual configuration
@@ -29,19 +38,85 @@ namespace Visual {
     constexpr float VIEW_WIDTH{100000000000.0f};   // 100 Gm
     constexpr float VIEW_HEIGHT{75000000000.0f};   // 75 Gm
 
+    // Mouse pan and zoom; at MAX_ZOOM the window is about 1% of rs tall
+    constexpr double MIN_ZOOM{0.25};
+    constexpr double MAX_ZOOM{1000.0};
+    constexpr double ZOOM_STEP{1.25};          // Zoom factor per scroll notch
+    constexpr int TRAIL_INDEX_CELLS{128};      // Trail culling grid cells per side
+
+    // Right-click ray bursts: rays per burst, slots kept free for them
+    // (8 KB of trail each at the default capacity), and a right-drag longer
+    // than BURST_AIM_PIXELS fans the burst over BURST_SPREAD radians
+    constexpr int BURST_RAYS{1000};
+    constexpr int RAY_POOL{4096};
+    constexpr double BURST_AIM_PIXELS{5.0};
+    constexpr double BURST_SPREAD{M_PI / 6.0};
+
     // Point source position
     constexpr float POINT_SOURCE_X{-0.95f * VIEW_WIDTH};
     constexpr float POINT_SOURCE_Y{0.85f * VIEW_HEIGHT};
 
-    // Ray timing (frames)
-    constexpr int ORBITING_START{0};
-    constexpr int POINT_SOURCE_START{700};
-    constexpr int PARALLEL_START{1200};
+    // Parallel beam launch line (x)
+    constexpr double PARALLEL_START_X{-1e11};
+
+    // Trail storage: points kept per ray, and how far (world units) a point
+    // may be from the kept polyline before decimation must keep it; a
+    // quarter pixel at MAX_ZOOM, so zooming in never shows the decimation
+    constexpr int TRAIL_CAPACITY{1024};
+    constexpr float TRAIL_TOLERANCE{static_cast<float>(0.25 * 2.0 * VIEW_WIDTH / WINDOW_WIDTH / MAX_ZOOM)};
+
+    // Lensed background renderer
+    constexpr double LENS_SOURCE_DISTANCE{1e11};  // Background plane behind the hole
+    constexpr int LENS_STARS{6000};               // Stars rasterized onto the plane
+    constexpr unsigned LENS_STAR_SEED{1};
+    constexpr int LENS_TILE_SIZE{32};             // Pixels per tile edge
+
+    // Offscreen video capture defaults
+    constexpr int CAPTURE_WIDTH{1920};
+    constexpr int CAPTURE_HEIGHT{1080};
+    constexpr int CAPTURE_FPS{60};
+    constexpr int CAPTURE_FRAMES{600};
+    constexpr int CAPTURE_QUEUE_DEPTH{8};         // Frames buffered for the writer thread
+
+    // Ray start times (simulation time, in affine parameter units)
+    constexpr double ORBITING_START{0.0};
+    constexpr double POINT_SOURCE_START{700.0};
+    constexpr double PARALLEL_START{1200.0};
 }
 
 // Simulation parameters
 namespace Simulation {
     constexpr double MAX_DISTANCE{2e11};    // Maximum escape distance
-    constexpr double INTEGRATION_STEP{1.0}; // RK4 time step
+    constexpr double INTEGRATION_STEP{1.0}; // Default affine parameter per simulation step
     constexpr int PROGRESS_INTERVAL{100};   // Frames between progress prints
+    constexpr int CHECKPOINT_INTERVAL{1000}; // Default steps between checkpoints
+
+    // Simulation clock defaults (windowed mode)
+    constexpr double STEPS_PER_SECOND{60.0};  // Steps per wall-clock second at 1x
+    constexpr double FRAME_BUDGET{0.012};     // Seconds of stepping per frame at max throughput
+    constexpr int MAX_SUBSTEPS{1000};         // Steps one frame may run before time is dropped
+    constexpr int PARALLEL_CHUNK{256};      // Rays per work-stealing task
+
+    // Adaptive (Dormand-Prince) integrator defaults
+    constexpr double ADAPTIVE_RTOL{1e-9};     // Relative error tolerance per step
+    constexpr double ADAPTIVE_MIN_STEP{1e-6}; // Smallest step (affine parameter)
+    constexpr double ADAPTIVE_MAX_STEP{64.0}; // Largest step (affine parameter)
+
+    // Deflection lookup table: interpolation error (radians) that splits a b interval
+    constexpr double DEFLECTION_TABLE_TOLERANCE{1e-3};
+
+    // Deflection error (radians) the precision report counts as safe for float
+    constexpr double PRECISION_TOLERANCE{1e-3};
+
+    // Accuracy report: default deflection error target (radians), the
+    // settings swept (steps as multiples of --step, adaptive tolerances),
+    // the reference solver's tolerance, the band around b_crit left out of
+    // the error, and the impact parameter (in rs) from which rays are
+    // checked against the weak-field formula
+    constexpr double ACCURACY_TARGET{1e-3};
+    constexpr double ACCURACY_STEP_FACTORS[]{8.0, 4.0, 2.0, 1.0, 0.5, 0.25};
+    constexpr double ACCURACY_TOLERANCES[]{1e-5, 1e-7, 1e-9};
+    constexpr double ACCURACY_REFERENCE_RTOL{1e-12};
+    constexpr double ACCURACY_CRITICAL_BAND{0.01};
+    constexpr double ACCURACY_WEAK_FIELD_B{5.0};
 }
\ No newline at end of file
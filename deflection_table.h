@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ray.h"
+
+namespace Physics {
+    // Deflection as a function of impact parameter b = L/E for the parallel
+    // beam (rays launched along +x from x = startX). In Schwarzschild a beam
+    // ray's fate depends only on b: b below the critical value 3√3/2 rs is
+    // captured, anything above escapes with a deflection that grows without
+    // bound as b approaches it. The table is built once by integrating sample
+    // rays with the reference RK4 path, refined adaptively where linear
+    // interpolation is poor (near the critical b), and cached on disk.
+    struct DeflectionTable {
+        double rs;            // Key: Schwarzschild radius the table was built for
+        double startX;        // Key: beam launch line
+        double maxDistance;   // Key: escape radius
+        double tolerance;     // Key: refinement tolerance
+        double step;          // Key: RK4 step the sample rays were traced with
+        double criticalB;     // Rays with b <= criticalB are captured
+        std::vector<double> b;           // Sample impact parameters, ascending
+        std::vector<double> deflection;  // Total (unwrapped) turning angle per sample
+
+        // Integrate sample rays and build the table
+        // tolerance: max interpolation error (radians) before a b interval is split
+        static DeflectionTable build(double startX, double maxDistance, double tolerance);
+
+        // Load a cached table if its key matches, otherwise build and save one
+        static DeflectionTable loadOrBuild(const std::string& path, double startX,
+                                           double maxDistance, double tolerance);
+
+        // Read a cached table; false if missing, corrupt or built for another key
+        bool load(const std::string& path, double expectedStartX, double expectedMaxDistance,
+                  double expectedTolerance);
+
+        // Write the table to disk, through a temporary file so an
+        // interrupted write never leaves a truncated cache
+        bool save(const std::string& path) const;
+
+        // Classify a ray by impact parameter. Returns true if captured;
+        // otherwise sets deflection, wrapped the same way as Ray::updateDeflection
+        bool lookup(double impactParameter, double& deflection) const;
+
+        // Same, but gives the total (unwrapped) turning angle, as lensing needs
+        bool turning(double impactParameter, double& total) const;
+
+        // Impact parameter of a ray from its conserved quantities
+        static double impactParameter(const Ray& ray);
+    };
+
+    // Capture/escape/deflection map for a large parallel beam, filled by
+    // table lookup instead of integration
+    struct BeamField {
+        double startX;
+        std::vector<float> y;            // Launch height of each ray
+        std::vector<float> deflection;   // Wrapped deflection (0 when captured)
+        std::vector<unsigned char> captured;
+
+        // Classify count rays evenly spaced over [-halfHeight, halfHeight]
+        static BeamField classify(const DeflectionTable& table, int count, double halfHeight);
+
+        std::size_t size() const { return y.size(); }
+    };
+}
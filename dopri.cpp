@@ -0,0 +1,211 @@
+#include "dopri.h"
+#include "constants.h"
+#include "metric.h"
+#include "physics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Physics {
+
+namespace {
+
+// Dormand-Prince 5(4) tableau
+constexpr double C2{1.0 / 5.0}, C3{3.0 / 10.0}, C4{4.0 / 5.0}, C5{8.0 / 9.0};
+constexpr double A21{1.0 / 5.0};
+constexpr double A31{3.0 / 40.0}, A32{9.0 / 40.0};
+constexpr double A41{44.0 / 45.0}, A42{-56.0 / 15.0}, A43{32.0 / 9.0};
+constexpr double A51{19372.0 / 6561.0}, A52{-25360.0 / 2187.0}, A53{64448.0 / 6561.0}, A54{-212.0 / 729.0};
+constexpr double A61{9017.0 / 3168.0}, A62{-355.0 / 33.0}, A63{46732.0 / 5247.0}, A64{49.0 / 176.0},
+                 A65{-5103.0 / 18656.0};
+constexpr double A71{35.0 / 384.0}, A73{500.0 / 1113.0}, A74{125.0 / 192.0}, A75{-2187.0 / 6784.0},
+                 A76{11.0 / 84.0};
+
+// Error estimate weights (5th minus 4th order solution)
+constexpr double E1{71.0 / 57600.0}, E3{-71.0 / 16695.0}, E4{71.0 / 1920.0}, E5{-17253.0 / 339200.0},
+                 E6{22.0 / 525.0}, E7{-1.0 / 40.0};
+
+// Dense output weights (Hairer & Wanner, contd5)
+constexpr double D1{-12715105075.0 / 11282082432.0}, D3{87487479700.0 / 32700410799.0},
+                 D4{-10690763975.0 / 1880347072.0}, D5{701980252875.0 / 199316789632.0},
+                 D6{-1453857185.0 / 822651844.0}, D7{69997945.0 / 29380423.0};
+
+// Step size controller
+constexpr double SAFETY{0.9};
+constexpr double MIN_FACTOR{0.2};
+constexpr double MAX_FACTOR{10.0};
+
+// Capture radius bisection iterations (2^-60 of a step is far below double precision)
+constexpr int BISECTION_STEPS{60};
+
+// Characteristic magnitudes of [r, φ, dr/dλ, dφ/dλ] so error control
+// stays meaningful when a component passes through zero
+double componentScale(int i) {
+    switch (i) {
+        case 0: return BlackHole::rs;
+        case 1: return 1.0;
+        case 2: return Physics::c;
+        default: return Physics::c / BlackHole::rs;
+    }
+}
+
+} // namespace
+
+AdaptiveState::AdaptiveState()
+    : started{false}, captured{false}, lambda{0.0}, lambdaPrev{0.0}, frameLambda{0.0},
+      captureLambda{0.0}, h{0.0}, y{}, k1{}, cont{} {
+}
+
+void adaptiveInit(AdaptiveState& state, const Ray& ray, double initialStep) {
+    state.started = true;
+    state.captured = false;
+    state.lambda = 0.0;
+    state.lambdaPrev = 0.0;
+    state.frameLambda = 0.0;
+    state.captureLambda = 0.0;
+    state.h = initialStep;
+    state.y[0] = ray.r;
+    state.y[1] = ray.phi;
+    state.y[2] = ray.v_r;
+    state.y[3] = ray.v_phi;
+    geodesicRHS(state.y, ray.E, state.k1);
+}
+
+int adaptiveStep(AdaptiveState& state, double E, const AdaptiveSettings& settings) {
+    const double* y{state.y};
+    const double* k1{state.k1};
+    double k2[4], k3[4], k4[4], k5[4], k6[4], k7[4], t[4], y1[4];
+    int evaluations{0};
+
+    while (true) {
+        const double h{state.h};
+
+        for (int i{0}; i < 4; ++i) t[i] = y[i] + h * A21 * k1[i];
+        geodesicRHS(t, E, k2);
+        for (int i{0}; i < 4; ++i) t[i] = y[i] + h * (A31 * k1[i] + A32 * k2[i]);
+        geodesicRHS(t, E, k3);
+        for (int i{0}; i < 4; ++i) t[i] = y[i] + h * (A41 * k1[i] + A42 * k2[i] + A43 * k3[i]);
+        geodesicRHS(t, E, k4);
+        for (int i{0}; i < 4; ++i) {
+            t[i] = y[i] + h * (A51 * k1[i] + A52 * k2[i] + A53 * k3[i] + A54 * k4[i]);
+        }
+        geodesicRHS(t, E, k5);
+        for (int i{0}; i < 4; ++i) {
+            t[i] = y[i] + h * (A61 * k1[i] + A62 * k2[i] + A63 * k3[i] + A64 * k4[i] + A65 * k5[i]);
+        }
+        geodesicRHS(t, E, k6);
+        for (int i{0}; i < 4; ++i) {
+            y1[i] = y[i] + h * (A71 * k1[i] + A73 * k3[i] + A74 * k4[i] + A75 * k5[i] + A76 * k6[i]);
+        }
+        geodesicRHS(y1, E, k7);
+        evaluations += 6;
+
+        // Scaled RMS error norm
+        double err{0.0};
+        for (int i{0}; i < 4; ++i) {
+            const double e{h * (E1 * k1[i] + E3 * k3[i] + E4 * k4[i] + E5 * k5[i] + E6 * k6[i] + E7 * k7[i])};
+            const double sc{settings.rtol * (componentScale(i) + std::max(std::abs(y[i]), std::abs(y1[i])))};
+            err += (e / sc) * (e / sc);
+        }
+        err = std::sqrt(err / 4.0);
+
+        // NaN/inf (e.g. a stage stepped inside the horizon) counts as a rejection
+        double factor{MIN_FACTOR};
+        if (std::isfinite(err)) {
+            factor = err > 0.0 ? SAFETY * std::pow(err, -0.2) : MAX_FACTOR;
+            factor = std::min(MAX_FACTOR, std::max(MIN_FACTOR, factor));
+        }
+
+        // A non-finite error at the smallest step cannot be stepped past:
+        // the ray ends where it is, as captured, and dense output holds it
+        // there
+        if (!std::isfinite(err) && h <= settings.minStep) {
+            for (int i{0}; i < 4; ++i) {
+                state.cont[0][i] = y[i];
+                for (int j{1}; j < 5; ++j) {
+                    state.cont[j][i] = 0.0;
+                }
+            }
+            state.lambdaPrev = state.lambda;
+            state.captured = true;
+            state.captureLambda = state.lambda;
+            return evaluations;
+        }
+
+        const bool accept{err <= 1.0 || h <= settings.minStep};
+        if (!accept) {
+            state.h = std::max(settings.minStep, h * factor);
+            continue;
+        }
+
+        // Dense output coefficients for [lambda, lambda + h]
+        for (int i{0}; i < 4; ++i) {
+            const double diff{y1[i] - y[i]};
+            const double bspl{h * k1[i] - diff};
+            state.cont[0][i] = y[i];
+            state.cont[1][i] = diff;
+            state.cont[2][i] = bspl;
+            state.cont[3][i] = diff - h * k7[i] - bspl;
+            state.cont[4][i] = h * (D1 * k1[i] + D3 * k3[i] + D4 * k4[i] + D5 * k5[i] + D6 * k6[i] + D7 * k7[i]);
+        }
+
+        state.lambdaPrev = state.lambda;
+        state.lambda += h;
+        for (int i{0}; i < 4; ++i) {
+            state.y[i] = y1[i];
+            state.k1[i] = k7[i];
+        }
+        state.h = std::min(settings.maxStep, h * factor);
+        return evaluations;
+    }
+}
+
+void adaptiveDense(const AdaptiveState& state, double lambda, double out[4]) {
+    const double h{state.lambda - state.lambdaPrev};
+    const double theta{h > 0.0 ? (lambda - state.lambdaPrev) / h : 1.0};
+    const double theta1{1.0 - theta};
+    for (int i{0}; i < 4; ++i) {
+        out[i] = state.cont[0][i] + theta * (state.cont[1][i] + theta1 * (state.cont[2][i]
+                 + theta * (state.cont[3][i] + theta1 * state.cont[4][i])));
+    }
+}
+
+int adaptiveAdvance(AdaptiveState& state, Ray& ray, double targetLambda,
+                    const AdaptiveSettings& settings) {
+    const double captureRadius{Physics::captureRadius()};
+    int evaluations{0};
+
+    while (!state.captured && state.lambda < targetLambda) {
+        evaluations += adaptiveStep(state, ray.E, settings);
+
+        // Crossed the capture radius during this step: bisect on the interpolant
+        if (state.y[0] <= captureRadius) {
+            double lo{state.lambdaPrev};
+            double hi{state.lambda};
+            double y[4];
+            for (int i{0}; i < BISECTION_STEPS; ++i) {
+                const double mid{0.5 * (lo + hi)};
+                adaptiveDense(state, mid, y);
+                if (y[0] <= captureRadius) {
+                    hi = mid;
+                } else {
+                    lo = mid;
+                }
+            }
+            state.captured = true;
+            state.captureLambda = hi;
+        }
+    }
+
+    double y[4];
+    const double at{state.captured ? std::min(targetLambda, state.captureLambda) : targetLambda};
+    adaptiveDense(state, at, y);
+    // A ray the solver gave up on ends on the capture radius, so it retires
+    // as captured
+    ray.r = state.captured && at >= state.captureLambda ? std::min(y[0], captureRadius) : y[0];
+    ray.phi = y[1];
+    ray.v_r = y[2];
+    ray.v_phi = y[3];
+    return evaluations;
+}
+
+} // namespace Physics
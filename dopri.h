@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ray.h"
+
+// Adaptive Dormand-Prince 5(4) integrator with dense output
+namespace Physics {
+    // Error control settings for the adaptive integrator
+    struct AdaptiveSettings {
+        double rtol;      // Relative tolerance per component
+        double minStep;   // Smallest step before giving up on error control
+        double maxStep;   // Largest step (keeps far-field steps bounded)
+    };
+
+    // Per-ray solver state. The solver runs ahead of the frame clock;
+    // dense output fills in the state at each frame's affine parameter.
+    struct AdaptiveState {
+        bool started;
+        bool captured;        // Capture radius crossed (captureLambda valid)
+        double lambda;        // Affine parameter the solver has reached
+        double lambdaPrev;    // Start of the last accepted step
+        double frameLambda;   // Affine parameter of the last emitted frame
+        double captureLambda; // Where r crossed the capture radius
+        double h;             // Next trial step
+        double y[4];          // State at lambda: [r, φ, dr/dλ, dφ/dλ]
+        double k1[4];         // Derivative at lambda (first-same-as-last)
+        double cont[5][4];    // Dense output coefficients for the last step
+
+        AdaptiveState();
+    };
+
+    // Start the solver from a ray's current state
+    void adaptiveInit(AdaptiveState& state, const Ray& ray, double initialStep);
+
+    // Take one accepted adaptive step (retrying rejected ones); an error
+    // that is not finite even at minStep marks the state captured instead
+    // Returns the number of RHS evaluations used
+    int adaptiveStep(AdaptiveState& state, double E, const AdaptiveSettings& settings);
+
+    // Evaluate the dense output of the last step at lambda
+    void adaptiveDense(const AdaptiveState& state, double lambda, double out[4]);
+
+    // Advance the ray to targetLambda: step the solver as far as needed, write
+    // the interpolated state into the ray, and stop at the capture radius
+    // (located by bisection on the dense output) instead of overshooting. A
+    // ray the solver could not step past is left on the capture radius.
+    // Returns the number of RHS evaluations used.
+    int adaptiveAdvance(AdaptiveState& state, Ray& ray, double targetLambda,
+                        const AdaptiveSettings& settings);
+}
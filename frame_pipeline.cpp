@@ -0,0 +1,199 @@
+#include "frame_pipeline.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace Simulation {
+
+FrameDelta::FrameDelta() : frame{0}, recycled{0} {
+}
+
+void FrameDelta::clear() {
+    active.clear();
+    frozen.clear();
+    ids.clear();
+    rays.clear();
+    segments.clear();
+    points.clear();
+}
+
+FrameView::FrameView(const Simulator& sim)
+    : rays{sim.rays}, trails{sim.trails}, active{sim.active}, frozen{sim.frozen}, recycled{sim.recycled},
+      frame{sim.frame} {
+    rays.reserve(sim.capacity());
+    active.reserve(sim.capacity());
+    frozen.reserve(sim.capacity());
+}
+
+void FrameView::apply(const FrameDelta& delta) {
+    for (std::size_t i{0}; i < delta.ids.size(); ++i) {
+        // Spawned rays fill unused slots in order
+        if (delta.ids[i] >= rays.size()) {
+            rays.resize(delta.ids[i] + 1, delta.rays[i]);
+        }
+        rays[delta.ids[i]] = delta.rays[i];
+    }
+    for (const TrailSegment& segment : delta.segments) {
+        if (segment.resets) {
+            trails.clear(segment.slot);
+        }
+        trails.applyTail(segment.slot, delta.points.data() + segment.first, segment.count,
+                         segment.replacesLast, segment.appended);
+    }
+    active.assign(delta.active.begin(), delta.active.end());
+
+    // Recycled rays left the front of frozen before the step's rays finished
+    frozen.erase(frozen.begin(), frozen.begin() + static_cast<std::ptrdiff_t>(delta.recycled - recycled));
+    frozen.insert(frozen.end(), delta.frozen.begin(), delta.frozen.end());
+    recycled = delta.recycled;
+    frame = delta.frame;
+}
+
+Pipeline::Pipeline(Simulator& simRef)
+    : sim{simRef}, front{simRef}, published(simRef.trails.slotCount(), 0),
+      head{0}, tail{0}, stopping{false}, inboxFull{false} {
+    for (std::size_t slot{0}; slot < published.size(); ++slot) {
+        published[slot] = sim.trails.appended(slot);
+    }
+    worker = std::thread(&Pipeline::run, this);
+}
+
+Pipeline::~Pipeline() {
+    stopping = true;
+    signal();
+    worker.join();
+}
+
+void Pipeline::signal() {
+    { std::lock_guard<std::mutex> lock{ringMutex}; }
+    ringChanged.notify_all();
+}
+
+void Pipeline::advance() {
+    PROFILE_SCOPE("Pipeline::advance");
+    if (tryAdvance()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock{ringMutex};
+        ringChanged.wait(lock, [this] {
+            return tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed);
+        });
+    }
+    tryAdvance();
+}
+
+bool Pipeline::advanceWithin(double seconds) {
+    PROFILE_SCOPE("Pipeline::advance");
+    if (tryAdvance()) {
+        return true;
+    }
+    if (!(seconds > 0.0)) {
+        return false;
+    }
+    {
+        std::unique_lock<std::mutex> lock{ringMutex};
+        const bool ready{ringChanged.wait_for(lock, std::chrono::duration<double>(seconds), [this] {
+            return tail.load(std::memory_order_acquire) != head.load(std::memory_order_relaxed);
+        })};
+        if (!ready) {
+            return false;
+        }
+    }
+    return tryAdvance();
+}
+
+bool Pipeline::tryAdvance() {
+    const std::size_t next{head.load(std::memory_order_relaxed)};
+    if (tail.load(std::memory_order_acquire) == next) {
+        return false;
+    }
+    front.apply(ring[next % DEPTH]);
+    head.store(next + 1, std::memory_order_release);
+    signal();
+    return true;
+}
+
+void Pipeline::spawn(const std::vector<Ray>& burst) {
+    std::lock_guard<std::mutex> lock{inboxMutex};
+    inbox.insert(inbox.end(), burst.begin(), burst.end());
+    inboxFull.store(true, std::memory_order_release);
+}
+
+void Pipeline::run() {
+    while (!stopping.load(std::memory_order_relaxed)) {
+        const std::size_t next{tail.load(std::memory_order_relaxed)};
+        if (next - head.load(std::memory_order_acquire) == DEPTH) {
+            std::unique_lock<std::mutex> lock{ringMutex};
+            ringChanged.wait(lock, [this, next] {
+                return stopping.load(std::memory_order_relaxed) ||
+                       next - head.load(std::memory_order_acquire) < DEPTH;
+            });
+            continue;
+        }
+
+        if (inboxFull.load(std::memory_order_acquire)) {
+            {
+                std::lock_guard<std::mutex> lock{inboxMutex};
+                spawning.swap(inbox);
+                inboxFull.store(false, std::memory_order_relaxed);
+            }
+            sim.spawn(spawning);
+            spawning.clear();
+        }
+
+        const std::size_t frozenBefore{sim.frozen.size()};
+        sim.step();
+        sim.syncAngles();
+        capture(ring[next % DEPTH], frozenBefore);
+        tail.store(next + 1, std::memory_order_release);
+        signal();
+    }
+}
+
+void Pipeline::capture(FrameDelta& delta, std::size_t frozenBefore) {
+    PROFILE_SCOPE("Pipeline::capture");
+    delta.clear();
+    delta.frame = sim.frame;
+    delta.active.assign(sim.active.begin(), sim.active.end());
+    delta.frozen.assign(sim.frozen.begin() + static_cast<std::ptrdiff_t>(frozenBefore), sim.frozen.end());
+    delta.recycled = sim.recycled;
+
+    // Only rays that were active during the step can have changed: those
+    // still active and those that just retired
+    for (const std::size_t id : delta.active) {
+        captureRay(delta, id);
+    }
+    for (const std::size_t id : delta.frozen) {
+        captureRay(delta, id);
+    }
+    PROFILE_COUNTER("published trail points", delta.points.size());
+}
+
+void Pipeline::captureRay(FrameDelta& delta, std::size_t id) {
+    const Ray& ray{sim.rays[id]};
+    delta.ids.push_back(id);
+    delta.rays.push_back(ray);
+
+    const std::size_t slot{ray.trailSlot};
+    const std::size_t count{sim.trails.size(slot)};
+    if (count == 0) {
+        return;
+    }
+
+    // Points appended since the last publish, plus the previous last point,
+    // which decimation may have replaced in place. When every point is new
+    // (a spawned ray) the view's copy has nothing left to keep.
+    const std::uint64_t appended{sim.trails.appended(slot)};
+    const std::size_t fresh{static_cast<std::size_t>(std::min<std::uint64_t>(appended - published[slot], count))};
+    const std::size_t n{std::min(count, fresh + 1)};
+    published[slot] = appended;
+
+    delta.segments.push_back(TrailSegment{slot, appended, static_cast<std::uint32_t>(delta.points.size()),
+                                          static_cast<std::uint32_t>(n), n > fresh, fresh == count});
+    for (std::size_t i{count - n}; i < count; ++i) {
+        delta.points.push_back(sim.trails.at(slot, i));
+    }
+}
+
+} // namespace Simulation
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ray.h"
+#include "simulation.h"
+#include "trail_store.h"
+
+// Pipelined simulation: the simulator runs on its own thread and publishes
+// what each step changed, while the render thread draws the previous frame
+// from its own copy of the state. Frame time tends to the slower of physics
+// and rendering instead of their sum.
+namespace Simulation {
+    // Trail points one ray gained during a step. When replacesLast is set the
+    // first point overwrites the trail's previous last point (decimation moved
+    // it) and the rest are appended. When resets is set the points are the
+    // whole trail (a spawned ray's) and replace what the slot held.
+    struct TrailSegment {
+        std::size_t slot;
+        std::uint64_t appended;   // TrailStore::appended() after the step
+        std::uint32_t first;      // Offset into FrameDelta::points
+        std::uint32_t count;
+        bool replacesLast;
+        bool resets;
+    };
+
+    // Everything one Simulator::step changed. Buffers keep their capacity
+    // between uses, so publishing a frame does not allocate once warmed up.
+    struct FrameDelta {
+        int frame;
+        std::vector<std::size_t> active;   // Whole active set after the step
+        std::vector<std::size_t> frozen;   // Rays appended to the frozen set
+        std::size_t recycled;              // Simulator::recycled after the step
+        std::vector<std::size_t> ids;      // Rays whose state changed
+        std::vector<Ray> rays;             // Their new state, parallel to ids
+        std::vector<TrailSegment> segments;
+        std::vector<glm::vec2> points;     // New trail points of every segment
+
+        FrameDelta();
+
+        void clear();
+    };
+
+    // Render-side copy of the simulator state, taken once and then kept in
+    // step by applying deltas in order
+    struct FrameView {
+        std::vector<Ray> rays;
+        TrailStore trails;
+        std::vector<std::size_t> active;
+        std::vector<std::size_t> frozen;
+        std::size_t recycled;
+        int frame;
+
+        // Copy of the simulator's state, with room for its whole capacity
+        explicit FrameView(const Simulator& sim);
+
+        void apply(const FrameDelta& delta);
+    };
+
+    // Runs a simulator on a dedicated thread up to DEPTH frames ahead of the
+    // consumer. Deltas go through a single-producer single-consumer ring of
+    // DEPTH buffers whose head and tail are atomics, so handing a frame over
+    // takes no lock. A side that finds the ring full (or empty) sleeps on a
+    // condition variable that every head and tail update signals, instead of
+    // spinning. Rays to spawn go the
+    // other way through a small locked inbox, which the simulation thread
+    // only locks when a flag says it holds something.
+    //
+    // Once constructed the simulator belongs to the pipeline thread: read
+    // state through view() only, until the pipeline is destroyed.
+    struct Pipeline {
+        static constexpr std::size_t DEPTH{3};
+
+        explicit Pipeline(Simulator& sim);
+        ~Pipeline();
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        // Apply the next simulated frame to view(), waiting for it if the
+        // simulation thread is behind
+        void advance();
+
+        // Same, but wait at most seconds; false if no frame came in time
+        bool advanceWithin(double seconds);
+
+        // Same, but return false instead of waiting when none is ready
+        bool tryAdvance();
+
+        // Hand rays to Simulator::spawn before the next step the simulation
+        // thread takes; they show up in view() with that step
+        void spawn(const std::vector<Ray>& burst);
+
+        // State as of the last advance()
+        const FrameView& view() const { return front; }
+
+    private:
+        Simulator& sim;
+        FrameView front;
+        std::vector<std::uint64_t> published;  // Per-slot appended() at last publish (producer only)
+        FrameDelta ring[DEPTH];
+        std::atomic<std::size_t> head;         // Deltas consumed
+        std::atomic<std::size_t> tail;         // Deltas published
+        std::atomic<bool> stopping;
+        std::mutex ringMutex;                  // Only for sleeping on ringChanged
+        std::condition_variable ringChanged;   // Signalled after head, tail or stopping change
+        std::mutex inboxMutex;
+        std::vector<Ray> inbox;                // Rays waiting to spawn (guarded by inboxMutex)
+        std::vector<Ray> spawning;             // Inbox taken by the simulation thread
+        std::atomic<bool> inboxFull;           // inbox holds rays
+        std::thread worker;
+
+        void run();
+
+        // Wake the other side if it sleeps on ringChanged. Taking the mutex
+        // orders the change before a waiter's predicate check, so a wake-up
+        // cannot fall between its check and its wait.
+        void signal();
+
+        // Record the step that just ran, given the frozen set's size before it
+        void capture(FrameDelta& delta, std::size_t frozenBefore);
+
+        // Copy one ray's state and new trail points into the delta
+        void captureRay(FrameDelta& delta, std::size_t id);
+    };
+}
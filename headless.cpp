@@ -0,0 +1,568 @@
+#include "headless.h"
+#include "accuracy.h"
+#include "checkpoint.h"
+#include "constants.h"
+#include "lensing.h"
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace Headless {
+
+namespace {
+
+const char* stateName(const Ray& ray) {
+    if (ray.isCaptured()) {
+        return "captured";
+    }
+    if (ray.hasEscaped(Simulation::MAX_DISTANCE)) {
+        return "escaped";
+    }
+    return "active";
+}
+
+// Run a simulator to options.frames steps or until every ray finishes;
+// returns the seconds spent stepping
+double runToEnd(Simulation::Simulator& sim, const Options& options) {
+    const auto start{std::chrono::steady_clock::now()};
+    for (int i{0}; i < options.frames && !sim.finished(); ++i) {
+        sim.step();
+    }
+    const auto end{std::chrono::steady_clock::now()};
+    sim.syncAngles();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+// |a - b| in radians; a ray that blew up (NaN) counts as infinitely wrong
+double deflectionError(const Ray& a, const Ray& b) {
+    const double error{std::abs(a.deflection - b.deflection)};
+    return std::isnan(error) ? HUGE_VAL : error;
+}
+
+// Rays of one impact parameter range in the precision report
+struct PrecisionBin {
+    double low;     // Range of b / b_crit
+    double high;
+    int rays;
+    int fateMismatches;              // Float run ended differently from double
+    double maxDoubleError;           // |geometrized double - SI reference|
+    std::vector<double> floatErrors; // |geometrized float - geometrized double|
+};
+
+} // namespace
+
+int run(Simulation::Simulator& sim, const Options& options) {
+    std::cout << "Running headless for " << options.frames << " frames\n";
+
+    const auto start{std::chrono::steady_clock::now()};
+    int framesRun{0};
+    while (framesRun < options.frames) {
+        sim.step();
+        ++framesRun;
+        PROFILE_FRAME();
+
+        if (sim.finished()) {
+            std::cout << "All rays finished at frame " << sim.frame << "\n";
+            break;
+        }
+    }
+    const auto end{std::chrono::steady_clock::now()};
+    const double seconds{std::chrono::duration<double>(end - start).count()};
+    sim.syncAngles();
+
+    const double raysPerSec{seconds > 0.0 ? static_cast<double>(sim.rays.size()) / seconds : 0.0};
+    const double stepsPerSec{seconds > 0.0 ? static_cast<double>(sim.totalSteps) / seconds : 0.0};
+
+    std::cout << "Frames:     " << framesRun << "\n"
+              << "Rays:       " << sim.rays.size() << "\n"
+              << "Ray steps:  " << sim.totalSteps << "\n"
+              << "RHS evals:  " << sim.rhsEvaluations << "\n"
+              << "Trail mem:  " << sim.trails.bytes() / 1024 << " KiB\n"
+              << "Elapsed:    " << seconds << " s\n"
+              << "Rays/sec:   " << raysPerSec << "\n"
+              << "Steps/sec:  " << stepsPerSec << "\n";
+
+    if (!options.profile.empty()) {
+        Profiling::writeReports(options.profile);
+    }
+
+    if (sim.recorder) {
+        if (!sim.recorder->close()) {
+            return -1;
+        }
+        std::cout << "Recorded " << sim.recorder->frames() << " steps to " << options.record << "\n";
+    }
+
+    if (sim.checkpoints) {
+        if (!sim.checkpoints->save(sim)) {
+            return -1;
+        }
+        std::cout << "Checkpoint at step " << sim.frame << " written to " << options.checkpoint << "\n";
+    }
+
+    const Sharding::Shard shard{options.shardIndex, options.shardCount};
+    const std::string output{shard.path(options.output)};
+    if (!writeResults(sim, output, shard)) {
+        return -1;
+    }
+    std::cout << "Results written to " << output << "\n";
+
+    if (options.writeTrails) {
+        const std::string trailPath{output + ".trails.csv"};
+        if (!writeTrails(sim, trailPath, shard)) {
+            return -1;
+        }
+        std::cout << "Trails written to " << trailPath << "\n";
+    }
+
+    if (shard.sharded()) {
+        Sharding::Stats stats;
+        stats.rays = static_cast<long long>(sim.rays.size());
+        stats.framesRun = framesRun;
+        stats.lastFrame = sim.frame;
+        stats.totalSteps = sim.totalSteps;
+        stats.rhsEvaluations = sim.rhsEvaluations;
+        stats.trailBytes = static_cast<long long>(sim.trails.bytes());
+        stats.elapsed = seconds;
+        stats.trails = options.writeTrails;
+        if (!stats.write(output + ".stats")) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+bool writeResults(const Simulation::Simulator& sim, const std::string& path, const Sharding::Shard& shard) {
+    const std::vector<Ray>& rays{sim.rays};
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+
+    out.precision(17);
+    out << "ray,scenario,start_frame,state,r,phi,deflection,trail_points\n";
+    for (size_t i{0}; i < rays.size(); ++i) {
+        const Ray& ray{rays[i]};
+        out << shard.globalId(i) << ',' << scenarioName(ray.scenario) << ',' << ray.startFrame << ','
+            << stateName(ray) << ',' << ray.r << ',' << ray.phi << ',' << ray.deflection << ','
+            << sim.trails.size(ray.trailSlot) << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+bool writeTrails(const Simulation::Simulator& sim, const std::string& path, const Sharding::Shard& shard) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+
+    out.precision(9);
+    out << "ray,index,x,y\n";
+    for (size_t i{0}; i < sim.rays.size(); ++i) {
+        const std::size_t slot{sim.rays[i].trailSlot};
+        for (size_t j{0}; j < sim.trails.size(slot); ++j) {
+            const glm::vec2 p{sim.trails.at(slot, j)};
+            out << shard.globalId(i) << ',' << j << ',' << p.x << ',' << p.y << '\n';
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+int runLookup(const Physics::DeflectionTable& table, const Options& options) {
+    std::cout << "Classifying " << options.lookupRays << " beam rays by lookup\n";
+
+    const auto start{std::chrono::steady_clock::now()};
+    const Physics::BeamField field{Physics::BeamField::classify(table, options.lookupRays, Visual::VIEW_HEIGHT)};
+    const auto end{std::chrono::steady_clock::now()};
+    const double seconds{std::chrono::duration<double>(end - start).count()};
+
+    std::size_t captured{0};
+    for (unsigned char c : field.captured) {
+        captured += c;
+    }
+    const double raysPerSec{seconds > 0.0 ? static_cast<double>(field.size()) / seconds : 0.0};
+
+    std::cout << "Rays:       " << field.size() << "\n"
+              << "Captured:   " << captured << "\n"
+              << "Table size: " << table.b.size() << " samples\n"
+              << "Elapsed:    " << seconds << " s\n"
+              << "Rays/sec:   " << raysPerSec << "\n";
+
+    const std::string path{options.output + ".lookup.csv"};
+    if (!writeLookup(field, path)) {
+        return -1;
+    }
+    std::cout << "Lookup results written to " << path << "\n";
+    return 0;
+}
+
+int runLens(const Physics::DeflectionTable& table, const Options& options) {
+    Lensing::Image background;
+    if (options.lensBackground.empty()) {
+        background = Lensing::starField(2048, 1536, Visual::LENS_STARS, Visual::LENS_STAR_SEED);
+    } else if (!Lensing::readPPM(options.lensBackground, background)) {
+        std::cerr << "Failed to read background image " << options.lensBackground << "\n";
+        return -1;
+    }
+
+    ThreadPool pool{options.threads};
+    Lensing::Image frame{options.lensWidth, options.lensHeight};
+    std::cout << "Rendering " << frame.width << "x" << frame.height << " lensed frame on "
+              << pool.size() << " threads\n";
+
+    const auto start{std::chrono::steady_clock::now()};
+    Lensing::render(table, background, Lensing::Settings{}, pool, frame);
+    const auto end{std::chrono::steady_clock::now()};
+    const double seconds{std::chrono::duration<double>(end - start).count()};
+
+    const double pixels{static_cast<double>(frame.width) * frame.height};
+    std::cout << "Elapsed:    " << seconds << " s\n"
+              << "Pixels/sec: " << (seconds > 0.0 ? pixels / seconds : 0.0) << "\n";
+
+    if (!Lensing::writePPM(options.lensOutput, frame)) {
+        std::cerr << "Failed to open " << options.lensOutput << " for writing\n";
+        return -1;
+    }
+    std::cout << "Lensed frame written to " << options.lensOutput << "\n";
+    return 0;
+}
+
+int runReplay(const Recording::Replay& replay) {
+    // Count what the last step shows, straight from the mapping
+    Recording::ReplayFrame frame;
+    const auto start{std::chrono::steady_clock::now()};
+    replay.build(replay.frameCount(), Visual::TRAIL_CAPACITY, frame);
+    const auto end{std::chrono::steady_clock::now()};
+
+    std::cout << "Rays:       " << replay.rayCount() << "\n"
+              << "Steps:      " << replay.frameCount() << "\n"
+              << "Step size:  " << replay.stepSize() << "\n"
+              << "File size:  " << replay.fileSize() / 1024 << " KiB\n"
+              << "Moving:     " << frame.heads.size() << " rays at the last step\n"
+              << "Trails:     " << frame.trails.positions.size() << " points at the last step, built in "
+              << std::chrono::duration<double>(end - start).count() << " s\n";
+    return 0;
+}
+
+int runPrecisionReport(const std::vector<Ray>& rays, const Simulation::Settings& settings,
+                       const Options& options) {
+    std::cout << "Comparing geometrized float and double against the SI reference over "
+              << options.frames << " frames\n";
+
+    // Same rays through the reference path and both precisions
+    Simulation::Settings reference{settings};
+    reference.backend = Simulation::Backend::RAY;
+    Simulation::Settings geoDouble{settings};
+    geoDouble.backend = Simulation::Backend::GEOMETRIZED;
+    geoDouble.precision = Simulation::Precision::DOUBLE;
+    Simulation::Settings geoFloat{geoDouble};
+    geoFloat.precision = Simulation::Precision::FLOAT;
+
+    Simulation::Simulator referenceSim{rays, reference};
+    Simulation::Simulator doubleSim{rays, geoDouble};
+    Simulation::Simulator floatSim{rays, geoFloat};
+    const double referenceSeconds{runToEnd(referenceSim, options)};
+    const double doubleSeconds{runToEnd(doubleSim, options)};
+    const double floatSeconds{runToEnd(floatSim, options)};
+
+    auto rate = [](const Simulation::Simulator& sim, double seconds) {
+        return seconds > 0.0 ? static_cast<double>(sim.totalSteps) / seconds : 0.0;
+    };
+    std::cout << "Steps/sec:  reference " << rate(referenceSim, referenceSeconds)
+              << ", double " << rate(doubleSim, doubleSeconds)
+              << ", float " << rate(floatSim, floatSeconds)
+              << " (" << Physics::batchKernelName() << " kernel)\n";
+
+    const std::string path{options.output + ".precision.csv"};
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return -1;
+    }
+    out.precision(17);
+    out << "ray,scenario,b,state_reference,state_double,state_float,"
+           "deflection_reference,deflection_double,deflection_float\n";
+
+    // b = L / E in units of the critical impact parameter 3√3/2 rs, where
+    // rays graze the photon sphere and any error is amplified most
+    const double criticalB{1.5 * std::sqrt(3.0) * BlackHole::rs};
+    std::vector<PrecisionBin> bins;
+    const double edges[]{0.0, 0.9, 0.99, 0.999, 1.001, 1.01, 1.1, 1.5, 2.0, 5.0, HUGE_VAL};
+    for (std::size_t i{0}; i + 1 < std::size(edges); ++i) {
+        bins.push_back(PrecisionBin{edges[i], edges[i + 1], 0, 0, 0.0, {}});
+    }
+
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        const Ray& ref{referenceSim.rays[i]};
+        const Ray& dbl{doubleSim.rays[i]};
+        const Ray& flt{floatSim.rays[i]};
+        const double b{std::abs(ref.L / ref.E) / criticalB};
+        out << i << ',' << scenarioName(ref.scenario) << ',' << b << ',' << stateName(ref) << ','
+            << stateName(dbl) << ',' << stateName(flt) << ',' << ref.deflection << ','
+            << dbl.deflection << ',' << flt.deflection << '\n';
+
+        for (PrecisionBin& bin : bins) {
+            if (b >= bin.low && b < bin.high) {
+                ++bin.rays;
+                if (std::string{stateName(dbl)} != stateName(flt)) {
+                    ++bin.fateMismatches;
+                }
+                bin.maxDoubleError = std::max(bin.maxDoubleError, deflectionError(dbl, ref));
+                bin.floatErrors.push_back(deflectionError(flt, dbl));
+                break;
+            }
+        }
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << path << "\n";
+        return -1;
+    }
+
+    // Float is safe from the lowest b above which every bin stays within
+    // tolerance and ends every ray the same way as double
+    std::cout << "b/b_crit range     rays  double err  float max   float median  fate diffs\n";
+    double safeFrom{HUGE_VAL};
+    bool safeAbove{true};
+    for (std::size_t i{bins.size()}; i-- > 0;) {
+        PrecisionBin& bin{bins[i]};
+        if (bin.rays == 0) {
+            continue;
+        }
+        std::sort(bin.floatErrors.begin(), bin.floatErrors.end());
+        const double maxError{bin.floatErrors.back()};
+        safeAbove = safeAbove && bin.fateMismatches == 0 && maxError <= Simulation::PRECISION_TOLERANCE;
+        if (safeAbove) {
+            safeFrom = bin.low;
+        }
+    }
+    for (const PrecisionBin& bin : bins) {
+        if (bin.rays == 0) {
+            continue;
+        }
+        char line[128];
+        std::snprintf(line, sizeof(line), "[%5.3f, %5.3f)  %6d  %10.3e  %10.3e  %10.3e  %10d\n",
+                      bin.low, bin.high, bin.rays, bin.maxDoubleError, bin.floatErrors.back(),
+                      bin.floatErrors[bin.floatErrors.size() / 2], bin.fateMismatches);
+        std::cout << line;
+    }
+    if (safeFrom == HUGE_VAL) {
+        std::cout << "Float exceeds " << Simulation::PRECISION_TOLERANCE
+                  << " rad of deflection error in the outermost populated range\n";
+    } else {
+        std::cout << "Float stays within " << Simulation::PRECISION_TOLERANCE
+                  << " rad of double for b >= " << safeFrom << " b_crit\n";
+    }
+    std::cout << "Per-ray comparison written to " << path << "\n";
+    return 0;
+}
+
+int runAccuracyReport(const std::vector<Ray>& rays, const Simulation::Settings& settings,
+                      const Options& options) {
+    // Every setting covers the same affine parameter: a whole number of
+    // steps at the largest step swept
+    const double largest{*std::max_element(std::begin(Simulation::ACCURACY_STEP_FACTORS),
+                                           std::end(Simulation::ACCURACY_STEP_FACTORS))};
+    const double frames{std::ceil(options.frames / largest) * largest};
+    const double lambda{frames * settings.stepSize};
+    std::cout << "Accuracy of " << rays.size() << " rays over " << frames << " steps of "
+              << settings.stepSize << " (affine parameter " << lambda << ")\n";
+
+    // The current setting first, then the sweep without it
+    using Simulation::Backend;
+    using Simulation::Precision;
+    const Accuracy::Setting current{settings.backend, settings.precision, settings.stepSize,
+                                    settings.adaptive.rtol};
+    std::vector<Accuracy::Setting> sweep{current};
+    auto add = [&sweep](const Accuracy::Setting& setting) {
+        if (std::find(sweep.begin(), sweep.end(), setting) == sweep.end()) {
+            sweep.push_back(setting);
+        }
+    };
+    for (const Backend backend : {Backend::RAY, Backend::CARTESIAN}) {
+        for (const double factor : Simulation::ACCURACY_STEP_FACTORS) {
+            add({backend, Precision::DOUBLE, factor * settings.stepSize, settings.adaptive.rtol});
+        }
+    }
+    for (const double rtol : Simulation::ACCURACY_TOLERANCES) {
+        add({Backend::ADAPTIVE, Precision::DOUBLE, settings.stepSize, rtol});
+    }
+
+    // Reference for fates and for rays without an exact orbit
+    const Accuracy::Setting referenceSetting{Backend::ADAPTIVE, Precision::DOUBLE, settings.stepSize,
+                                            Simulation::ACCURACY_REFERENCE_RTOL};
+    const Accuracy::Run reference{Accuracy::run(rays, settings, referenceSetting, lambda)};
+    std::cout << "Reference:   " << referenceSetting.flags() << ", " << reference.rhsEvaluations
+              << " RHS evals, " << reference.seconds << " s\n";
+
+    // Check the reference against the exact orbits and, far from the hole,
+    // the first-order weak-field formula. What the latter leaves out is of
+    // order (rs/b)², so its residual times (b/rs)² should stay of order one.
+    int exactRays{0};
+    double exactError{0.0};
+    int weakRays{0};
+    double weakLow{HUGE_VAL};
+    double weakHigh{0.0};
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        const Ray& ref{reference.rays[i]};
+        double exact{0.0};
+        if (!Accuracy::nearCritical(ref) && Accuracy::exactDeflection(rays[i], ref, exact)) {
+            ++exactRays;
+            exactError = std::max(exactError, std::abs(ref.deflection - exact));
+        }
+        const double b{std::abs(ref.L / ref.E) / BlackHole::rs};
+        if (!ref.isCaptured() && !rays[i].hasEscaped(Simulation::MAX_DISTANCE) &&
+            b >= Simulation::ACCURACY_WEAK_FIELD_B) {
+            ++weakRays;
+            const double weak{Accuracy::weakFieldDeflection(b * BlackHole::rs, Accuracy::alongPath(rays[i]),
+                                                            Accuracy::alongPath(ref))};
+            const double k{std::abs(ref.deflection - weak) * b * b};
+            weakLow = std::min(weakLow, k);
+            weakHigh = std::max(weakHigh, k);
+        }
+    }
+    std::cout << "Exact orbit: " << exactRays << " rays, reference within " << exactError << " rad\n";
+    if (weakRays > 0) {
+        std::cout << "Weak field:  " << weakRays << " rays with b >= " << Simulation::ACCURACY_WEAK_FIELD_B
+                  << " rs, reference - first order = k (rs/b)^2 with k in [" << weakLow << ", " << weakHigh
+                  << "]\n";
+    } else {
+        std::cout << "Weak field:  no escaping rays with b >= " << Simulation::ACCURACY_WEAK_FIELD_B << " rs\n";
+    }
+
+    const std::string sweepPath{options.output + ".accuracy.csv"};
+    std::ofstream out(sweepPath);
+    if (!out) {
+        std::cerr << "Failed to open " << sweepPath << " for writing\n";
+        return -1;
+    }
+    out.precision(9);
+    out << "integrator,precision,step,tolerance,steps,rhs_evaluations,seconds,max_error,median_error,"
+           "fate_mismatches,max_null_drift,max_l_drift,meets_target\n";
+
+    // Score each setting as it finishes; only the current run is kept, for
+    // the per-ray file
+    std::cout << "Setting                                RHS evals   seconds    max err     median  fates"
+                 "  null drift     L drift\n";
+    std::vector<Accuracy::Score> scores;
+    std::vector<long long> costs;
+    Accuracy::Run currentRun;
+    int compared{0};
+    int excluded{0};
+    for (const Accuracy::Setting& setting : sweep) {
+        Accuracy::Run run{Accuracy::run(rays, settings, setting, lambda)};
+        const Accuracy::Score score{Accuracy::score(rays, run, reference)};
+        compared = score.compared;
+        excluded = score.excluded;
+        scores.push_back(score);
+        costs.push_back(run.rhsEvaluations);
+
+        char line[192];
+        std::snprintf(line, sizeof(line), "%-36s %11lld %9.3f %10.3e %10.3e %6d %11.3e %11.3e%s\n",
+                      setting.flags().c_str(), run.rhsEvaluations, run.seconds, score.maxError,
+                      score.medianError, score.fateMismatches, score.maxNullDrift, score.maxAngularDrift,
+                      scores.size() == 1 ? "  (current)" : "");
+        std::cout << line;
+        out << setting.integrator() << ','
+            << (setting.precision == Precision::FLOAT ? "float" : "double") << ',' << setting.stepSize << ','
+            << (setting.backend == Backend::ADAPTIVE ? setting.rtol : 0.0) << ',' << run.steps << ','
+            << run.rhsEvaluations << ',' << run.seconds << ',' << score.maxError << ',' << score.medianError
+            << ',' << score.fateMismatches << ',' << score.maxNullDrift << ',' << score.maxAngularDrift << ','
+            << (score.meets(options.accuracyTarget) ? 1 : 0) << '\n';
+        if (scores.size() == 1) {
+            currentRun = std::move(run);
+        }
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << sweepPath << "\n";
+        return -1;
+    }
+    std::cout << "Errors over " << compared << " rays; " << excluded << " within "
+              << Simulation::ACCURACY_CRITICAL_BAND << " of b_crit left out\n";
+
+    // Cheapest setting meeting the target
+    std::size_t best{sweep.size()};
+    for (std::size_t i{0}; i < sweep.size(); ++i) {
+        if (scores[i].meets(options.accuracyTarget) && (best == sweep.size() || costs[i] < costs[best])) {
+            best = i;
+        }
+    }
+    if (best == sweep.size()) {
+        std::cout << "No setting swept stays within " << options.accuracyTarget
+                  << " rad of the reference with every fate right\n";
+    } else if (best == 0) {
+        std::cout << "The current setting is the cheapest within " << options.accuracyTarget << " rad\n";
+    } else {
+        const double ratio{static_cast<double>(costs[0]) / static_cast<double>(std::max(costs[best], 1LL))};
+        std::cout << "Cheapest setting within " << options.accuracyTarget << " rad: " << sweep[best].flags()
+                  << " (" << costs[best] << " RHS evals, ";
+        if (scores[0].meets(options.accuracyTarget)) {
+            std::cout << std::setprecision(3) << ratio << "x fewer than the current setting)\n";
+        } else {
+            std::cout << "where the current setting misses the target)\n";
+        }
+    }
+    if (options.accuracyTarget < 10.0 * exactError) {
+        std::cout << "The target is within 10x of the reference's own error; tighten "
+                     "Simulation::ACCURACY_REFERENCE_RTOL to trust errors that small\n";
+    }
+
+    // Per-ray drift and deflections of the current setting
+    const std::string driftPath{options.output + ".drift.csv"};
+    std::ofstream drift(driftPath);
+    if (!drift) {
+        std::cerr << "Failed to open " << driftPath << " for writing\n";
+        return -1;
+    }
+    drift.precision(17);
+    drift << "ray,scenario,b,state,state_reference,deflection,deflection_reference,deflection_exact,"
+             "deflection_weak_field,null_drift,l_drift\n";
+    const double criticalB{1.5 * std::sqrt(3.0) * BlackHole::rs};
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        const Ray& ray{currentRun.rays[i]};
+        const double b{std::abs(ray.L / ray.E)};
+        drift << i << ',' << scenarioName(ray.scenario) << ',' << b / criticalB << ',' << stateName(ray) << ','
+              << stateName(reference.rays[i]) << ',' << ray.deflection << ',' << reference.rays[i].deflection << ',';
+        double exact{0.0};
+        if (Accuracy::exactDeflection(rays[i], ray, exact)) {
+            drift << exact;
+        }
+        drift << ',';
+        if (!ray.isCaptured() && b >= Simulation::ACCURACY_WEAK_FIELD_B * BlackHole::rs) {
+            drift << Accuracy::weakFieldDeflection(b, Accuracy::alongPath(rays[i]), Accuracy::alongPath(ray));
+        }
+        drift << ',' << currentRun.nullDrift[i] << ',' << currentRun.angularDrift[i] << '\n';
+    }
+    if (!drift) {
+        std::cerr << "Failed to write " << driftPath << "\n";
+        return -1;
+    }
+    std::cout << "Sweep written to " << sweepPath << ", per-ray drift to " << driftPath << "\n";
+    return 0;
+}
+
+bool writeLookup(const Physics::BeamField& field, const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+
+    out.precision(9);
+    out << "ray,y,state,deflection\n";
+    for (size_t i{0}; i < field.size(); ++i) {
+        out << i << ',' << field.y[i] << ',' << (field.captured[i] ? "captured" : "escaped") << ','
+            << field.deflection[i] << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace Headless
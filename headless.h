@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "deflection_table.h"
+#include "options.h"
+#include "recording.h"
+#include "shard.h"
+#include "simulation.h"
+
+// Headless batch driver: runs the simulation without any window or GL context
+namespace Headless {
+    // Step the simulator for options.frames frames as fast as possible,
+    // write results and print throughput. Returns a process exit code.
+    // A shard (options.shardCount > 1) writes to its own files, with
+    // statistics for Sharding::merge.
+    int run(Simulation::Simulator& sim, const Options& options);
+
+    // Write per-ray final state and deflection as CSV; ray numbers are
+    // positions in the full ray set when the simulator holds one shard
+    bool writeResults(const Simulation::Simulator& sim, const std::string& path,
+                      const Sharding::Shard& shard = Sharding::Shard{});
+
+    // Write every stored trail point as CSV (ray, index, x, y)
+    bool writeTrails(const Simulation::Simulator& sim, const std::string& path,
+                     const Sharding::Shard& shard = Sharding::Shard{});
+
+    // Classify options.lookupRays parallel beam rays by table lookup, print
+    // throughput and write OUTPUT.lookup.csv. Returns a process exit code.
+    int runLookup(const Physics::DeflectionTable& table, const Options& options);
+
+    // Render one lensed background frame to options.lensOutput and print
+    // pixels/sec. Returns a process exit code.
+    int runLens(const Physics::DeflectionTable& table, const Options& options);
+
+    // Print a recording's size and per-state ray counts (opening it maps
+    // the file; nothing is read up front). Returns a process exit code.
+    int runReplay(const Recording::Replay& replay);
+
+    // Run the same rays through the SI reference integrator and the
+    // geometrized one in double and float for options.frames steps, write
+    // OUTPUT.precision.csv and print deflection errors by impact parameter
+    // with the range where float is safe. Returns a process exit code.
+    int runPrecisionReport(const std::vector<Ray>& rays, const Simulation::Settings& settings,
+                           const Options& options);
+
+    // Sweep integrators and step sizes over the same rays, started together
+    // and run for options.frames steps of the current step size. Each
+    // setting is scored against a tight adaptive reference by deflection
+    // error, with its null-constraint and angular momentum drift and its
+    // cost in RHS evaluations; the reference is itself checked against the
+    // exact orbits and the weak-field formula. Writes OUTPUT.accuracy.csv
+    // (one row per setting) and OUTPUT.drift.csv (per ray, current setting)
+    // and recommends the cheapest setting within options.accuracyTarget.
+    // Returns a process exit code.
+    int runAccuracyReport(const std::vector<Ray>& rays, const Simulation::Settings& settings,
+                          const Options& options);
+
+    // Write a classified beam as CSV (ray, y, state, deflection)
+    bool writeLookup(const Physics::BeamField& field, const std::string& path);
+}
@@ -0,0 +1,204 @@
+#include "lensing.h"
+#include "constants.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+
+namespace Lensing {
+
+namespace {
+
+// Matches the window clear color
+constexpr unsigned char BACKGROUND_RGB[3]{5, 5, 13};
+
+// Next PPM header token, skipping whitespace and comments
+bool readToken(std::istream& in, std::string& token) {
+    token.clear();
+    int c{in.get()};
+    while (c != EOF) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') {
+                c = in.get();
+            }
+        } else if (!std::isspace(c)) {
+            break;
+        }
+        c = in.get();
+    }
+    while (c != EOF && !std::isspace(c)) {
+        token.push_back(static_cast<char>(c));
+        c = in.get();
+    }
+    return !token.empty();
+}
+
+int wrap(int i, int n) {
+    const int m{i % n};
+    return m < 0 ? m + n : m;
+}
+
+// Bilinear sample with wrap-around; u, v in texels
+void sample(const Image& image, double u, double v, unsigned char* rgb) {
+    const double fu{std::floor(u)};
+    const double fv{std::floor(v)};
+    const double tu{u - fu};
+    const double tv{v - fv};
+    const int x0{wrap(static_cast<int>(fu), image.width)};
+    const int y0{wrap(static_cast<int>(fv), image.height)};
+    const int x1{wrap(x0 + 1, image.width)};
+    const int y1{wrap(y0 + 1, image.height)};
+
+    const unsigned char* p00{&image.rgb[3 * (static_cast<std::size_t>(y0) * image.width + x0)]};
+    const unsigned char* p10{&image.rgb[3 * (static_cast<std::size_t>(y0) * image.width + x1)]};
+    const unsigned char* p01{&image.rgb[3 * (static_cast<std::size_t>(y1) * image.width + x0)]};
+    const unsigned char* p11{&image.rgb[3 * (static_cast<std::size_t>(y1) * image.width + x1)]};
+    for (int k{0}; k < 3; ++k) {
+        const double top{p00[k] + tu * (p10[k] - p00[k])};
+        const double bottom{p01[k] + tu * (p11[k] - p01[k])};
+        rgb[k] = static_cast<unsigned char>(top + tv * (bottom - top) + 0.5);
+    }
+}
+
+} // namespace
+
+Image::Image(int w, int h)
+    : width{w}, height{h}, rgb(static_cast<std::size_t>(w) * static_cast<std::size_t>(h) * 3, 0) {
+}
+
+Settings::Settings()
+    : sourceDistance{Visual::LENS_SOURCE_DISTANCE},
+      halfWidth{Visual::VIEW_WIDTH},
+      planeHalfWidth{Visual::VIEW_WIDTH},
+      planeHalfHeight{Visual::VIEW_HEIGHT},
+      tileSize{Visual::LENS_TILE_SIZE} {
+}
+
+bool readPPM(const std::string& path, Image& image) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    std::string magic, width, height, maxval;
+    if (!readToken(in, magic) || magic != "P6" || !readToken(in, width) ||
+        !readToken(in, height) || !readToken(in, maxval) || maxval != "255") {
+        return false;
+    }
+
+    const int w{std::atoi(width.c_str())};
+    const int h{std::atoi(height.c_str())};
+    if (w <= 0 || h <= 0) {
+        return false;
+    }
+
+    // readToken consumed the single whitespace byte after maxval
+    image = Image{w, h};
+    in.read(reinterpret_cast<char*>(image.rgb.data()), static_cast<std::streamsize>(image.rgb.size()));
+    return static_cast<bool>(in);
+}
+
+bool writePPM(const std::string& path, const Image& image) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    out << "P6\n" << image.width << ' ' << image.height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(image.rgb.data()), static_cast<std::streamsize>(image.rgb.size()));
+    return static_cast<bool>(out);
+}
+
+Image starField(int width, int height, int starCount, unsigned seed) {
+    Image image{width, height};
+    std::vector<float> light(image.rgb.size(), 0.0f);
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> distX(0.0f, static_cast<float>(width));
+    std::uniform_real_distribution<float> distY(0.0f, static_cast<float>(height));
+    std::uniform_real_distribution<float> distBrightness(0.3f, 1.0f);
+    std::uniform_real_distribution<float> distTint(-0.15f, 0.15f);
+
+    // Splat each star as a small Gaussian, wrapping at the edges
+    for (int i{0}; i < starCount; ++i) {
+        const float sx{distX(gen)};
+        const float sy{distY(gen)};
+        const float brightness{distBrightness(gen)};
+        const float tint{distTint(gen)};
+        const float color[3]{brightness * (1.0f + tint), brightness, brightness * (1.0f - tint)};
+
+        for (int dy{-2}; dy <= 2; ++dy) {
+            for (int dx{-2}; dx <= 2; ++dx) {
+                const int px{static_cast<int>(sx) + dx};
+                const int py{static_cast<int>(sy) + dy};
+                const float ox{static_cast<float>(px) + 0.5f - sx};
+                const float oy{static_cast<float>(py) + 0.5f - sy};
+                const float weight{std::exp(-(ox * ox + oy * oy) / 0.8f)};
+                const std::size_t index{3 * (static_cast<std::size_t>(wrap(py, height)) * width + wrap(px, width))};
+                for (int k{0}; k < 3; ++k) {
+                    light[index + k] += weight * color[k];
+                }
+            }
+        }
+    }
+
+    for (std::size_t i{0}; i < light.size(); ++i) {
+        const float value{BACKGROUND_RGB[i % 3] + 255.0f * light[i]};
+        image.rgb[i] = static_cast<unsigned char>(std::min(255.0f, value));
+    }
+    return image;
+}
+
+void render(const Physics::DeflectionTable& table, const Image& background,
+            const Settings& settings, ThreadPool& pool, Image& out) {
+    const int tile{std::max(1, settings.tileSize)};
+    const int tilesX{(out.width + tile - 1) / tile};
+    const int tilesY{(out.height + tile - 1) / tile};
+
+    const double pixelSize{2.0 * settings.halfWidth / out.width};
+    const double halfHeight{0.5 * pixelSize * out.height};
+    const double texelsPerMeterX{background.width / (2.0 * settings.planeHalfWidth)};
+    const double texelsPerMeterY{background.height / (2.0 * settings.planeHalfHeight)};
+
+    pool.parallelFor(static_cast<std::size_t>(tilesX) * tilesY, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t t{begin}; t < end; ++t) {
+            const int x0{static_cast<int>(t % tilesX) * tile};
+            const int y0{static_cast<int>(t / tilesX) * tile};
+            const int x1{std::min(out.width, x0 + tile)};
+            const int y1{std::min(out.height, y0 + tile)};
+
+            for (int j{y0}; j < y1; ++j) {
+                const double y{halfHeight - (j + 0.5) * pixelSize};
+                for (int i{x0}; i < x1; ++i) {
+                    const double x{-settings.halfWidth + (i + 0.5) * pixelSize};
+                    unsigned char* rgb{&out.rgb[3 * (static_cast<std::size_t>(j) * out.width + i)]};
+
+                    // Captured rays show the shadow
+                    const double b{std::sqrt(x * x + y * y)};
+                    double total{0.0};
+                    if (table.turning(b, total)) {
+                        rgb[0] = rgb[1] = rgb[2] = 0;
+                        continue;
+                    }
+
+                    // Bent back toward the observer: misses the background plane
+                    const double cosine{std::cos(total)};
+                    if (cosine <= 0.0) {
+                        std::copy(BACKGROUND_RGB, BACKGROUND_RGB + 3, rgb);
+                        continue;
+                    }
+
+                    // Radial position where the outgoing ray crosses the plane
+                    const double rho{b - settings.sourceDistance * std::sin(total) / cosine};
+                    const double scale{rho / b};
+                    const double u{(x * scale + settings.planeHalfWidth) * texelsPerMeterX - 0.5};
+                    const double v{(settings.planeHalfHeight - y * scale) * texelsPerMeterY - 0.5};
+                    sample(background, u, v, rgb);
+                }
+            }
+        }
+    });
+}
+
+} // namespace Lensing
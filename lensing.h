@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "deflection_table.h"
+#include "thread_pool.h"
+
+// CPU renderer for what a distant observer sees through the black hole.
+// Each pixel is a ray arriving at impact parameter b = |pixel position|; the
+// deflection table gives its total bend, which maps it onto a background
+// plane behind the hole (stars or an image). No GL, so it runs headless.
+namespace Lensing {
+    // 8-bit RGB image, rows top to bottom
+    struct Image {
+        int width;
+        int height;
+        std::vector<unsigned char> rgb;
+
+        Image(int w = 0, int h = 0);
+    };
+
+    // Binary PPM (P6, maxval 255)
+    bool readPPM(const std::string& path, Image& image);
+    bool writePPM(const std::string& path, const Image& image);
+
+    // Rasterize a seeded random star field covering the background plane
+    Image starField(int width, int height, int starCount, unsigned seed);
+
+    struct Settings {
+        double sourceDistance;  // Background plane distance behind the hole
+        double halfWidth;       // Half the output's horizontal extent (world units)
+        double planeHalfWidth;  // Background image extent on its plane; tiles beyond
+        double planeHalfHeight;
+        int tileSize;           // Square tile edge in pixels (one task each)
+
+        Settings();
+    };
+
+    // Render the lensed background into out (its size sets the resolution),
+    // with screen tiles spread across the pool
+    void render(const Physics::DeflectionTable& table, const Image& background,
+                const Settings& settings, ThreadPool& pool, Image& out);
+}
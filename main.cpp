@@ -1,75 +1,275 @@
 #include <iostream>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
 
 // Project headers
+#include "capture.h"
+#include "checkpoint.h"
 #include "constants.h"
+#include "deflection_table.h"
+#include "headless.h"
+#include "metric.h"
+#include "options.h"
+#include "physics.h"
+#include "profiler.h"
 #include "ray.h"
+#include "recording.h"
 #include "rendering.h"
+#include "scenario.h"
+#include "shard.h"
+#include "sim_clock.h"
+#include "simulation.h"
 
-void generateOrbitingRay(std::vector<Ray>& rays) {
-    const double orbitStartX{-0.9 * Visual::VIEW_WIDTH};
-    const double orbitStartY{2.577934 * BlackHole::rs};
-    rays.emplace_back(orbitStartX, orbitStartY, Physics::c, 0.0,
-                      RayScenario::ORBITING, Visual::ORBITING_START);
-}
-
-void generatePointSourceRays(std::vector<Ray>& rays) {
-    const int numPointRays{25};
-    const double toBlackHoleX{0.0 - Visual::POINT_SOURCE_X};
-    const double toBlackHoleY{0.0 - Visual::POINT_SOURCE_Y};
-    const double baseAngle{std::atan2(toBlackHoleY, toBlackHoleX)};
-
-    for (int i{0}; i < numPointRays; ++i) {
-        const double coneSpread{M_PI / 3.0};
-        const double angleOffset{-coneSpread / 2.0 + coneSpread * static_cast<double>(i) / static_cast<double>(numPointRays - 1)};
-        const double angle{baseAngle + angleOffset};
-        const double vx{Physics::c * std::cos(angle)};
-        const double vy{Physics::c * std::sin(angle)};
-        rays.emplace_back(Visual::POINT_SOURCE_X, Visual::POINT_SOURCE_Y, vx, vy,
-                          RayScenario::POINT_SOURCE, Visual::POINT_SOURCE_START);
-    }
-}
-
-void generateParallelRays(std::vector<Ray>& rays) {
-    const int numParallelRays{70};
-    const double parallelStartX{-1e11};
-    for (int i{0}; i < numParallelRays; ++i) {
-        const double t{static_cast<double>(i) / static_cast<double>(numParallelRays - 1)};
-        const double startY{-Visual::VIEW_HEIGHT + t * 2.0 * Visual::VIEW_HEIGHT};
-        rays.emplace_back(parallelStartX, startY, Physics::c, 0.0,
-                          RayScenario::PARALLEL, Visual::PARALLEL_START);
-    }
-}
-
-std::vector<Ray> generateRays() {
-    std::vector<Ray> rays;
+int main(int argc, char** argv) {
+    const Options options{parseOptions(argc, argv)};
+
+    // Video on stdout: everything else goes to stderr
+    if (options.capture == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    std::cout << "\n=== Black Hole Simulation ===\n";
 
-    generateOrbitingRay(rays);
-    generatePointSourceRays(rays);
-    generateParallelRays(rays);
+    // Fan a batch run out to local shard processes, or combine the shards
+    // of a run spread across a scheduler
+    if (options.localShards > 0) {
+        return Sharding::runLocal(argc, argv, options.output, options.localShards);
+    }
+    if (options.mergeShards > 0) {
+        return Sharding::merge(options.output, options.mergeShards);
+    }
+
+    if (!Physics::setBatchKernel(options.simd)) {
+        std::cerr << "SIMD kernel '" << options.simd << "' is not available on this CPU\n";
+        return -1;
+    }
+
+    Simulation::Settings settings;
+    if (options.integrator == "batch") {
+        settings.backend = Simulation::Backend::BATCH;
+    } else if (options.integrator == "adaptive") {
+        settings.backend = Simulation::Backend::ADAPTIVE;
+    } else if (options.integrator == "cartesian") {
+        settings.backend = Simulation::Backend::CARTESIAN;
+    } else if (options.integrator == "geometrized") {
+        settings.backend = Simulation::Backend::GEOMETRIZED;
+    }
+    settings.precision = options.precision == "float" ? Simulation::Precision::FLOAT
+                                                      : Simulation::Precision::DOUBLE;
+    if (options.metric == "reissner-nordstrom") {
+        settings.metric.kind = Physics::MetricKind::REISSNER_NORDSTROM;
+    } else if (options.metric == "kerr") {
+        settings.metric.kind = Physics::MetricKind::KERR_EQUATORIAL;
+    } else if (options.metric == "flat") {
+        settings.metric.kind = Physics::MetricKind::FLAT;
+    }
+    settings.metric.charge = options.charge;
+    settings.metric.spin = options.spin;
+    settings.stepSize = options.stepSize;
+    settings.threads = options.threads;
+    settings.adaptive.rtol = options.tolerance;
+    settings.trails.policy = options.trailPolicy == "ring" ? TrailPolicy::RING : TrailPolicy::DECIMATE;
+    settings.trails.capacity = static_cast<std::size_t>(options.trailCapacity);
+    settings.trails.tolerance = options.trailTolerance;
+    settings.seed = options.seed != 0 ? options.seed : std::random_device{}();
 
+    // Lookup modes: classify a large beam or render the lensed background
+    // from the cached deflection table
+    Physics::DeflectionTable table;
+    if (options.lookupRays > 0 || !options.lensOutput.empty()) {
+        table = Physics::DeflectionTable::loadOrBuild(options.deflectionCache, Visual::PARALLEL_START_X,
+                                                      Simulation::MAX_DISTANCE,
+                                                      Simulation::DEFLECTION_TABLE_TOLERANCE);
+        if (!options.lensOutput.empty()) {
+            return Headless::runLens(table, options);
+        }
+        if (options.headless) {
+            return Headless::runLookup(table, options);
+        }
+    }
+
+    // Playback: map the recording and draw it, with no rays to integrate
+    if (!options.replay.empty()) {
+        Recording::Replay replay;
+        if (!replay.open(options.replay)) {
+            return -1;
+        }
+        std::cout << "Replaying " << replay.rayCount() << " rays over " << replay.frameCount() << " steps\n";
+        if (options.headless) {
+            return Headless::runReplay(replay);
+        }
+        if (options.replayStep > replay.frameCount()) {
+            std::cerr << "--replay-step " << options.replayStep << " is past the last step ("
+                      << replay.frameCount() << ")\n";
+            return -1;
+        }
+
+        Simulation::Simulator empty{std::vector<Ray>{}, settings};
+        Rendering::RenderEngine engine{
+            Visual::WINDOW_WIDTH,
+            Visual::WINDOW_HEIGHT,
+            "2D Black Hole Simulator - Replay",
+            empty,
+            false,
+            false,
+            Simulation::ClockSettings{},
+            options.stars,
+            options.capture.empty(),
+            !options.immediateStars
+        };
+        engine.clock.settings.stepsPerSecond = options.stepsPerSecond;
+        engine.clock.settings.speed = options.speed;
+        engine.setReplay(replay, options.replayStep);
+        engine.camera.look(glm::dvec2(options.centerX, options.centerY), options.zoom);
+        if (!options.capture.empty()) {
+            return Capture::run(engine, options);
+        }
+        while (!engine.shouldClose()) {
+            engine.beginFrame(Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT);
+            engine.updatePhysics();
+            engine.drawFrame();
+            engine.endFrame();
+            PROFILE_FRAME();
+        }
+        return 0;
+    }
+
+    // Built-in scene or scenario file, expanded straight into the ray store,
+    // or a checkpoint, which also brings the settings it was run with
+    Checkpoint::Snapshot snapshot;
+    std::vector<Ray> rays;
+    if (!options.resume.empty()) {
+        if (!Checkpoint::load(options.resume, snapshot)) {
+            return -1;
+        }
+        const int threads{settings.threads};
+        settings = snapshot.settings;
+        settings.threads = threads;
+        rays = std::move(snapshot.rays);
+        std::cout << "Resuming " << options.resume << " at step " << snapshot.frame << "\n";
+    } else {
+        std::vector<Scenario::Emitter> emitters;
+        if (options.scenarioFile.empty()) {
+            emitters = Scenario::builtin(options.scenario);
+        } else if (!Scenario::load(options.scenarioFile, emitters)) {
+            return -1;
+        }
+        rays = Scenario::generate(emitters, settings.stepSize);
+    }
     std::cout << "Total rays: " << rays.size() << "\n";
 
-    return rays;
-}
+    // The metric's stepping loop is chosen here, once; generated rays get
+    // its conserved quantities (a checkpoint already holds them)
+    if (!Physics::setMetric(settings.metric)) {
+        return -1;
+    }
+    if (options.resume.empty()) {
+        Physics::initializeRays(rays);
+    }
+    if (settings.metric.kind != Physics::MetricKind::SCHWARZSCHILD) {
+        std::cout << "Metric: " << Physics::metricName(settings.metric.kind) << "\n";
+    }
+
+    if (options.precisionReport) {
+        return Headless::runPrecisionReport(rays, settings, options);
+    }
+    if (options.accuracyReport) {
+        return Headless::runAccuracyReport(rays, settings, options);
+    }
 
-int main() {
-    std::cout << "\n=== Black Hole Simulation ===\n";
+    const Sharding::Shard shard{options.shardIndex, options.shardCount};
+    if (shard.sharded()) {
+        rays = shard.select(std::move(rays));
+        std::cout << "Shard " << shard.index << "/" << shard.count << ": " << rays.size() << " rays\n";
+    }
 
-    std::vector<Ray> rays{generateRays()};
+    Simulation::Simulator sim{std::move(rays), settings};
+    if (!options.resume.empty()) {
+        Checkpoint::restore(snapshot, sim);
+    }
+    std::cout << "Integration threads: " << sim.threadCount() << "\n";
+    if (settings.backend == Simulation::Backend::BATCH || settings.backend == Simulation::Backend::GEOMETRIZED) {
+        std::cout << "Batch kernel: " << Physics::batchKernelName() << "\n";
+    }
+
+    // Recording follows every step, whichever driver runs them
+    std::unique_ptr<Recording::Recorder> recorder;
+    if (!options.record.empty()) {
+        recorder = std::make_unique<Recording::Recorder>(options.record, sim);
+        if (!recorder->ok()) {
+            return -1;
+        }
+        sim.recorder = recorder.get();
+    }
+
+    // Checkpoints are taken on whichever thread steps the simulator
+    std::unique_ptr<Checkpoint::Writer> checkpoints;
+    if (!options.checkpoint.empty()) {
+        checkpoints = std::make_unique<Checkpoint::Writer>(options.checkpoint, options.checkpointEvery, sim);
+        sim.checkpoints = checkpoints.get();
+    }
+
+    if (options.headless) {
+        return Headless::run(sim, options);
+    }
+
+    // Room for right-click bursts, allocated before the renderer mirrors the
+    // trail store; recordings and checkpoints keep to the scene's rays
+    if (options.capture.empty() && !recorder && !checkpoints) {
+        sim.reserve(sim.rays.size() + static_cast<std::size_t>(options.rayPool));
+    }
+
+    Simulation::ClockSettings clock;
+    clock.stepsPerSecond = options.stepsPerSecond;
+    clock.speed = options.speed;
+    clock.maxThroughput = options.maxThroughput;
+    clock.frameBudget = options.frameBudget;
 
     Rendering::RenderEngine engine{
         Visual::WINDOW_WIDTH,
         Visual::WINDOW_HEIGHT,
         "2D Black Hole Simulator - Organized Project",
-        rays
+        sim,
+        !options.immediateTrails,
+        options.pipeline,
+        clock,
+        options.stars,
+        options.capture.empty(),
+        !options.immediateStars
     };
+    engine.camera.look(glm::dvec2(options.centerX, options.centerY), options.zoom);
+    engine.burstSize = options.burst;
+    if (options.lookupRays > 0) {
+        engine.setBeamField(Physics::BeamField::classify(table, options.lookupRays, Visual::VIEW_HEIGHT));
+    }
+
+    int status{0};
+    if (!options.capture.empty()) {
+        status = Capture::run(engine, options);
+    } else {
+        while (!engine.shouldClose()) {
+            engine.beginFrame(Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT);
+            engine.updatePhysics();
+            engine.drawFrame();
+            engine.endFrame();
+            PROFILE_FRAME();
+        }
+    }
+
+    if (checkpoints) {
+        // Take the simulator back from the pipeline thread, then save the
+        // step the window closed on (or the last captured)
+        engine.pipeline.reset();
+        if (!checkpoints->save(sim)) {
+            return -1;
+        }
+        std::cout << "Checkpoint at step " << sim.frame << " written to " << options.checkpoint << "\n";
+    }
 
-    while (!engine.shouldClose()) {
-        engine.beginFrame(Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT);
-        engine.updatePhysics();
-        engine.drawFrame();
-        engine.endFrame();
+    if (!options.profile.empty()) {
+        Profiling::writeReports(options.profile);
     }
 
-    return 0;
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "metric.h"
+#include <cmath>
+#include <iostream>
+
+namespace Physics {
+
+MetricSettings::MetricSettings() : kind{MetricKind::SCHWARZSCHILD}, charge{0.0}, spin{0.0} {
+}
+
+namespace {
+
+using RayStepper = int (*)(const MetricSettings& settings, std::vector<Ray>& rays, const std::size_t* ids,
+                           std::size_t count, double dlambda, double maxDistance, int currentFrame,
+                           TrailStore& trails);
+
+// Same steps as Ray::integrate, with the metric's equations inlined
+template <typename Metric>
+int integrateRaysIn(const MetricSettings& settings, std::vector<Ray>& rays, const std::size_t* ids,
+                    std::size_t count, double dlambda, double maxDistance, int currentFrame, TrailStore& trails) {
+    const Metric metric{settings};
+    const double capture{metric.horizon() * 1.01};
+    int steps{0};
+    for (std::size_t i{0}; i < count; ++i) {
+        Ray& ray{rays[ids[i]]};
+        if (!ray.isActive(currentFrame) || ray.r <= capture || ray.hasEscaped(maxDistance)) {
+            continue;
+        }
+        rk4Step(ray, dlambda, metric);
+        ray.recordPosition(trails);
+        ray.updateDeflection();
+        ++steps;
+    }
+    return steps;
+}
+
+template <typename Metric>
+void initializeRaysIn(const MetricSettings& settings, std::vector<Ray>& rays) {
+    const Metric metric{settings};
+    for (Ray& ray : rays) {
+        metric.constants(ray, ray.E, ray.L);
+        // A direction no photon can take there (or no position at all): the
+        // ray starts captured, on the horizon, and is never stepped
+        if (!std::isfinite(ray.E) || !std::isfinite(ray.L) || !std::isfinite(ray.r)) {
+            ray.E = 0.0;
+            ray.L = 0.0;
+            ray.v_r = 0.0;
+            ray.v_phi = 0.0;
+            ray.r = metric.horizon();
+        }
+    }
+}
+
+struct MetricChoice {
+    MetricSettings settings;
+    double horizon;
+    double photonSphere;
+    RayStepper integrate;
+    void (*initialize)(const MetricSettings&, std::vector<Ray>&);
+};
+
+template <typename Metric>
+MetricChoice choose(const MetricSettings& settings) {
+    const Metric metric{settings};
+    return {settings, metric.horizon(), metric.photonSphere(), integrateRaysIn<Metric>, initializeRaysIn<Metric>};
+}
+
+MetricChoice& activeChoice() {
+    static MetricChoice choice{choose<Schwarzschild>(MetricSettings{})};
+    return choice;
+}
+
+} // namespace
+
+bool setMetric(const MetricSettings& settings) {
+    switch (settings.kind) {
+        case MetricKind::SCHWARZSCHILD:
+            activeChoice() = choose<Schwarzschild>(settings);
+            return true;
+        case MetricKind::REISSNER_NORDSTROM:
+            if (!(settings.charge >= 0.0 && settings.charge < 1.0)) {
+                std::cerr << "Reissner-Nordstrom charge must be in [0, 1) (Q/M)\n";
+                return false;
+            }
+            activeChoice() = choose<ReissnerNordstrom>(settings);
+            return true;
+        case MetricKind::KERR_EQUATORIAL:
+            if (!(settings.spin > -1.0 && settings.spin < 1.0)) {
+                std::cerr << "Kerr spin must be in (-1, 1) (a/M)\n";
+                return false;
+            }
+            activeChoice() = choose<KerrEquatorial>(settings);
+            return true;
+        case MetricKind::FLAT:
+            activeChoice() = choose<Flat>(settings);
+            return true;
+    }
+    return false;
+}
+
+const MetricSettings& activeMetric() {
+    return activeChoice().settings;
+}
+
+const char* metricName(MetricKind kind) {
+    switch (kind) {
+        case MetricKind::REISSNER_NORDSTROM: return "reissner-nordstrom";
+        case MetricKind::KERR_EQUATORIAL: return "kerr";
+        case MetricKind::FLAT: return "flat";
+        default: return "schwarzschild";
+    }
+}
+
+double captureRadius() {
+    return activeChoice().horizon * 1.01;
+}
+
+double horizonRadius() {
+    return activeChoice().horizon;
+}
+
+double photonSphereRadius() {
+    return activeChoice().photonSphere;
+}
+
+void initializeRays(std::vector<Ray>& rays) {
+    const MetricChoice& choice{activeChoice()};
+    choice.initialize(choice.settings, rays);
+}
+
+int integrateRays(std::vector<Ray>& rays, const std::size_t* ids, std::size_t count, double dlambda,
+                  double maxDistance, int currentFrame, TrailStore& trails) {
+    const MetricChoice& choice{activeChoice()};
+    return choice.integrate(choice.settings, rays, ids, count, dlambda, maxDistance, currentFrame, trails);
+}
+
+} // namespace Physics
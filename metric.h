@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "constants.h"
+#include "physics.h"
+#include "ray.h"
+#include "trail_store.h"
+
+// Spacetimes for the per-Ray integrator.
+//
+// Each metric is a policy type whose equations are inline members, so
+// rk4Step<Metric> compiles to straight-line code with no virtual call or
+// branch per RHS evaluation. rs is a compile-time constant; charge and spin
+// are fixed once at startup by setMetric, which also picks the matching
+// instantiation of the ray stepping loop.
+//
+// A policy provides:
+//   horizon()             Outer event horizon; rays within 1.01x are captured
+//   photonSphere()        Circular photon orbit drawn by the renderer (0 = none)
+//   constants(ray, E, L)  Conserved energy and angular momentum of a photon at
+//                         the ray's position with its coordinate velocity; NaN
+//                         where no photon can move that way
+//   rhs(y, E, L, out)     [dr/dλ, dφ/dλ, d²r/dλ², d²φ/dλ²] for y = [r, φ, dr/dλ, dφ/dλ]
+// All of it in the equatorial plane, in meters and the repo's λ.
+namespace Physics {
+    enum class MetricKind {
+        SCHWARZSCHILD,
+        REISSNER_NORDSTROM,  // Charged, non-rotating
+        KERR_EQUATORIAL,     // Rotating, rays in the equatorial plane
+        FLAT                 // Control: no gravity, an opaque disk of radius rs
+    };
+
+    struct MetricSettings {
+        MetricKind kind;
+        double charge;  // Reissner-Nordström Q/M, in [0, 1)
+        double spin;    // Kerr a/M, in (-1, 1); positive spins counter-clockwise
+
+        MetricSettings();
+    };
+
+    struct Schwarzschild {
+        explicit Schwarzschild(const MetricSettings& = MetricSettings{}) {}
+
+        static constexpr double horizon() { return BlackHole::rs; }
+        static constexpr double photonSphere() { return 1.5 * BlackHole::rs; }
+
+        static void constants(const Ray& ray, double& E, double& L) {
+            const double r{ray.r};
+            const double f{1.0 - BlackHole::rs / r};
+            const double dt_dlambda{std::sqrt((ray.v_r * ray.v_r) / (f * f) + (r * r * ray.v_phi * ray.v_phi) / f)};
+            L = r * r * ray.v_phi;
+            E = f * dt_dlambda;
+        }
+
+        static void rhs(const double y[4], double E, double, double out[4]) {
+            const double r{y[0]};
+            const double v_r{y[2]};
+            const double v_phi{y[3]};
+
+            const double f{1.0 - BlackHole::rs / r};
+
+            out[0] = v_r;
+            out[1] = v_phi;
+
+            const double dt_dlambda{E / f};
+            out[2] = -(BlackHole::rs / (2.0 * r * r)) * f * (dt_dlambda * dt_dlambda)
+                     + (BlackHole::rs / (2.0 * r * r * f)) * (v_r * v_r)
+                     + (r - BlackHole::rs) * (v_phi * v_phi);
+
+            out[3] = -2.0 * v_r * v_phi / r;
+        }
+    };
+
+    // f(r) = 1 - rs/r + rQ²/r², with rQ = (Q/M) rs/2
+    struct ReissnerNordstrom {
+        double rq2;
+
+        explicit ReissnerNordstrom(const MetricSettings& settings)
+            : rq2{settings.charge * settings.charge * 0.25 * BlackHole::rs * BlackHole::rs} {}
+
+        double horizon() const { return 0.5 * (BlackHole::rs + std::sqrt(BlackHole::rs * BlackHole::rs - 4.0 * rq2)); }
+        double photonSphere() const {
+            return 0.25 * (3.0 * BlackHole::rs + std::sqrt(9.0 * BlackHole::rs * BlackHole::rs - 32.0 * rq2));
+        }
+
+        void constants(const Ray& ray, double& E, double& L) const {
+            const double r{ray.r};
+            const double f{1.0 - BlackHole::rs / r + rq2 / (r * r)};
+            L = r * r * ray.v_phi;
+            E = f * std::sqrt((ray.v_r * ray.v_r) / (f * f) + (r * r * ray.v_phi * ray.v_phi) / f);
+        }
+
+        void rhs(const double y[4], double E, double, double out[4]) const {
+            const double r{y[0]};
+            const double v_r{y[2]};
+            const double v_phi{y[3]};
+            const double inv_r{1.0 / r};
+
+            const double f{1.0 - (BlackHole::rs - rq2 * inv_r) * inv_r};
+            const double df_dr{(BlackHole::rs - 2.0 * rq2 * inv_r) * inv_r * inv_r};
+            const double dt_dlambda{E / f};
+
+            out[0] = v_r;
+            out[1] = v_phi;
+            out[2] = 0.5 * df_dr * ((v_r * v_r) / f - f * (dt_dlambda * dt_dlambda)) + r * f * (v_phi * v_phi);
+            out[3] = -2.0 * v_r * v_phi * inv_r;
+        }
+    };
+
+    // Boyer-Lindquist equatorial plane with a = (a/M) rs/2. With E and L
+    // conserved, r² dr/dλ = ±√R and dφ/dλ = Φ(r), where
+    //   P = E (r² + a²) - a L,  Δ = r² - rs r + a²
+    //   R = P² - Δ (L - a E)²,  Φ = (a P / Δ + L - a E) / r²
+    // Differentiating gives r'' = R' / 2r⁴ - 2 r'² / r, which passes turning
+    // points without a sign choice, and φ'' = Φ'(r) r'.
+    struct KerrEquatorial {
+        double a;
+
+        explicit KerrEquatorial(const MetricSettings& settings) : a{settings.spin * 0.5 * BlackHole::rs} {}
+
+        double horizon() const {
+            const double m{0.5 * BlackHole::rs};
+            return m + std::sqrt(m * m - a * a);
+        }
+
+        // Circular orbit of photons moving in +φ: prograde for positive
+        // spin, retrograde for negative
+        double photonSphere() const {
+            const double m{0.5 * BlackHole::rs};
+            return 2.0 * m * (1.0 + std::cos(2.0 / 3.0 * std::acos(-a / m)));
+        }
+
+        // Null condition g_tt t'² + 2 g_tφ t' φ' + g_φφ φ'² + g_rr r'² = 0 for
+        // t'. Outside the ergosphere (g_tt < 0) the root taken is the positive
+        // one; inside it, the same branch continues for photons moving with
+        // the frame dragging. Against it, or radially, no photon exists there
+        // (no real root, or only t' <= 0) and E and L are NaN.
+        void constants(const Ray& ray, double& E, double& L) const {
+            const double r{ray.r};
+            const double g_tt{-(1.0 - BlackHole::rs / r)};
+            const double g_tphi{-BlackHole::rs * a / r};
+            const double g_phiphi{r * r + a * a + BlackHole::rs * a * a / r};
+            const double g_rr{r * r / (r * r - BlackHole::rs * r + a * a)};
+
+            const double b{2.0 * g_tphi * ray.v_phi};
+            const double c{g_phiphi * ray.v_phi * ray.v_phi + g_rr * ray.v_r * ray.v_r};
+            const double dt_dlambda{(-b - std::sqrt(b * b - 4.0 * g_tt * c)) / (2.0 * g_tt)};
+            if (!(dt_dlambda > 0.0)) {
+                E = L = std::numeric_limits<double>::quiet_NaN();
+                return;
+            }
+            E = -(g_tt * dt_dlambda + g_tphi * ray.v_phi);
+            L = g_tphi * dt_dlambda + g_phiphi * ray.v_phi;
+        }
+
+        void rhs(const double y[4], double E, double L, double out[4]) const {
+            const double r{y[0]};
+            const double v_r{y[2]};
+            const double v_phi{y[3]};
+            const double inv_r{1.0 / r};
+            const double r2{r * r};
+
+            const double delta{r2 - BlackHole::rs * r + a * a};
+            const double d_delta{2.0 * r - BlackHole::rs};
+            const double P{E * (r2 + a * a) - a * L};
+            const double K{L - a * E};
+            const double inv_delta{1.0 / delta};
+
+            // R' = 4 E r P - Δ' K²
+            const double dR{4.0 * E * r * P - d_delta * K * K};
+
+            // Φ = (A + K) / r² with A = a P / Δ
+            const double A{a * P * inv_delta};
+            const double dA{a * (2.0 * E * r - P * d_delta * inv_delta) * inv_delta};
+            const double dPhi{(dA - 2.0 * (A + K) * inv_r) * inv_r * inv_r};
+
+            out[0] = v_r;
+            out[1] = v_phi;
+            out[2] = 0.5 * dR * inv_r * inv_r * inv_r * inv_r - 2.0 * v_r * v_r * inv_r;
+            out[3] = dPhi * v_r;
+        }
+    };
+
+    // Straight lines in polar coordinates
+    struct Flat {
+        explicit Flat(const MetricSettings& = MetricSettings{}) {}
+
+        static constexpr double horizon() { return BlackHole::rs; }
+        static constexpr double photonSphere() { return 0.0; }
+
+        static void constants(const Ray& ray, double& E, double& L) {
+            L = ray.r * ray.r * ray.v_phi;
+            E = std::sqrt(ray.v_r * ray.v_r + ray.r * ray.r * ray.v_phi * ray.v_phi);
+        }
+
+        static void rhs(const double y[4], double, double, double out[4]) {
+            out[0] = y[2];
+            out[1] = y[3];
+            out[2] = y[0] * (y[3] * y[3]);
+            out[3] = -2.0 * y[2] * y[3] / y[0];
+        }
+    };
+
+    // out = a + b * factor, inline so rk4Step below is straight-line code
+    inline void addStateInline(const double a[4], const double b[4], double factor, double out[4]) {
+        for (int i{0}; i < 4; ++i) {
+            out[i] = a[i] + b[i] * factor;
+        }
+    }
+
+    // One RK4 step of a ray in the given metric
+    template <typename Metric>
+    inline void rk4Step(Ray& ray, double dlambda, const Metric& metric) {
+        const double y0[4]{ray.r, ray.phi, ray.v_r, ray.v_phi};
+        double k1[4], k2[4], k3[4], k4[4], temp[4];
+
+        // k1 = f(y0)
+        metric.rhs(y0, ray.E, ray.L, k1);
+
+        // k2 = f(y0 + k1*dlambda/2)
+        addStateInline(y0, k1, dlambda / 2.0, temp);
+        metric.rhs(temp, ray.E, ray.L, k2);
+
+        // k3 = f(y0 + k2*dlambda/2)
+        addStateInline(y0, k2, dlambda / 2.0, temp);
+        metric.rhs(temp, ray.E, ray.L, k3);
+
+        // k4 = f(y0 + k3*dlambda)
+        addStateInline(y0, k3, dlambda, temp);
+        metric.rhs(temp, ray.E, ray.L, k4);
+
+        // Update: y_{n+1} = y_n + (k1 + 2k2 + 2k3 + k4) * dlambda/6
+        ray.r += (dlambda / 6.0) * (k1[0] + 2.0 * k2[0] + 2.0 * k3[0] + k4[0]);
+        ray.phi += (dlambda / 6.0) * (k1[1] + 2.0 * k2[1] + 2.0 * k3[1] + k4[1]);
+        ray.v_r += (dlambda / 6.0) * (k1[2] + 2.0 * k2[2] + 2.0 * k3[2] + k4[2]);
+        ray.v_phi += (dlambda / 6.0) * (k1[3] + 2.0 * k2[3] + 2.0 * k3[3] + k4[3]);
+    }
+
+    // Select the metric for the whole process; false (with a message) if
+    // its parameters are out of range. Call before generating or stepping
+    // rays; the default is Schwarzschild.
+    bool setMetric(const MetricSettings& settings);
+
+    const MetricSettings& activeMetric();
+
+    // "schwarzschild", "reissner-nordstrom", "kerr" or "flat"
+    const char* metricName(MetricKind kind);
+
+    // Radius at or below which rays count as captured: 1.01 x the active
+    // metric's horizon
+    double captureRadius();
+
+    // Active metric's horizon and photon sphere (0 = none)
+    double horizonRadius();
+    double photonSphereRadius();
+
+    // Recompute E and L of freshly generated rays in the active metric
+    void initializeRays(std::vector<Ray>& rays);
+
+    // Ray::integrate in the active metric for rays[ids[0..count)]; returns
+    // the number of rays stepped. One indirect call per range, none per ray.
+    int integrateRays(std::vector<Ray>& rays, const std::size_t* ids, std::size_t count, double dlambda,
+                      double maxDistance, int currentFrame, TrailStore& trails);
+}
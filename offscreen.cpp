@@ -0,0 +1,82 @@
+#include "offscreen.h"
+#include <cstring>
+#include <iostream>
+
+namespace Rendering {
+
+OffscreenTarget::OffscreenTarget(int targetWidth, int targetHeight)
+    : width{targetWidth}, height{targetHeight}, fbo{0}, color{0}, pixelBuffers{}, next{0}, queued{0} {
+    if (!GLEW_VERSION_3_0) {
+        std::cerr << "OpenGL 3.0 not available, cannot render offscreen\n";
+        return;
+    }
+
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    const GLenum status{glCheckFramebufferStatus(GL_FRAMEBUFFER)};
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer incomplete (" << width << "x" << height << ")\n";
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+        fbo = 0;
+        color = 0;
+        return;
+    }
+
+    const GLsizeiptr bytes{static_cast<GLsizeiptr>(width) * height * 3};
+    glGenBuffers(PIXEL_BUFFERS, pixelBuffers);
+    for (const GLuint buffer : pixelBuffers) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+OffscreenTarget::~OffscreenTarget() {
+    if (fbo) {
+        glDeleteBuffers(PIXEL_BUFFERS, pixelBuffers);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &color);
+    }
+}
+
+void OffscreenTarget::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void OffscreenTarget::read() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[next]);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    next = (next + 1) % PIXEL_BUFFERS;
+    ++queued;
+}
+
+bool OffscreenTarget::collect(std::vector<unsigned char>& out) {
+    const int oldest{(next - queued + PIXEL_BUFFERS) % PIXEL_BUFFERS};
+    const std::size_t bytes{static_cast<std::size_t>(width) * height * 3};
+    out.resize(bytes);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[oldest]);
+    const void* pixels{glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes), GL_MAP_READ_BIT)};
+    if (pixels) {
+        std::memcpy(out.data(), pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    --queued;
+    return pixels != nullptr;
+}
+
+} // namespace Rendering
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+namespace Rendering {
+    // Framebuffer object drawn into instead of the window, at any resolution.
+    // Frames are read back through a ring of pixel buffers: read() only
+    // queues the copy, and collect() maps a buffer filled frames earlier, so
+    // the CPU does not wait for the GPU to finish the frame it just drew.
+    // Works on any GL 3.0 context, including Mesa's llvmpipe.
+    struct OffscreenTarget {
+        // Create the framebuffer; check ready() before use
+        OffscreenTarget(int width, int height);
+        ~OffscreenTarget();
+
+        OffscreenTarget(const OffscreenTarget&) = delete;
+        OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+        // False if the context lacks framebuffer objects (GL 3.0)
+        bool ready() const { return fbo != 0; }
+
+        // Draw into the framebuffer with a matching viewport
+        void bind();
+
+        // Queue a read of the frame just drawn. Collect a frame first when
+        // pending() == PIXEL_BUFFERS.
+        void read();
+
+        // Frames read but not yet collected
+        int pending() const { return queued; }
+
+        // Copy the oldest pending frame into out, width x height RGB8 with
+        // rows bottom to top; false if its buffer could not be mapped
+        bool collect(std::vector<unsigned char>& out);
+
+        static constexpr int PIXEL_BUFFERS{3};
+
+    private:
+        int width;
+        int height;
+        GLuint fbo;
+        GLuint color;
+        GLuint pixelBuffers[PIXEL_BUFFERS];
+        int next;        // Pixel buffer the next read() fills
+        int queued;
+    };
+}
@@ -0,0 +1,512 @@
+#include "options.h"
+#include "constants.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+Options::Options()
+    : headless{false},
+      frames{5000},
+      scenario{"all"},
+      output{"blackhole_results.csv"},
+      writeTrails{false},
+      integrator{"ray"},
+      precision{"double"},
+      precisionReport{false},
+      accuracyReport{false},
+      accuracyTarget{Simulation::ACCURACY_TARGET},
+      metric{"schwarzschild"},
+      charge{0.5},
+      spin{0.5},
+      tolerance{Simulation::ADAPTIVE_RTOL},
+      stepSize{Simulation::INTEGRATION_STEP},
+      stepsPerSecond{Simulation::STEPS_PER_SECOND},
+      speed{1.0},
+      maxThroughput{false},
+      frameBudget{Simulation::FRAME_BUDGET},
+      simd{"auto"},
+      threads{1},
+      trailPolicy{"decimate"},
+      trailCapacity{Visual::TRAIL_CAPACITY},
+      trailTolerance{Visual::TRAIL_TOLERANCE},
+      replayStep{0},
+      checkpointEvery{Simulation::CHECKPOINT_INTERVAL},
+      seed{0},
+      shardIndex{0},
+      shardCount{1},
+      localShards{0},
+      mergeShards{0},
+      immediateTrails{false},
+      immediateStars{false},
+      pipeline{false},
+      stars{Visual::NUM_STARS},
+      zoom{1.0},
+      centerX{0.0},
+      centerY{0.0},
+      burst{Visual::BURST_RAYS},
+      rayPool{Visual::RAY_POOL},
+      lookupRays{0},
+      deflectionCache{"deflection_table.bin"},
+      lensWidth{1920},
+      lensHeight{1080},
+      captureWidth{Visual::CAPTURE_WIDTH},
+      captureHeight{Visual::CAPTURE_HEIGHT},
+      captureFps{Visual::CAPTURE_FPS},
+      captureFrames{Visual::CAPTURE_FRAMES} {
+}
+
+// FILE.y4m, "-", or a PPM pattern whose only conversion is one %d (%05d etc)
+static bool validCaptureTarget(const std::string& target) {
+    if (target == "-" || (target.size() > 4 && target.compare(target.size() - 4, 4, ".y4m") == 0)) {
+        return true;
+    }
+    const std::size_t percent{target.find('%')};
+    if (percent == std::string::npos || target.find('%', percent + 1) != std::string::npos) {
+        return false;
+    }
+    std::size_t i{percent + 1};
+    while (i < target.size() && target[i] >= '0' && target[i] <= '9') {
+        ++i;
+    }
+    return i < target.size() && target[i] == 'd';
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --headless          Simulate without opening a window\n"
+              << "  --frames N          Simulation steps to run in headless mode (default 5000)\n"
+              << "  --rays SCENARIO     all, orbiting, point or parallel (default all)\n"
+              << "  --scenario FILE     Load rays from a scenario file instead of --rays\n"
+              << "  --output FILE       Headless results file (default blackhole_results.csv)\n"
+              << "  --trails            Also write full ray trails in headless mode\n"
+              << "  --integrator NAME   ray (per-Ray RK4), batch (SoA SIMD RK4), adaptive\n"
+              << "                      (Dormand-Prince 5(4)), cartesian (trig-free RK4) or\n"
+              << "                      geometrized (SIMD RK4 in units of rs), default ray\n"
+              << "  --precision P       Geometrized integrator precision: double or float\n"
+              << "                      (default double)\n"
+              << "  --precision-report  Headless: compare geometrized float and double\n"
+              << "                      deflections with the reference integrator by impact\n"
+              << "                      parameter, write OUTPUT.precision.csv and exit\n"
+              << "  --accuracy-report   Headless: sweep integrators and step sizes against a tight\n"
+              << "                      adaptive reference, track E/L drift, write\n"
+              << "                      OUTPUT.accuracy.csv and OUTPUT.drift.csv, recommend the\n"
+              << "                      cheapest setting within --accuracy-target and exit\n"
+              << "  --accuracy-target RAD\n"
+              << "                      Deflection error the recommendation allows (default 1e-3)\n"
+              << "  --metric NAME       schwarzschild, reissner-nordstrom, kerr (equatorial) or\n"
+              << "                      flat (no gravity), default schwarzschild; others need\n"
+              << "                      --integrator ray\n"
+              << "  --charge Q          Reissner-Nordstrom charge Q/M in [0, 1) (default 0.5)\n"
+              << "  --spin A            Kerr spin a/M in (-1, 1) (default 0.5)\n"
+              << "  --tolerance TOL     Adaptive integrator relative tolerance (default 1e-9)\n"
+              << "  --step DL           Affine parameter per simulation step (default 1); scenario\n"
+              << "                      start times stay in simulation time\n"
+              << "  --steps-per-second N\n"
+              << "                      Windowed simulation rate at 1x (default 60)\n"
+              << "  --speed X           Fast-forward (or slow down) the windowed clock by X\n"
+              << "  --max-throughput    Windowed: run as many steps per frame as fit the budget\n"
+              << "  --frame-budget MS   Stepping time per frame for --max-throughput (default 12)\n"
+              << "  --simd KERNEL       Batch kernel: auto, scalar, avx2, avx512 (default auto)\n"
+              << "  --threads N         Integration threads, 0 = all cores (default 1)\n"
+              << "  --trail-policy P    ring (keep newest points) or decimate (drop collinear\n"
+              << "                      points first), default decimate\n"
+              << "  --trail-capacity N  Trail points kept per ray (default 1024)\n"
+              << "  --trail-tolerance D Decimation tolerance in meters (default 62500, a\n"
+              << "                      quarter pixel at the deepest zoom)\n"
+              << "  --immediate-trails  Draw trails in immediate mode instead of GPU buffers\n"
+              << "  --immediate-stars   Draw stars in immediate mode instead of a GPU buffer\n"
+              << "  --pipeline          Simulate on a separate thread while the previous frame\n"
+              << "                      is drawn (windowed mode)\n"
+              << "  --stars N           Background stars, placed by --seed (default 200)\n"
+              << "  --zoom Z            Start the camera zoomed in Z times (scroll to zoom, drag\n"
+              << "                      to pan, R resets; default 1)\n"
+              << "  --center X,Y        Start the camera centered on X,Y meters (default 0,0)\n"
+              << "  --burst N           Rays per right-click burst in the window (default 1000;\n"
+              << "                      right-drag aims the burst)\n"
+              << "  --ray-pool N        Ray slots kept free for bursts; finished rays are recycled\n"
+              << "                      once they run out (default 4096)\n"
+              << "  --lookup-rays N     Classify N parallel beam rays by deflection table lookup\n"
+              << "                      instead of integration (headless: writes FILE.lookup.csv)\n"
+              << "  --deflection-cache FILE\n"
+              << "                      Deflection table cache (default deflection_table.bin)\n"
+              << "  --lens FILE         Render the lensed background to a PPM and exit\n"
+              << "  --lens-size WxH     Lensed frame resolution (default 1920x1080)\n"
+              << "  --lens-background F PPM image behind the hole (default random stars)\n"
+              << "  --capture TARGET    Render frames offscreen and stream them to FILE.y4m, a\n"
+              << "                      PPM sequence (a pattern like frame_%05d.ppm) or - (Y4M on\n"
+              << "                      stdout), without showing the window\n"
+              << "  --capture-size WxH  Capture resolution (default 1920x1080)\n"
+              << "  --capture-fps N     Video frame rate; each frame advances the clock 1/N s\n"
+              << "                      (default 60)\n"
+              << "  --capture-frames N  Frames to capture (default 600)\n"
+              << "  --record FILE       Record every ray's trajectory to FILE while simulating\n"
+              << "  --replay FILE       Play back a recording without integrating (Space pauses,\n"
+              << "                      arrows step, Home/End seek; headless: print its summary)\n"
+              << "  --replay-step N     Step to start playback at (default 0)\n"
+              << "  --checkpoint FILE   Save the full simulation state to FILE in the background\n"
+              << "                      every --checkpoint-every steps, and on exit\n"
+              << "  --checkpoint-every N\n"
+              << "                      Steps between checkpoints (default 1000)\n"
+              << "  --resume FILE       Continue a checkpointed run exactly where it stopped\n"
+              << "                      (integrator, step and trail options come from FILE)\n"
+              << "  --seed N            Seed for the background stars (default random)\n"
+              << "  --shard I/N         Headless: run only every N-th ray from ray I and write\n"
+              << "                      OUTPUT.shard-I-of-N (+ .stats) for --merge\n"
+              << "  --shards N          Headless: run N shards as local processes, then merge\n"
+              << "  --merge N           Merge the N shards of --output into one result and exit\n"
+              << "  --profile PREFIX    Write PREFIX.trace.json (Chrome trace) and PREFIX.profile.csv\n"
+              << "                      frame-time histograms (BLACKHOLE_PROFILING builds)\n"
+              << "  --help              Show this message\n";
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+
+    // Fetch the value following a flag, or bail out
+    auto value = [&](int& i) -> const char* {
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << argv[i] << "\n";
+            printUsage(argv[0]);
+            std::exit(-1);
+        }
+        return argv[++i];
+    };
+
+    for (int i{1}; i < argc; ++i) {
+        const char* arg{argv[i]};
+        if (std::strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(arg, "--frames") == 0) {
+            options.frames = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--rays") == 0) {
+            options.scenario = value(i);
+        } else if (std::strcmp(arg, "--scenario") == 0) {
+            options.scenarioFile = value(i);
+        } else if (std::strcmp(arg, "--output") == 0) {
+            options.output = value(i);
+        } else if (std::strcmp(arg, "--trails") == 0) {
+            options.writeTrails = true;
+        } else if (std::strcmp(arg, "--integrator") == 0) {
+            options.integrator = value(i);
+        } else if (std::strcmp(arg, "--precision") == 0) {
+            options.precision = value(i);
+        } else if (std::strcmp(arg, "--precision-report") == 0) {
+            options.precisionReport = true;
+        } else if (std::strcmp(arg, "--accuracy-report") == 0) {
+            options.accuracyReport = true;
+        } else if (std::strcmp(arg, "--accuracy-target") == 0) {
+            options.accuracyTarget = std::atof(value(i));
+        } else if (std::strcmp(arg, "--metric") == 0) {
+            options.metric = value(i);
+        } else if (std::strcmp(arg, "--charge") == 0) {
+            options.charge = std::atof(value(i));
+        } else if (std::strcmp(arg, "--spin") == 0) {
+            options.spin = std::atof(value(i));
+        } else if (std::strcmp(arg, "--tolerance") == 0) {
+            options.tolerance = std::atof(value(i));
+        } else if (std::strcmp(arg, "--step") == 0) {
+            options.stepSize = std::atof(value(i));
+        } else if (std::strcmp(arg, "--steps-per-second") == 0) {
+            options.stepsPerSecond = std::atof(value(i));
+        } else if (std::strcmp(arg, "--speed") == 0) {
+            options.speed = std::atof(value(i));
+        } else if (std::strcmp(arg, "--max-throughput") == 0) {
+            options.maxThroughput = true;
+        } else if (std::strcmp(arg, "--frame-budget") == 0) {
+            options.frameBudget = std::atof(value(i)) / 1000.0;
+        } else if (std::strcmp(arg, "--simd") == 0) {
+            options.simd = value(i);
+        } else if (std::strcmp(arg, "--threads") == 0) {
+            options.threads = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--trail-policy") == 0) {
+            options.trailPolicy = value(i);
+        } else if (std::strcmp(arg, "--trail-capacity") == 0) {
+            options.trailCapacity = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--trail-tolerance") == 0) {
+            options.trailTolerance = static_cast<float>(std::atof(value(i)));
+        } else if (std::strcmp(arg, "--immediate-trails") == 0) {
+            options.immediateTrails = true;
+        } else if (std::strcmp(arg, "--immediate-stars") == 0) {
+            options.immediateStars = true;
+        } else if (std::strcmp(arg, "--pipeline") == 0) {
+            options.pipeline = true;
+        } else if (std::strcmp(arg, "--stars") == 0) {
+            options.stars = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--zoom") == 0) {
+            options.zoom = std::atof(value(i));
+        } else if (std::strcmp(arg, "--center") == 0) {
+            if (std::sscanf(value(i), "%lf,%lf", &options.centerX, &options.centerY) != 2) {
+                std::cerr << "--center expects X,Y\n";
+                std::exit(-1);
+            }
+        } else if (std::strcmp(arg, "--burst") == 0) {
+            options.burst = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--ray-pool") == 0) {
+            options.rayPool = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--lookup-rays") == 0) {
+            options.lookupRays = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--deflection-cache") == 0) {
+            options.deflectionCache = value(i);
+        } else if (std::strcmp(arg, "--lens") == 0) {
+            options.lensOutput = value(i);
+        } else if (std::strcmp(arg, "--lens-size") == 0) {
+            if (std::sscanf(value(i), "%dx%d", &options.lensWidth, &options.lensHeight) != 2) {
+                std::cerr << "--lens-size expects WIDTHxHEIGHT\n";
+                std::exit(-1);
+            }
+        } else if (std::strcmp(arg, "--lens-background") == 0) {
+            options.lensBackground = value(i);
+        } else if (std::strcmp(arg, "--capture") == 0) {
+            options.capture = value(i);
+        } else if (std::strcmp(arg, "--capture-size") == 0) {
+            if (std::sscanf(value(i), "%dx%d", &options.captureWidth, &options.captureHeight) != 2) {
+                std::cerr << "--capture-size expects WIDTHxHEIGHT\n";
+                std::exit(-1);
+            }
+        } else if (std::strcmp(arg, "--capture-fps") == 0) {
+            options.captureFps = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--capture-frames") == 0) {
+            options.captureFrames = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--record") == 0) {
+            options.record = value(i);
+        } else if (std::strcmp(arg, "--replay") == 0) {
+            options.replay = value(i);
+        } else if (std::strcmp(arg, "--replay-step") == 0) {
+            const char* text{value(i)};
+            char* end{nullptr};
+            const long step{std::strtol(text, &end, 10)};
+            if (end == text || *end != '\0' || step < 0 || step > std::numeric_limits<int>::max()) {
+                std::cerr << "--replay-step must be a non-negative integer\n";
+                std::exit(-1);
+            }
+            options.replayStep = static_cast<int>(step);
+        } else if (std::strcmp(arg, "--checkpoint") == 0) {
+            options.checkpoint = value(i);
+        } else if (std::strcmp(arg, "--checkpoint-every") == 0) {
+            options.checkpointEvery = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--resume") == 0) {
+            options.resume = value(i);
+        } else if (std::strcmp(arg, "--seed") == 0) {
+            options.seed = static_cast<unsigned>(std::strtoul(value(i), nullptr, 10));
+        } else if (std::strcmp(arg, "--shard") == 0) {
+            if (std::sscanf(value(i), "%d/%d", &options.shardIndex, &options.shardCount) != 2) {
+                std::cerr << "--shard expects INDEX/COUNT\n";
+                std::exit(-1);
+            }
+        } else if (std::strcmp(arg, "--shards") == 0) {
+            options.localShards = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--merge") == 0) {
+            options.mergeShards = std::atoi(value(i));
+        } else if (std::strcmp(arg, "--profile") == 0) {
+            options.profile = value(i);
+        } else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            printUsage(argv[0]);
+            std::exit(0);
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            printUsage(argv[0]);
+            std::exit(-1);
+        }
+    }
+
+    if (options.frames <= 0) {
+        std::cerr << "--frames must be positive\n";
+        std::exit(-1);
+    }
+    if (options.scenario != "all" && options.scenario != "orbiting" &&
+        options.scenario != "point" && options.scenario != "parallel") {
+        std::cerr << "Unknown ray scenario: " << options.scenario << "\n";
+        printUsage(argv[0]);
+        std::exit(-1);
+    }
+
+    if (options.threads < 0) {
+        std::cerr << "--threads must be 0 or positive\n";
+        std::exit(-1);
+    }
+    if (options.trailPolicy != "ring" && options.trailPolicy != "decimate") {
+        std::cerr << "Unknown trail policy: " << options.trailPolicy << "\n";
+        printUsage(argv[0]);
+        std::exit(-1);
+    }
+    if (options.trailCapacity < 2) {
+        std::cerr << "--trail-capacity must be at least 2\n";
+        std::exit(-1);
+    }
+    if (!(options.trailTolerance >= 0.0f)) {
+        std::cerr << "--trail-tolerance must not be negative\n";
+        std::exit(-1);
+    }
+    if (!(options.tolerance > 0.0)) {
+        std::cerr << "--tolerance must be positive\n";
+        std::exit(-1);
+    }
+    if (!(options.stepSize > 0.0) || !std::isfinite(options.stepSize)) {
+        std::cerr << "--step must be positive\n";
+        std::exit(-1);
+    }
+    // The built-in start times must land on steps an int can count
+    const double latestStart{std::max({Visual::ORBITING_START, Visual::POINT_SOURCE_START, Visual::PARALLEL_START})};
+    if (latestStart / options.stepSize > static_cast<double>(std::numeric_limits<int>::max())) {
+        std::cerr << "--step must be at least " << latestStart / std::numeric_limits<int>::max() << "\n";
+        std::exit(-1);
+    }
+    if (!(options.stepsPerSecond > 0.0) || !(options.speed > 0.0)) {
+        std::cerr << "--steps-per-second and --speed must be positive\n";
+        std::exit(-1);
+    }
+    if (!(options.frameBudget > 0.0)) {
+        std::cerr << "--frame-budget must be positive\n";
+        std::exit(-1);
+    }
+    if (options.stars < 0) {
+        std::cerr << "--stars must be 0 or positive\n";
+        std::exit(-1);
+    }
+    if (options.lookupRays < 0) {
+        std::cerr << "--lookup-rays must be 0 or positive\n";
+        std::exit(-1);
+    }
+    if (!(options.zoom >= Visual::MIN_ZOOM && options.zoom <= Visual::MAX_ZOOM)) {
+        std::cerr << "--zoom must be between " << Visual::MIN_ZOOM << " and " << Visual::MAX_ZOOM << "\n";
+        std::exit(-1);
+    }
+    if (!(std::abs(options.centerX) <= Simulation::MAX_DISTANCE &&
+          std::abs(options.centerY) <= Simulation::MAX_DISTANCE)) {
+        std::cerr << "--center must be within " << Simulation::MAX_DISTANCE << " m of the hole on each axis\n";
+        std::exit(-1);
+    }
+    if (options.burst < 0 || options.rayPool < 0) {
+        std::cerr << "--burst and --ray-pool must be 0 or positive\n";
+        std::exit(-1);
+    }
+    if (options.lensWidth <= 0 || options.lensHeight <= 0) {
+        std::cerr << "--lens-size must be positive\n";
+        std::exit(-1);
+    }
+    if (!options.capture.empty()) {
+        if (!validCaptureTarget(options.capture)) {
+            std::cerr << "--capture expects FILE.y4m, a pattern with one %d (PPM frames) or -\n";
+            std::exit(-1);
+        }
+        if (options.captureWidth <= 0 || options.captureHeight <= 0 ||
+            options.captureFps <= 0 || options.captureFrames <= 0) {
+            std::cerr << "--capture-size, --capture-fps and --capture-frames must be positive\n";
+            std::exit(-1);
+        }
+        if (options.capture.find('%') == std::string::npos &&
+            (options.captureWidth % 2 != 0 || options.captureHeight % 2 != 0)) {
+            std::cerr << "Y4M capture needs an even --capture-size\n";
+            std::exit(-1);
+        }
+        if (options.headless || options.maxThroughput || !options.lensOutput.empty()) {
+            std::cerr << "--capture renders with GL at a fixed rate; it cannot be combined with\n"
+                      << "--headless, --max-throughput or --lens\n";
+            std::exit(-1);
+        }
+    }
+    if (options.checkpointEvery <= 0) {
+        std::cerr << "--checkpoint-every must be positive\n";
+        std::exit(-1);
+    }
+    if (!options.resume.empty() && !options.record.empty()) {
+        std::cerr << "--record starts at step 0 and cannot follow --resume\n";
+        std::exit(-1);
+    }
+    if (options.shardCount < 1 || options.shardIndex < 0 || options.shardIndex >= options.shardCount) {
+        std::cerr << "--shard needs 0 <= INDEX < COUNT\n";
+        std::exit(-1);
+    }
+    if (options.localShards < 0 || options.mergeShards < 0) {
+        std::cerr << "--shards and --merge must be positive\n";
+        std::exit(-1);
+    }
+    if (options.shardCount > 1 || options.localShards > 0) {
+        if (!options.headless) {
+            std::cerr << "Sharded runs need --headless\n";
+            std::exit(-1);
+        }
+        if (options.shardCount > 1 && options.localShards > 0) {
+            std::cerr << "--shard and --shards cannot be combined\n";
+            std::exit(-1);
+        }
+        if (!options.record.empty() || !options.checkpoint.empty() || !options.resume.empty() ||
+            options.lookupRays > 0 || !options.lensOutput.empty() || !options.replay.empty()) {
+            std::cerr << "Sharded runs cannot record, checkpoint, resume, replay or use lookup modes\n";
+            std::exit(-1);
+        }
+    }
+    if (options.integrator != "ray" && options.integrator != "batch" && options.integrator != "adaptive" &&
+        options.integrator != "cartesian" && options.integrator != "geometrized") {
+        std::cerr << "Unknown integrator: " << options.integrator << "\n";
+        printUsage(argv[0]);
+        std::exit(-1);
+    }
+    if (options.precision != "double" && options.precision != "float") {
+        std::cerr << "Unknown precision: " << options.precision << "\n";
+        printUsage(argv[0]);
+        std::exit(-1);
+    }
+    if (options.metric != "schwarzschild" && options.metric != "reissner-nordstrom" &&
+        options.metric != "kerr" && options.metric != "flat") {
+        std::cerr << "Unknown metric: " << options.metric << "\n";
+        printUsage(argv[0]);
+        std::exit(-1);
+    }
+    if (!(options.charge >= 0.0 && options.charge < 1.0)) {
+        std::cerr << "--charge must be in [0, 1)\n";
+        std::exit(-1);
+    }
+    if (!(options.spin > -1.0 && options.spin < 1.0)) {
+        std::cerr << "--spin must be in (-1, 1)\n";
+        std::exit(-1);
+    }
+    if (options.metric != "schwarzschild") {
+        // The SIMD, adaptive, Cartesian and geometrized paths and the
+        // deflection table are written for Schwarzschild only
+        if (options.integrator != "ray") {
+            std::cerr << "--metric " << options.metric << " needs --integrator ray\n";
+            std::exit(-1);
+        }
+        if (options.lookupRays > 0 || !options.lensOutput.empty() || options.precisionReport ||
+            options.accuracyReport) {
+            std::cerr << "Lookup, lensing and the precision and accuracy reports are Schwarzschild only\n";
+            std::exit(-1);
+        }
+    }
+    if (options.precisionReport) {
+        if (!options.headless) {
+            std::cerr << "--precision-report needs --headless\n";
+            std::exit(-1);
+        }
+        if (!options.record.empty() || !options.checkpoint.empty() || !options.resume.empty() ||
+            options.shardCount > 1 || options.localShards > 0 || options.mergeShards > 0 ||
+            options.lookupRays > 0 || !options.lensOutput.empty() || !options.replay.empty()) {
+            std::cerr << "--precision-report runs on its own\n";
+            std::exit(-1);
+        }
+    }
+    if (options.accuracyReport) {
+        if (!options.headless) {
+            std::cerr << "--accuracy-report needs --headless\n";
+            std::exit(-1);
+        }
+        if (!options.record.empty() || !options.checkpoint.empty() || !options.resume.empty() ||
+            options.shardCount > 1 || options.localShards > 0 || options.mergeShards > 0 ||
+            options.lookupRays > 0 || !options.lensOutput.empty() || !options.replay.empty() ||
+            options.precisionReport) {
+            std::cerr << "--accuracy-report runs on its own\n";
+            std::exit(-1);
+        }
+    }
+    if (!(options.accuracyTarget > 0.0)) {
+        std::cerr << "--accuracy-target must be positive\n";
+        std::exit(-1);
+    }
+
+    return options;
+}
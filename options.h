@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+
+// Command line options shared by the windowed and headless drivers
+struct Options {
+    bool headless;          // Run without a window
+    int frames;             // Simulation steps to run in headless mode
+    std::string scenario;   // Ray set: all, orbiting, point, parallel
+    std::string scenarioFile; // Scenario file replacing the built-in ray set
+    std::string output;     // Headless results file
+    bool writeTrails;       // Also dump full trails in headless mode
+    std::string integrator; // ray (per-Ray RK4), batch (SoA SIMD RK4), adaptive, cartesian or geometrized
+    std::string precision;  // Geometrized integrator scalar type: double or float
+    bool precisionReport;   // Compare float and double geometrized runs and exit
+    bool accuracyReport;    // Sweep integrators and steps against a reference and exit
+    double accuracyTarget;  // Deflection error (radians) the accuracy report allows
+    std::string metric;     // schwarzschild, reissner-nordstrom, kerr or flat
+    double charge;          // Reissner-Nordstrom Q/M
+    double spin;            // Kerr a/M
+    double tolerance;       // Relative tolerance for the adaptive integrator
+    double stepSize;        // Affine parameter per simulation step
+    double stepsPerSecond;  // Windowed simulation rate at 1x
+    double speed;           // Windowed time-warp factor
+    bool maxThroughput;     // Windowed: step for frameBudget each frame instead of at a fixed rate
+    double frameBudget;     // Seconds of stepping per frame with maxThroughput
+    std::string simd;       // Batch kernel: auto, scalar, avx2, avx512
+    int threads;            // Integration threads (0 = all cores)
+    std::string trailPolicy; // ring or decimate
+    int trailCapacity;      // Trail points kept per ray
+    float trailTolerance;   // Decimation tolerance (world units)
+    std::string profile;    // Profile report prefix (needs a BLACKHOLE_PROFILING build)
+    std::string record;     // Record every step to this file
+    std::string replay;     // Play back a recording instead of simulating
+    int replayStep;         // Step to start playback at
+    std::string checkpoint; // Checkpoint the simulation to this file
+    int checkpointEvery;    // Steps between checkpoints
+    std::string resume;     // Continue from a checkpoint instead of a scenario
+    unsigned seed;          // Seed for random choices (0 = pick one)
+    int shardIndex;         // This process runs every shardCount-th ray from shardIndex
+    int shardCount;
+    int localShards;        // Run this many shards as child processes, then merge (0 = off)
+    int mergeShards;        // Merge this many shards of --output and exit (0 = off)
+    bool immediateTrails;   // Draw trails with immediate-mode GL instead of GPU buffers
+    bool immediateStars;    // Draw stars with immediate-mode GL instead of a GPU buffer
+    bool pipeline;          // Simulate on a separate thread, one frame ahead of rendering
+    int stars;              // Background stars in the window
+    double zoom;            // Starting camera zoom (1 = whole default view)
+    double centerX;         // Starting camera center (meters)
+    double centerY;
+    int burst;              // Rays per right-click burst in the window
+    int rayPool;            // Extra ray slots kept for bursts
+    int lookupRays;         // Parallel beam rays classified by deflection table (0 = off)
+    std::string deflectionCache; // Deflection table cache file
+    std::string lensOutput; // Render one lensed background frame to this PPM and exit
+    int lensWidth;          // Lensed frame resolution
+    int lensHeight;
+    std::string lensBackground; // PPM mapped onto the background plane (default: stars)
+    std::string capture;    // Render offscreen to FILE.y4m, a PPM pattern with %d, or - (stdout)
+    int captureWidth;       // Capture resolution
+    int captureHeight;
+    int captureFps;         // Video frame rate; each frame advances the clock by 1/fps
+    int captureFrames;      // Frames to capture
+
+    Options();
+};
+
+// Parse argv into Options (prints usage and exits on bad input)
+Options parseOptions(int argc, char** argv);
+
+// Print command line usage
+void printUsage(const char* program);
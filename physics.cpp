@@ -1,27 +1,178 @@
 #include "physics.h"
 #include "constants.h"
+#include "metric.h"
+#include "rk4_kernel.h"
 #include <cmath>
 
+namespace {
+
+// Portable one-lane type for the batch kernels (fallback and tail handling)
+template <typename T>
+struct ScalarLane {
+    static constexpr std::size_t WIDTH{1};
+    using Real = T;
+    using Mask = bool;
+    T v;
+
+    static ScalarLane load(const T* p) { return {*p}; }
+    static void store(T* p, ScalarLane a) { *p = a.v; }
+    static ScalarLane set(double x) { return {static_cast<T>(x)}; }
+    static ScalarLane loadFrames(const int* p) { return {static_cast<T>(*p)}; }
+
+    // Same predicate as Ray::isActive && !isCaptured && !hasEscaped
+    static Mask live(ScalarLane r, ScalarLane startFrame, ScalarLane frame,
+                     ScalarLane captureRadius, ScalarLane maxDistance) {
+        return frame.v >= startFrame.v && !(r.v <= captureRadius.v) && !(r.v > maxDistance.v);
+    }
+    static ScalarLane select(Mask m, ScalarLane a, ScalarLane b) { return m ? a : b; }
+    static void storeMask(unsigned char* out, Mask m) { *out = m ? 1 : 0; }
+};
+
+template <typename T>
+inline ScalarLane<T> operator+(ScalarLane<T> a, ScalarLane<T> b) { return {a.v + b.v}; }
+template <typename T>
+inline ScalarLane<T> operator-(ScalarLane<T> a, ScalarLane<T> b) { return {a.v - b.v}; }
+template <typename T>
+inline ScalarLane<T> operator*(ScalarLane<T> a, ScalarLane<T> b) { return {a.v * b.v}; }
+template <typename T>
+inline ScalarLane<T> operator/(ScalarLane<T> a, ScalarLane<T> b) { return {a.v / b.v}; }
+template <typename T>
+inline ScalarLane<T> operator-(ScalarLane<T> a) { return {-a.v}; }
+
+using Scalar = ScalarLane<double>;
+using ScalarF = ScalarLane<float>;
+
+} // namespace
+
 namespace Physics {
 
+#ifdef BLACKHOLE_HAVE_AVX2
+std::size_t rk4BatchAVX2(const BatchKernelArgs& args);
+std::size_t rk4GeoBatchAVX2(const GeoKernelArgs<double>& args);
+std::size_t rk4GeoBatchAVX2(const GeoKernelArgs<float>& args);
+#endif
+#ifdef BLACKHOLE_HAVE_AVX512
+std::size_t rk4BatchAVX512(const BatchKernelArgs& args);
+std::size_t rk4GeoBatchAVX512(const GeoKernelArgs<double>& args);
+std::size_t rk4GeoBatchAVX512(const GeoKernelArgs<float>& args);
+#endif
+
+namespace {
+
+std::size_t rk4BatchScalar(const BatchKernelArgs& args) {
+    return Kernel::rk4Batch<Scalar>(args);
+}
+
+std::size_t rk4GeoBatchScalar(const GeoKernelArgs<double>& args) {
+    return Kernel::rk4GeoBatch<Scalar>(args);
+}
+
+std::size_t rk4GeoBatchScalar(const GeoKernelArgs<float>& args) {
+    return Kernel::rk4GeoBatch<ScalarF>(args);
+}
+
+// One instruction set's kernels: SI, and geometrized at both precisions
+struct KernelChoice {
+    BatchKernel kernel;
+    GeoKernel<double> geoDouble;
+    GeoKernel<float> geoFloat;
+    const char* name;
+};
+
+// Pick the widest kernel the CPU supports
+KernelChoice detectBatchKernel() {
+#if defined(BLACKHOLE_HAVE_AVX512)
+    if (__builtin_cpu_supports("avx512f")) {
+        return {rk4BatchAVX512, rk4GeoBatchAVX512, rk4GeoBatchAVX512, "avx512"};
+    }
+#endif
+#if defined(BLACKHOLE_HAVE_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return {rk4BatchAVX2, rk4GeoBatchAVX2, rk4GeoBatchAVX2, "avx2"};
+    }
+#endif
+    return {rk4BatchScalar, rk4GeoBatchScalar, rk4GeoBatchScalar, "scalar"};
+}
+
+KernelChoice& activeKernel() {
+    static KernelChoice choice{detectBatchKernel()};
+    return choice;
+}
+
+} // namespace
+
 // Compute geodesic right-hand side using exact Schwarzschild equations
 void geodesicRHS(const Ray& ray, double rhs[4]) {
-    double r{ray.r};
-    double v_r{ray.v_r};
-    double v_phi{ray.v_phi};
-    double E_val{ray.E};
+    const double y[4]{ray.r, ray.phi, ray.v_r, ray.v_phi};
+    geodesicRHS(y, ray.E, rhs);
+}
+
+void geodesicRHS(const double y[4], double E, double rhs[4]) {
+    Schwarzschild::rhs(y, E, 0.0, rhs);
+}
+
+CartesianState toCartesian(const Ray& ray) {
+    const double c{std::cos(ray.phi)};
+    const double s{std::sin(ray.phi)};
+    return CartesianState{
+        ray.r * c, ray.r * s,
+        ray.v_r * c - ray.r * ray.v_phi * s,
+        ray.v_r * s + ray.r * ray.v_phi * c,
+        std::cos(ray.initialVelocityAngle), std::sin(ray.initialVelocityAngle)
+    };
+}
+
+void geodesicRHSCartesian(const double y[4], double E, double rhs[4]) {
+    const double x{y[0]};
+    const double yy{y[1]};
+    const double vx{y[2]};
+    const double vy{y[3]};
+
+    const double r2{x * x + yy * yy};
+    const double r{std::sqrt(r2)};
+    const double pv{x * vx + yy * vy};   // r dr/dλ
+    const double L{x * vy - yy * vx};    // r² dφ/dλ
+
+    // Both terms over one denominator, so a single division per call
+    const double numerator{(E * E * r2 - pv * pv) * r + 2.0 * L * L * (r - BlackHole::rs)};
+    const double k{-BlackHole::rs * numerator / (2.0 * r2 * r2 * r * (r - BlackHole::rs))};
+
+    rhs[0] = vx;
+    rhs[1] = vy;
+    rhs[2] = k * x;
+    rhs[3] = k * yy;
+}
+
+double rk4StepCartesian(CartesianState& state, double E, double dlambda) {
+    const double y0[4]{state.x, state.y, state.vx, state.vy};
+    double k1[4], k2[4], k3[4], k4[4], temp[4];
 
-    double f{1.0 - BlackHole::rs / r};
+    geodesicRHSCartesian(y0, E, k1);
+    addState(y0, k1, dlambda / 2.0, temp);
+    geodesicRHSCartesian(temp, E, k2);
+    addState(y0, k2, dlambda / 2.0, temp);
+    geodesicRHSCartesian(temp, E, k3);
+    addState(y0, k3, dlambda, temp);
+    geodesicRHSCartesian(temp, E, k4);
 
-    rhs[0] = v_r;
-    rhs[1] = v_phi;
+    state.x += (dlambda / 6.0) * (k1[0] + 2.0 * k2[0] + 2.0 * k3[0] + k4[0]);
+    state.y += (dlambda / 6.0) * (k1[1] + 2.0 * k2[1] + 2.0 * k3[1] + k4[1]);
+    state.vx += (dlambda / 6.0) * (k1[2] + 2.0 * k2[2] + 2.0 * k3[2] + k4[2]);
+    state.vy += (dlambda / 6.0) * (k1[3] + 2.0 * k2[3] + 2.0 * k3[3] + k4[3]);
+    return std::sqrt(state.x * state.x + state.y * state.y);
+}
 
-    double dt_dlambda{E_val / f};
-    rhs[2] = -(BlackHole::rs / (2.0 * r * r)) * f * (dt_dlambda * dt_dlambda)
-             + (BlackHole::rs / (2.0 * r * r * f)) * (v_r * v_r)
-             + (r - BlackHole::rs) * (v_phi * v_phi);
+void storePolar(const CartesianState& state, Ray& ray) {
+    const double r2{state.x * state.x + state.y * state.y};
+    ray.r = std::sqrt(r2);
+    ray.phi = std::atan2(state.y, state.x);
+    ray.v_r = (state.x * state.vx + state.y * state.vy) / ray.r;
+    ray.v_phi = (state.x * state.vy - state.y * state.vx) / r2;
 
-    rhs[3] = -2.0 * v_r * v_phi / r;
+    // Angle between the initial and current directions, in [0, π]
+    const double cross{state.dirX * state.vy - state.dirY * state.vx};
+    const double dot{state.dirX * state.vx + state.dirY * state.vy};
+    ray.deflection = std::atan2(std::abs(cross), dot);
 }
 
 // Helper function: add two state vectors
@@ -33,44 +184,122 @@ void addState(const double a[4], const double b[4], double factor, double out[4]
 
 // RK4 integration step
 void rk4Step(Ray& ray, double dlambda) {
-    double y0[4]{ray.r, ray.phi, ray.v_r, ray.v_phi};
-    double k1[4], k2[4], k3[4], k4[4], temp[4];
+    rk4Step(ray, dlambda, Schwarzschild{});
+}
 
-    // k1 = f(y0)
-    geodesicRHS(ray, k1);
+int rk4StepBatch(RayBatch& batch, double dlambda, double maxDistance,
+                 int currentFrame, std::vector<unsigned char>& stepped) {
+    stepped.resize(batch.size());
+    return rk4StepBatch(batch, dlambda, maxDistance, currentFrame, stepped.data(), 0, batch.size());
+}
 
-    // k2 = f(y0 + k1*dlambda/2)
-    addState(y0, k1, dlambda / 2.0, temp);
-    Ray r2{ray};
-    r2.r = temp[0];
-    r2.phi = temp[1];
-    r2.v_r = temp[2];
-    r2.v_phi = temp[3];
-    geodesicRHS(r2, k2);
-
-    // k3 = f(y0 + k2*dlambda/2)
-    addState(y0, k2, dlambda / 2.0, temp);
-    Ray r3{ray};
-    r3.r = temp[0];
-    r3.phi = temp[1];
-    r3.v_r = temp[2];
-    r3.v_phi = temp[3];
-    geodesicRHS(r3, k3);
-
-    // k4 = f(y0 + k3*dlambda)
-    addState(y0, k3, dlambda, temp);
-    Ray r4{ray};
-    r4.r = temp[0];
-    r4.phi = temp[1];
-    r4.v_r = temp[2];
-    r4.v_phi = temp[3];
-    geodesicRHS(r4, k4);
-
-    // Update: y_{n+1} = y_n + (k1 + 2k2 + 2k3 + k4) * dlambda/6
-    ray.r += (dlambda / 6.0) * (k1[0] + 2.0 * k2[0] + 2.0 * k3[0] + k4[0]);
-    ray.phi += (dlambda / 6.0) * (k1[1] + 2.0 * k2[1] + 2.0 * k3[1] + k4[1]);
-    ray.v_r += (dlambda / 6.0) * (k1[2] + 2.0 * k2[2] + 2.0 * k3[2] + k4[2]);
-    ray.v_phi += (dlambda / 6.0) * (k1[3] + 2.0 * k2[3] + 2.0 * k3[3] + k4[3]);
+int rk4StepBatch(RayBatch& batch, double dlambda, double maxDistance, int currentFrame,
+                 unsigned char* stepped, std::size_t begin, std::size_t end) {
+    BatchKernelArgs args{
+        batch.r.data() + begin, batch.phi.data() + begin,
+        batch.v_r.data() + begin, batch.v_phi.data() + begin,
+        batch.E.data() + begin, batch.startFrame.data() + begin, stepped + begin,
+        end - begin, dlambda, maxDistance, currentFrame
+    };
+    const std::size_t done{activeKernel().kernel(args)};
+
+    // Finish the remainder that doesn't fill a whole vector
+    args.r += done;
+    args.phi += done;
+    args.v_r += done;
+    args.v_phi += done;
+    args.E += done;
+    args.startFrame += done;
+    args.stepped += done;
+    args.count -= done;
+    rk4BatchScalar(args);
+
+    int count{0};
+    for (std::size_t i{begin}; i < end; ++i) {
+        count += stepped[i];
+    }
+    return count;
+}
+
+namespace {
+
+GeoKernel<double> geoKernel(const KernelChoice& choice, double) {
+    return choice.geoDouble;
+}
+
+GeoKernel<float> geoKernel(const KernelChoice& choice, float) {
+    return choice.geoFloat;
+}
+
+template <typename Real>
+int stepGeoBatch(GeoBatch<Real>& batch, double dsigma, double maxDistance, int currentFrame,
+                 unsigned char* stepped, std::size_t begin, std::size_t end) {
+    static const Real captureRadius{GeoBatch<Real>::captureRadius()};
+    GeoKernelArgs<Real> args{
+        batch.r.data() + begin, batch.phi.data() + begin,
+        batch.v_r.data() + begin, batch.v_phi.data() + begin,
+        batch.E.data() + begin, batch.startFrame.data() + begin, stepped + begin,
+        end - begin, dsigma, captureRadius,
+        GeoBatch<Real>::escapeDistance(maxDistance), currentFrame
+    };
+    const std::size_t done{geoKernel(activeKernel(), Real{})(args)};
+
+    // Finish the remainder that doesn't fill a whole vector
+    args.r += done;
+    args.phi += done;
+    args.v_r += done;
+    args.v_phi += done;
+    args.E += done;
+    args.startFrame += done;
+    args.stepped += done;
+    args.count -= done;
+    rk4GeoBatchScalar(args);
+
+    int count{0};
+    for (std::size_t i{begin}; i < end; ++i) {
+        count += stepped[i];
+    }
+    return count;
+}
+
+} // namespace
+
+int rk4StepBatch(GeoBatch<double>& batch, double dsigma, double maxDistance, int currentFrame,
+                 unsigned char* stepped, std::size_t begin, std::size_t end) {
+    return stepGeoBatch(batch, dsigma, maxDistance, currentFrame, stepped, begin, end);
+}
+
+int rk4StepBatch(GeoBatch<float>& batch, double dsigma, double maxDistance, int currentFrame,
+                 unsigned char* stepped, std::size_t begin, std::size_t end) {
+    return stepGeoBatch(batch, dsigma, maxDistance, currentFrame, stepped, begin, end);
+}
+
+bool setBatchKernel(const std::string& name) {
+    if (name == "auto") {
+        activeKernel() = detectBatchKernel();
+        return true;
+    }
+    if (name == "scalar") {
+        activeKernel() = {rk4BatchScalar, rk4GeoBatchScalar, rk4GeoBatchScalar, "scalar"};
+        return true;
+    }
+#if defined(BLACKHOLE_HAVE_AVX2)
+    if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+        activeKernel() = {rk4BatchAVX2, rk4GeoBatchAVX2, rk4GeoBatchAVX2, "avx2"};
+        return true;
+    }
+#endif
+#if defined(BLACKHOLE_HAVE_AVX512)
+    if (name == "avx512" && __builtin_cpu_supports("avx512f")) {
+        activeKernel() = {rk4BatchAVX512, rk4GeoBatchAVX512, rk4GeoBatchAVX512, "avx512"};
+        return true;
+    }
+#endif
+    return false;
+}
+
+const char* batchKernelName() {
+    return activeKernel().name;
 }
 
 } // namespace Physics
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <string>
+#include <vector>
 #include "ray.h"
+#include "ray_batch.h"
 
 // Physics simulation namespace
 namespace Physics {
@@ -8,6 +11,39 @@ namespace Physics {
     // Fills rhs array with [dr/dλ, dφ/dλ, d²r/dλ², d²φ/dλ²]
     void geodesicRHS(const Ray& ray, double rhs[4]);
 
+    // Same as above for a bare state y = [r, φ, dr/dλ, dφ/dλ] with energy E
+    void geodesicRHS(const double y[4], double E, double rhs[4]);
+
+    // Ray state for the trig-free Cartesian integrator: position in the
+    // orbital plane, its derivative with respect to λ, and the unit initial
+    // direction of motion that deflection is measured from
+    struct CartesianState {
+        double x;
+        double y;
+        double vx;
+        double vy;
+        double dirX;
+        double dirY;
+    };
+
+    // Cartesian state of a ray from its polar state
+    CartesianState toCartesian(const Ray& ray);
+
+    // Schwarzschild geodesic in Cartesian form for y = [x, y, dx/dλ, dy/dλ].
+    // The polar equations leave no tangential acceleration, so with p the
+    // position, v = dp/dλ and L = p × v:
+    //   d²p/dλ² = -rs p [(E² - (p·v)²/r²) / (2 r² (r - rs)) + L² / r⁵]
+    // One square root and one division, and no trig
+    void geodesicRHSCartesian(const double y[4], double E, double rhs[4]);
+
+    // One RK4 step of the Cartesian form; returns the new r
+    double rk4StepCartesian(CartesianState& state, double E, double dlambda);
+
+    // Bring a ray's polar state and deflection up to date from its Cartesian
+    // state. Deflection comes from the dot and cross products of the initial
+    // and current directions; the only trig is the two final atan2 calls.
+    void storePolar(const CartesianState& state, Ray& ray);
+
     // Helper function for RK4 integration
     // out = a + b * factor
     void addState(const double a[4], const double b[4], double factor, double out[4]);
@@ -15,4 +51,31 @@ namespace Physics {
     // Perform one RK4 integration step
     // Updates ray state using 4th order Runge-Kutta method
     void rk4Step(Ray& ray, double dlambda);
+
+    // Advance every live ray in a structure-of-arrays batch by one RK4 step
+    // using the selected batch kernel. stepped[i] is set to 1 for each ray
+    // that was advanced. Returns the number of rays stepped.
+    int rk4StepBatch(RayBatch& batch, double dlambda, double maxDistance,
+                     int currentFrame, std::vector<unsigned char>& stepped);
+
+    // Same as above for rays [begin, end) only; stepped must hold batch.size()
+    // entries. Disjoint ranges may be stepped concurrently.
+    int rk4StepBatch(RayBatch& batch, double dlambda, double maxDistance, int currentFrame,
+                     unsigned char* stepped, std::size_t begin, std::size_t end);
+
+    // Geometrized counterparts for a GeoBatch at either precision: dsigma
+    // is the step in units of Units::AFFINE, maxDistance stays in meters.
+    // A ray the kernel stops is captured or escaped by the SI tests once
+    // stored.
+    int rk4StepBatch(GeoBatch<double>& batch, double dsigma, double maxDistance, int currentFrame,
+                     unsigned char* stepped, std::size_t begin, std::size_t end);
+    int rk4StepBatch(GeoBatch<float>& batch, double dsigma, double maxDistance, int currentFrame,
+                     unsigned char* stepped, std::size_t begin, std::size_t end);
+
+    // Choose the batch kernel: "auto", "scalar", "avx2" or "avx512"
+    // Returns false if the kernel is unknown or unsupported on this CPU
+    bool setBatchKernel(const std::string& name);
+
+    // Name of the batch kernel currently in use
+    const char* batchKernelName();
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+// AVX2 instantiations of the batch RK4 kernels (4 doubles or 8 floats per
+// instruction).
+// Built with -mavx2 only; selected at runtime when the CPU supports it.
+#include "rk4_kernel.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2 {
+    static constexpr std::size_t WIDTH{4};
+    using Real = double;
+    using Mask = __m256d;
+    __m256d v;
+
+    static Avx2 load(const double* p) { return {_mm256_loadu_pd(p)}; }
+    static void store(double* p, Avx2 a) { _mm256_storeu_pd(p, a.v); }
+    static Avx2 set(double x) { return {_mm256_set1_pd(x)}; }
+    static Avx2 loadFrames(const int* p) {
+        return {_mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)))};
+    }
+
+    // Same predicate as Ray::isActive && !isCaptured && !hasEscaped
+    static Mask live(Avx2 r, Avx2 startFrame, Avx2 frame, Avx2 captureRadius, Avx2 maxDistance) {
+        const __m256d started{_mm256_cmp_pd(frame.v, startFrame.v, _CMP_GE_OQ)};
+        const __m256d notCaptured{_mm256_cmp_pd(r.v, captureRadius.v, _CMP_NLE_UQ)};
+        const __m256d notEscaped{_mm256_cmp_pd(r.v, maxDistance.v, _CMP_NGT_UQ)};
+        return _mm256_and_pd(started, _mm256_and_pd(notCaptured, notEscaped));
+    }
+    static Avx2 select(Mask m, Avx2 a, Avx2 b) { return {_mm256_blendv_pd(b.v, a.v, m)}; }
+    static void storeMask(unsigned char* out, Mask m) {
+        const int bits{_mm256_movemask_pd(m)};
+        for (std::size_t i{0}; i < WIDTH; ++i) {
+            out[i] = static_cast<unsigned char>((bits >> i) & 1);
+        }
+    }
+};
+
+inline Avx2 operator+(Avx2 a, Avx2 b) { return {_mm256_add_pd(a.v, b.v)}; }
+inline Avx2 operator-(Avx2 a, Avx2 b) { return {_mm256_sub_pd(a.v, b.v)}; }
+inline Avx2 operator*(Avx2 a, Avx2 b) { return {_mm256_mul_pd(a.v, b.v)}; }
+inline Avx2 operator/(Avx2 a, Avx2 b) { return {_mm256_div_pd(a.v, b.v)}; }
+inline Avx2 operator-(Avx2 a) { return {_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0))}; }
+
+struct Avx2F {
+    static constexpr std::size_t WIDTH{8};
+    using Real = float;
+    using Mask = __m256;
+    __m256 v;
+
+    static Avx2F load(const float* p) { return {_mm256_loadu_ps(p)}; }
+    static void store(float* p, Avx2F a) { _mm256_storeu_ps(p, a.v); }
+    static Avx2F set(double x) { return {_mm256_set1_ps(static_cast<float>(x))}; }
+    static Avx2F loadFrames(const int* p) {
+        return {_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))};
+    }
+
+    // Same predicate as Ray::isActive && !isCaptured && !hasEscaped
+    static Mask live(Avx2F r, Avx2F startFrame, Avx2F frame, Avx2F captureRadius, Avx2F maxDistance) {
+        const __m256 started{_mm256_cmp_ps(frame.v, startFrame.v, _CMP_GE_OQ)};
+        const __m256 notCaptured{_mm256_cmp_ps(r.v, captureRadius.v, _CMP_NLE_UQ)};
+        const __m256 notEscaped{_mm256_cmp_ps(r.v, maxDistance.v, _CMP_NGT_UQ)};
+        return _mm256_and_ps(started, _mm256_and_ps(notCaptured, notEscaped));
+    }
+    static Avx2F select(Mask m, Avx2F a, Avx2F b) { return {_mm256_blendv_ps(b.v, a.v, m)}; }
+    static void storeMask(unsigned char* out, Mask m) {
+        const int bits{_mm256_movemask_ps(m)};
+        for (std::size_t i{0}; i < WIDTH; ++i) {
+            out[i] = static_cast<unsigned char>((bits >> i) & 1);
+        }
+    }
+};
+
+inline Avx2F operator+(Avx2F a, Avx2F b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline Avx2F operator-(Avx2F a, Avx2F b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline Avx2F operator*(Avx2F a, Avx2F b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline Avx2F operator/(Avx2F a, Avx2F b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline Avx2F operator-(Avx2F a) { return {_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))}; }
+
+} // namespace
+
+namespace Physics {
+
+std::size_t rk4BatchAVX2(const BatchKernelArgs& args) {
+    return Kernel::rk4Batch<Avx2>(args);
+}
+
+std::size_t rk4GeoBatchAVX2(const GeoKernelArgs<double>& args) {
+    return Kernel::rk4GeoBatch<Avx2>(args);
+}
+
+std::size_t rk4GeoBatchAVX2(const GeoKernelArgs<float>& args) {
+    return Kernel::rk4GeoBatch<Avx2F>(args);
+}
+
+} // namespace Physics
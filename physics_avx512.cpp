@@ -0,0 +1,97 @@
+// AVX-512 instantiations of the batch RK4 kernels (8 doubles or 16 floats
+// per instruction).
+// Built with -mavx512f only; selected at runtime when the CPU supports it.
+#include "rk4_kernel.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512 {
+    static constexpr std::size_t WIDTH{8};
+    using Real = double;
+    using Mask = __mmask8;
+    __m512d v;
+
+    static Avx512 load(const double* p) { return {_mm512_loadu_pd(p)}; }
+    static void store(double* p, Avx512 a) { _mm512_storeu_pd(p, a.v); }
+    static Avx512 set(double x) { return {_mm512_set1_pd(x)}; }
+    static Avx512 loadFrames(const int* p) {
+        return {_mm512_maskz_cvtepi32_pd(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)))};
+    }
+
+    // Same predicate as Ray::isActive && !isCaptured && !hasEscaped
+    static Mask live(Avx512 r, Avx512 startFrame, Avx512 frame, Avx512 captureRadius, Avx512 maxDistance) {
+        const __mmask8 started{_mm512_cmp_pd_mask(frame.v, startFrame.v, _CMP_GE_OQ)};
+        const __mmask8 notCaptured{_mm512_cmp_pd_mask(r.v, captureRadius.v, _CMP_NLE_UQ)};
+        const __mmask8 notEscaped{_mm512_cmp_pd_mask(r.v, maxDistance.v, _CMP_NGT_UQ)};
+        return static_cast<__mmask8>(started & notCaptured & notEscaped);
+    }
+    static Avx512 select(Mask m, Avx512 a, Avx512 b) { return {_mm512_mask_blend_pd(m, b.v, a.v)}; }
+    static void storeMask(unsigned char* out, Mask m) {
+        for (std::size_t i{0}; i < WIDTH; ++i) {
+            out[i] = static_cast<unsigned char>((m >> i) & 1);
+        }
+    }
+};
+
+inline Avx512 operator+(Avx512 a, Avx512 b) { return {_mm512_add_pd(a.v, b.v)}; }
+inline Avx512 operator-(Avx512 a, Avx512 b) { return {_mm512_sub_pd(a.v, b.v)}; }
+inline Avx512 operator*(Avx512 a, Avx512 b) { return {_mm512_mul_pd(a.v, b.v)}; }
+inline Avx512 operator/(Avx512 a, Avx512 b) { return {_mm512_div_pd(a.v, b.v)}; }
+inline Avx512 operator-(Avx512 a) {
+    const __m512i sign{_mm512_set1_epi64(static_cast<long long>(0x8000000000000000ULL))};
+    return {_mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a.v), sign))};
+}
+
+struct Avx512F {
+    static constexpr std::size_t WIDTH{16};
+    using Real = float;
+    using Mask = __mmask16;
+    __m512 v;
+
+    static Avx512F load(const float* p) { return {_mm512_loadu_ps(p)}; }
+    static void store(float* p, Avx512F a) { _mm512_storeu_ps(p, a.v); }
+    static Avx512F set(double x) { return {_mm512_set1_ps(static_cast<float>(x))}; }
+    static Avx512F loadFrames(const int* p) { return {_mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_loadu_si512(p))}; }
+
+    // Same predicate as Ray::isActive && !isCaptured && !hasEscaped
+    static Mask live(Avx512F r, Avx512F startFrame, Avx512F frame, Avx512F captureRadius, Avx512F maxDistance) {
+        const __mmask16 started{_mm512_cmp_ps_mask(frame.v, startFrame.v, _CMP_GE_OQ)};
+        const __mmask16 notCaptured{_mm512_cmp_ps_mask(r.v, captureRadius.v, _CMP_NLE_UQ)};
+        const __mmask16 notEscaped{_mm512_cmp_ps_mask(r.v, maxDistance.v, _CMP_NGT_UQ)};
+        return static_cast<__mmask16>(started & notCaptured & notEscaped);
+    }
+    static Avx512F select(Mask m, Avx512F a, Avx512F b) { return {_mm512_mask_blend_ps(m, b.v, a.v)}; }
+    static void storeMask(unsigned char* out, Mask m) {
+        for (std::size_t i{0}; i < WIDTH; ++i) {
+            out[i] = static_cast<unsigned char>((m >> i) & 1);
+        }
+    }
+};
+
+inline Avx512F operator+(Avx512F a, Avx512F b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline Avx512F operator-(Avx512F a, Avx512F b) { return {_mm512_sub_ps(a.v, b.v)}; }
+inline Avx512F operator*(Avx512F a, Avx512F b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline Avx512F operator/(Avx512F a, Avx512F b) { return {_mm512_div_ps(a.v, b.v)}; }
+inline Avx512F operator-(Avx512F a) {
+    const __m512i sign{_mm512_set1_epi32(static_cast<int>(0x80000000U))};
+    return {_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a.v), sign))};
+}
+
+} // namespace
+
+namespace Physics {
+
+std::size_t rk4BatchAVX512(const BatchKernelArgs& args) {
+    return Kernel::rk4Batch<Avx512>(args);
+}
+
+std::size_t rk4GeoBatchAVX512(const GeoKernelArgs<double>& args) {
+    return Kernel::rk4GeoBatch<Avx512>(args);
+}
+
+std::size_t rk4GeoBatchAVX512(const GeoKernelArgs<float>& args) {
+    return Kernel::rk4GeoBatch<Avx512F>(args);
+}
+
+} // namespace Physics
@@ -0,0 +1,243 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace Profiling {
+
+namespace {
+
+// Trace events kept for export; histograms keep aggregating past this
+constexpr std::size_t MAX_TRACE_EVENTS{1u << 20};
+
+struct TraceEvent {
+    const char* name;
+    std::uint32_t thread;
+    std::int64_t start;
+    std::int64_t duration;
+};
+
+struct CounterEvent {
+    const char* name;
+    std::int64_t time;
+    double value;
+};
+
+// One histogram: a scope's total time per frame, or a counter's value per frame
+struct Series {
+    const char* name;
+    bool isCounter;
+    bool touched;        // Recorded during the current frame
+    double frameValue;
+    std::vector<double> perFrame;
+};
+
+struct Stats {
+    double mean;
+    double p50;
+    double p99;
+    double max;
+};
+
+struct State {
+    std::mutex mutex;
+    const std::chrono::steady_clock::time_point origin{std::chrono::steady_clock::now()};
+    std::vector<TraceEvent> events;
+    std::vector<CounterEvent> counters;
+    std::vector<Series> series;
+    std::vector<double> frameTimes;   // Milliseconds
+    std::int64_t frameStart{-1};      // First frame starts at its first scope
+    bool truncated{false};
+};
+
+State& state() {
+    static State s;
+    return s;
+}
+
+// Small stable id per thread for the trace's tid field
+std::uint32_t threadIndex() {
+    static std::atomic<std::uint32_t> next{0};
+    thread_local const std::uint32_t index{next++};
+    return index;
+}
+
+Series& findSeries(State& s, const char* name, bool isCounter) {
+    for (auto& series : s.series) {
+        if (series.name == name || std::strcmp(series.name, name) == 0) {
+            return series;
+        }
+    }
+    s.series.push_back(Series{name, isCounter, false, 0.0, {}});
+    return s.series.back();
+}
+
+// Nearest-rank percentiles over a copy of the samples
+Stats computeStats(std::vector<double> samples) {
+    if (samples.empty()) {
+        return Stats{0.0, 0.0, 0.0, 0.0};
+    }
+    std::sort(samples.begin(), samples.end());
+    auto rank = [&](double p) {
+        const std::size_t i{static_cast<std::size_t>(std::ceil(p * static_cast<double>(samples.size())))};
+        return samples[std::max<std::size_t>(i, 1) - 1];
+    };
+    double sum{0.0};
+    for (double v : samples) {
+        sum += v;
+    }
+    return Stats{sum / static_cast<double>(samples.size()), rank(0.5), rank(0.99), samples.back()};
+}
+
+// Visit the frame histogram and every series as (name, kind, samples)
+template <typename Fn>
+void forEachHistogram(const State& s, Fn fn) {
+    fn("frame", "timer_ms", s.frameTimes);
+    for (const auto& series : s.series) {
+        fn(series.name, series.isCounter ? "counter" : "timer_ms", series.perFrame);
+    }
+}
+
+} // namespace
+
+std::int64_t now() {
+    const auto elapsed{std::chrono::steady_clock::now() - state().origin};
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void scope(const char* name, std::int64_t start, std::int64_t end) {
+    State& s{state()};
+    const std::lock_guard<std::mutex> lock{s.mutex};
+    if (s.frameStart < 0) {
+        s.frameStart = start;
+    }
+    if (s.events.size() < MAX_TRACE_EVENTS) {
+        s.events.push_back(TraceEvent{name, threadIndex(), start, end - start});
+    } else {
+        s.truncated = true;
+    }
+
+    Series& series{findSeries(s, name, false)};
+    series.touched = true;
+    series.frameValue += static_cast<double>(end - start) * 1e-6;
+}
+
+void counter(const char* name, double value) {
+    const std::int64_t time{now()};
+    State& s{state()};
+    const std::lock_guard<std::mutex> lock{s.mutex};
+    if (s.counters.size() < MAX_TRACE_EVENTS) {
+        s.counters.push_back(CounterEvent{name, time, value});
+    } else {
+        s.truncated = true;
+    }
+
+    Series& series{findSeries(s, name, true)};
+    series.touched = true;
+    series.frameValue = value;
+}
+
+void endFrame() {
+    const std::int64_t time{now()};
+    State& s{state()};
+    const std::lock_guard<std::mutex> lock{s.mutex};
+    s.frameTimes.push_back(s.frameStart < 0 ? 0.0 : static_cast<double>(time - s.frameStart) * 1e-6);
+    s.frameStart = time;
+
+    // Scopes that did not run this frame stay out of their histogram
+    for (auto& series : s.series) {
+        if (series.touched) {
+            series.perFrame.push_back(series.frameValue);
+        }
+        series.touched = false;
+        series.frameValue = 0.0;
+    }
+}
+
+bool writeChromeTrace(const std::string& path) {
+    State& s{state()};
+    const std::lock_guard<std::mutex> lock{s.mutex};
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+
+    // Timestamps in microseconds
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first{true};
+    for (const auto& e : s.events) {
+        out << (first ? "" : ",\n") << "{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+            << e.thread << ", \"ts\": " << static_cast<double>(e.start) * 1e-3
+            << ", \"dur\": " << static_cast<double>(e.duration) * 1e-3 << "}";
+        first = false;
+    }
+    for (const auto& c : s.counters) {
+        out << (first ? "" : ",\n") << "{\"name\": \"" << c.name << "\", \"ph\": \"C\", \"pid\": 1, \"ts\": "
+            << static_cast<double>(c.time) * 1e-3 << ", \"args\": {\"value\": " << c.value << "}}";
+        first = false;
+    }
+    out << "\n]}\n";
+    if (s.truncated) {
+        std::cerr << "Trace truncated at " << MAX_TRACE_EVENTS << " events\n";
+    }
+    return static_cast<bool>(out);
+}
+
+bool writeSummary(const std::string& path) {
+    State& s{state()};
+    const std::lock_guard<std::mutex> lock{s.mutex};
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+
+    out.precision(9);
+    out << "name,kind,frames,mean,p50,p99,max\n";
+    forEachHistogram(s, [&](const char* name, const char* kind, const std::vector<double>& samples) {
+        const Stats stats{computeStats(samples)};
+        out << name << ',' << kind << ',' << samples.size() << ',' << stats.mean << ','
+            << stats.p50 << ',' << stats.p99 << ',' << stats.max << '\n';
+    });
+    return static_cast<bool>(out);
+}
+
+void printSummary(std::ostream& out) {
+    State& s{state()};
+    const std::lock_guard<std::mutex> lock{s.mutex};
+    out << "Profile (" << s.frameTimes.size() << " frames; timers in ms per frame)\n"
+        << std::left << std::setw(28) << "  name" << std::right << std::setw(12) << "mean"
+        << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "max" << "\n";
+    forEachHistogram(s, [&](const char* name, const char*, const std::vector<double>& samples) {
+        const Stats stats{computeStats(samples)};
+        out << "  " << std::left << std::setw(26) << name << std::right << std::setprecision(4)
+            << std::setw(12) << stats.mean << std::setw(12) << stats.p50
+            << std::setw(12) << stats.p99 << std::setw(12) << stats.max << "\n";
+    });
+}
+
+bool writeReports(const std::string& prefix) {
+    if (!ENABLED) {
+        std::cerr << "Profiling is compiled out; rebuild with -DBLACKHOLE_PROFILING=ON\n";
+        return false;
+    }
+
+    printSummary(std::cout);
+    const std::string tracePath{prefix + ".trace.json"};
+    const std::string summaryPath{prefix + ".profile.csv"};
+    if (!writeChromeTrace(tracePath) || !writeSummary(summaryPath)) {
+        return false;
+    }
+    std::cout << "Profile written to " << tracePath << " and " << summaryPath << "\n";
+    return true;
+}
+
+} // namespace Profiling
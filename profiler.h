@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Lightweight frame profiler: scoped timers and counters, aggregated per
+// frame into histograms (p50/p99) and exported as a Chrome trace
+// (chrome://tracing, Perfetto) and a CSV summary.
+//
+// Instrument code with the PROFILE_* macros only. They expand to nothing
+// unless the build defines BLACKHOLE_PROFILING (CMake option of the same
+// name), so instrumentation can stay in production builds at no cost.
+namespace Profiling {
+#ifdef BLACKHOLE_PROFILING
+    constexpr bool ENABLED{true};
+#else
+    constexpr bool ENABLED{false};
+#endif
+
+    // Nanoseconds since the profiler started
+    std::int64_t now();
+
+    // Record a finished scope (name must outlive the profiler, e.g. a literal)
+    void scope(const char* name, std::int64_t start, std::int64_t end);
+
+    // Set a counter's value for the current frame
+    void counter(const char* name, double value);
+
+    // Close the current frame: frame time and per-frame totals go to the histograms
+    void endFrame();
+
+    // Times a scope from construction to destruction
+    struct ScopedTimer {
+        const char* name;
+        std::int64_t start;
+
+        explicit ScopedTimer(const char* scopeName) : name{scopeName}, start{now()} {}
+        ~ScopedTimer() { scope(name, start, now()); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+    // Chrome trace event JSON of every recorded scope and counter
+    bool writeChromeTrace(const std::string& path);
+
+    // CSV of per-frame statistics: name, kind, frames, mean, p50, p99, max
+    bool writeSummary(const std::string& path);
+
+    // Human-readable summary of the same statistics
+    void printSummary(std::ostream& out);
+
+    // Print the summary and write PREFIX.trace.json and PREFIX.profile.csv
+    bool writeReports(const std::string& prefix);
+}
+
+#ifdef BLACKHOLE_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) const Profiling::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__){name}
+#define PROFILE_COUNTER(name, value) Profiling::counter(name, static_cast<double>(value))
+#define PROFILE_FRAME() Profiling::endFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
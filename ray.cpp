@@ -1,5 +1,6 @@
 #include "ray.h"
 #include "constants.h"
+#include "metric.h"
 #include "physics.h"
 #include <cmath>
 
@@ -7,8 +8,16 @@
 #define M_PI 3.14159265358979323846
 #endif
 
+const char* scenarioName(RayScenario scenario) {
+    switch (scenario) {
+        case RayScenario::POINT_SOURCE: return "point";
+        case RayScenario::ORBITING: return "orbiting";
+        default: return "parallel";
+    }
+}
+
 Ray::Ray(double x, double y, double vx, double vy, RayScenario scenario, int startFrame)
-    : scenario{scenario}, startFrame{startFrame} {
+    : trailSlot{0}, scenario{scenario}, startFrame{startFrame} {
     // Convert to polar coordinates
     r = std::sqrt(x * x + y * y);
     phi = std::atan2(y, x);
@@ -21,35 +30,36 @@ Ray::Ray(double x, double y, double vx, double vy, RayScenario scenario, int sta
     v_phi = (-vx * std::sin(phi) + vy * std::cos(phi)) / r;
 
     // Calculate conserved quantities
-    L = r * r * v_phi;
-    double f{1.0 - BlackHole::rs / r};
-    double dt_dlambda{std::sqrt((v_r * v_r) / (f * f) + (r * r * v_phi * v_phi) / f)};
-    E = f * dt_dlambda;
-
-    trail.push_back(glm::vec2(static_cast<float>(x), static_cast<float>(y)));
+    Physics::Schwarzschild::constants(*this, E, L);
+    deflection = 0.0;
 }
 
 bool Ray::isCaptured() const {
-    return r <= BlackHole::rs * 1.01;
+    return r <= Physics::captureRadius();
 }
 
 bool Ray::hasEscaped(double maxDistance) const {
     return r > maxDistance;
 }
 
-void Ray::recordPosition() {
+glm::vec2 Ray::position() const {
     const float x{static_cast<float>(r * std::cos(phi))};
     const float y{static_cast<float>(r * std::sin(phi))};
-    trail.push_back(glm::vec2(x, y));
+    return glm::vec2(x, y);
+}
+
+void Ray::recordPosition(TrailStore& trails) const {
+    trails.push(trailSlot, position());
 }
 
-void Ray::integrate(double dlambda, double maxDistance, int currentFrame) {
+bool Ray::integrate(double dlambda, double maxDistance, int currentFrame, TrailStore& trails) {
     if (!isActive(currentFrame) || isCaptured() || hasEscaped(maxDistance)) {
-        return;
+        return false;
     }
     Physics::rk4Step(*this, dlambda);
-    recordPosition();
+    recordPosition(trails);
     updateDeflection();
+    return true;
 }
 
 void Ray::updateDeflection() {
@@ -1,7 +1,8 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <vector>
+#include <cstddef>
+#include "trail_store.h"
 
 // Ray scenario types for different visual effects
 enum class RayScenario {
@@ -10,6 +11,9 @@ enum class RayScenario {
     ORBITING       // Special orbiting ray
 };
 
+// Short lowercase name for a scenario (used in output files)
+const char* scenarioName(RayScenario scenario);
+
 // Ray representation in Schwarzschild coordinates
 struct Ray {
     // Schwarzschild coordinates
@@ -23,30 +27,36 @@ struct Ray {
     double L;      // Angular momentum per unit mass
 
     // Visualization data
-    std::vector<glm::vec2> trail;
+    std::size_t trailSlot;    // This ray's trail in the owning TrailStore
     double initialVelocityAngle;
     double deflection;
 
     // Scenario tracking
     RayScenario scenario;
-    int startFrame;
+    int startFrame;    // First simulation step the ray is integrated on
 
     // Constructor: Initialize ray from Cartesian position and velocity
     Ray(double x, double y, double vx, double vy,
         RayScenario scenario = RayScenario::PARALLEL,
         int startFrame = 0);
 
-    // Check if ray has been captured by black hole
+    // Check if ray has been captured by black hole (Physics::captureRadius
+    // of the active metric)
     bool isCaptured() const;
 
     // Check if ray has escaped to infinity
     bool hasEscaped(double maxDistance) const;
 
+    // Current position in Cartesian world coordinates
+    glm::vec2 position() const;
+
     // Record current position to trail
-    void recordPosition();
+    void recordPosition(TrailStore& trails) const;
 
-    // Integrate ray forward one step (checks if active, captured, or escaped)
-    void integrate(double dlambda, double maxDistance, int currentFrame);
+    // Integrate ray forward one Schwarzschild step (checks if active,
+    // captured, or escaped); Physics::integrateRays steps in any metric
+    // Returns true if a step was actually taken
+    bool integrate(double dlambda, double maxDistance, int currentFrame, TrailStore& trails);
 
     // Update deflection angle (for color coding)
     void updateDeflection();
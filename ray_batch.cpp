@@ -0,0 +1,62 @@
+#include "ray_batch.h"
+
+RayBatch RayBatch::fromRays(const std::vector<Ray>& rays) {
+    RayBatch batch;
+    batch.r.reserve(rays.size());
+    batch.phi.reserve(rays.size());
+    batch.v_r.reserve(rays.size());
+    batch.v_phi.reserve(rays.size());
+    batch.E.reserve(rays.size());
+    batch.startFrame.reserve(rays.size());
+    batch.ids.reserve(rays.size());
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        batch.push(rays[i], i);
+    }
+    return batch;
+}
+
+void RayBatch::push(const Ray& ray, std::size_t id) {
+    r.push_back(ray.r);
+    phi.push_back(ray.phi);
+    v_r.push_back(ray.v_r);
+    v_phi.push_back(ray.v_phi);
+    E.push_back(ray.E);
+    startFrame.push_back(ray.startFrame);
+    ids.push_back(id);
+}
+
+void RayBatch::reserve(std::size_t count) {
+    r.reserve(count);
+    phi.reserve(count);
+    v_r.reserve(count);
+    v_phi.reserve(count);
+    E.reserve(count);
+    startFrame.reserve(count);
+    ids.reserve(count);
+}
+
+void RayBatch::remove(std::size_t i) {
+    const std::size_t last{size() - 1};
+    r[i] = r[last];
+    phi[i] = phi[last];
+    v_r[i] = v_r[last];
+    v_phi[i] = v_phi[last];
+    E[i] = E[last];
+    startFrame[i] = startFrame[last];
+    ids[i] = ids[last];
+
+    r.pop_back();
+    phi.pop_back();
+    v_r.pop_back();
+    v_phi.pop_back();
+    E.pop_back();
+    startFrame.pop_back();
+    ids.pop_back();
+}
+
+void RayBatch::store(std::size_t i, Ray& ray) const {
+    ray.r = r[i];
+    ray.phi = phi[i];
+    ray.v_r = v_r[i];
+    ray.v_phi = v_phi[i];
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "constants.h"
+#include "ray.h"
+
+// Structure-of-arrays copy of the ray phase-space state.
+// Keeps the integrator's hot data contiguous so it can be advanced
+// several rays at a time, without touching trails or render data.
+struct RayBatch {
+    std::vector<double> r;
+    std::vector<double> phi;
+    std::vector<double> v_r;
+    std::vector<double> v_phi;
+    std::vector<double> E;
+    std::vector<int> startFrame;
+    std::vector<std::size_t> ids;   // Index of each entry's Ray in the owner's array
+
+    // Build a batch mirroring the given rays (same order, ids = indices)
+    static RayBatch fromRays(const std::vector<Ray>& rays);
+
+    // Append one ray's state
+    void push(const Ray& ray, std::size_t id);
+
+    // Room for count entries, so pushes up to it never reallocate
+    void reserve(std::size_t count);
+
+    // Remove entry i by moving the last entry into its place
+    void remove(std::size_t i);
+
+    // Copy batch state for index i back into a Ray
+    void store(std::size_t i, Ray& ray) const;
+
+    std::size_t size() const { return r.size(); }
+};
+
+// Structure-of-arrays ray state in geometrized units (see Units) with a
+// compile-time scalar type. GeoBatch<float> halves the memory traffic of
+// GeoBatch<double> and fits twice as many rays in a vector register.
+// Rays convert to and from SI only on push and store.
+template <typename Real>
+struct GeoBatch {
+    std::vector<Real> r;        // Units of rs
+    std::vector<Real> phi;
+    std::vector<Real> v_r;      // Units of c
+    std::vector<Real> v_phi;    // Radians per unit affine parameter
+    std::vector<Real> E;        // Units of c
+    std::vector<int> startFrame;
+    std::vector<std::size_t> ids;   // Index of each entry's Ray in the owner's array
+
+    // Append one ray's state, converted from SI
+    void push(const Ray& ray, std::size_t id) {
+        r.push_back(static_cast<Real>(ray.r / Units::LENGTH));
+        phi.push_back(static_cast<Real>(ray.phi));
+        v_r.push_back(static_cast<Real>(ray.v_r / Units::SPEED));
+        v_phi.push_back(static_cast<Real>(ray.v_phi * Units::AFFINE));
+        E.push_back(static_cast<Real>(ray.E / Units::SPEED));
+        startFrame.push_back(ray.startFrame);
+        ids.push_back(id);
+    }
+
+    // Room for count entries, so pushes up to it never reallocate
+    void reserve(std::size_t count) {
+        r.reserve(count);
+        phi.reserve(count);
+        v_r.reserve(count);
+        v_phi.reserve(count);
+        E.reserve(count);
+        startFrame.reserve(count);
+        ids.reserve(count);
+    }
+
+    // Remove entry i by moving the last entry into its place
+    void remove(std::size_t i) {
+        const std::size_t last{size() - 1};
+        r[i] = r[last];
+        phi[i] = phi[last];
+        v_r[i] = v_r[last];
+        v_phi[i] = v_phi[last];
+        E[i] = E[last];
+        startFrame[i] = startFrame[last];
+        ids[i] = ids[last];
+
+        r.pop_back();
+        phi.pop_back();
+        v_r.pop_back();
+        v_phi.pop_back();
+        E.pop_back();
+        startFrame.pop_back();
+        ids.pop_back();
+    }
+
+    // Copy entry i back into a Ray, converted to SI
+    void store(std::size_t i, Ray& ray) const {
+        ray.r = static_cast<double>(r[i]) * Units::LENGTH;
+        ray.phi = static_cast<double>(phi[i]);
+        ray.v_r = static_cast<double>(v_r[i]) * Units::SPEED;
+        ray.v_phi = static_cast<double>(v_phi[i]) / Units::AFFINE;
+    }
+
+    void clear() {
+        r.clear();
+        phi.clear();
+        v_r.clear();
+        v_phi.clear();
+        E.clear();
+        startFrame.clear();
+        ids.clear();
+    }
+
+    std::size_t size() const { return r.size(); }
+
+    // Kernel capture radius: the largest Real whose SI radius is still
+    // captured (r <= 1.01 rs), so a ray the kernel stops as captured is
+    // captured once stored
+    static Real captureRadius() {
+        return largestBelow(BlackHole::rs * 1.01);
+    }
+
+    // Kernel escape distance for maxDistance (SI): the largest Real whose
+    // SI radius has not escaped, so a ray the kernel stops beyond it has
+    // escaped once stored
+    static Real escapeDistance(double maxDistance) {
+        return largestBelow(maxDistance);
+    }
+
+private:
+    // Largest Real x with x * Units::LENGTH <= limit (in double)
+    static Real largestBelow(double limit) {
+        const Real up{std::numeric_limits<Real>::max()};
+        Real x{static_cast<Real>(limit / Units::LENGTH)};
+        while (static_cast<double>(x) * Units::LENGTH > limit) {
+            x = std::nextafter(x, Real{0});
+        }
+        while (x < up && static_cast<double>(std::nextafter(x, up)) * Units::LENGTH <= limit) {
+            x = std::nextafter(x, up);
+        }
+        return x;
+    }
+};
@@ -0,0 +1,578 @@
+#include "recording.h"
+#include "constants.h"
+#include "simulation.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Recording {
+
+namespace {
+
+constexpr char MAGIC[8]{'B', 'H', 'R', 'E', 'C', '0', '0', '1'};
+constexpr char END_MAGIC[8]{'B', 'H', 'R', 'E', 'C', 'E', 'N', 'D'};
+constexpr std::uint32_t VERSION{1};
+constexpr std::uint32_t BLOCK_MAGIC{0x314b4c42};  // "BLK1"
+
+// Steps buffered per block: longer windows mean fewer, longer runs
+constexpr std::uint32_t WINDOW{256};
+
+// Windows queued for the writer before capture() waits for it
+constexpr std::size_t MAX_QUEUED{2};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t rayCount;
+    std::uint32_t window;
+    std::uint32_t reserved;
+    double stepSize;
+};
+
+struct BlockHeader {
+    std::uint32_t magic;
+    std::uint32_t runCount;
+    std::uint64_t sampleCount;
+};
+
+struct BlockRun {
+    std::uint32_t ray;
+    std::uint32_t frame;   // Step of the run's first sample
+    std::uint32_t count;
+    std::uint32_t first;   // Index of the first sample in the block's columns
+};
+
+struct IndexHeader {
+    std::uint32_t frames;
+    std::uint32_t reserved;
+};
+
+struct Trailer {
+    std::uint64_t indexOffset;
+    char magic[8];
+};
+
+static_assert(sizeof(FileHeader) == 32, "recording header layout");
+static_assert(sizeof(BlockHeader) == 16, "recording block layout");
+static_assert(sizeof(BlockRun) == 16, "recording block layout");
+static_assert(sizeof(Trailer) == 16, "recording trailer layout");
+
+} // namespace
+
+namespace Format {
+
+struct RayEntry {
+    std::uint8_t scenario;
+    std::uint8_t reserved[3];
+    std::int32_t startFrame;
+};
+
+struct RayIndex {
+    std::uint32_t lastFrame;
+    RayState state;
+    std::uint8_t reserved[3];
+};
+
+struct RunEntry {
+    std::uint32_t frame;
+    std::uint32_t count;
+    std::uint64_t positions;
+    std::uint64_t deflections;
+};
+
+static_assert(sizeof(RayEntry) == 8, "recording ray table layout");
+static_assert(sizeof(RayIndex) == 8, "recording index layout");
+static_assert(sizeof(RunEntry) == 24, "recording index layout");
+
+} // namespace Format
+
+Recorder::Recorder(const std::string& filePath, const Simulation::Simulator& sim)
+    : file{nullptr}, path{filePath}, offset{0}, failed{false}, lastFrame{sim.frame},
+      windowStart{static_cast<std::uint32_t>(sim.frame)}, stopping{false} {
+    const std::size_t rayCount{sim.rays.size()};
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open " << path << " for recording\n";
+        return;
+    }
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.rayCount = static_cast<std::uint32_t>(rayCount);
+    header.window = WINDOW;
+    header.stepSize = sim.stepSize;
+    write(&header, sizeof(header));
+
+    std::vector<Format::RayEntry> table(rayCount);
+    initial.resize(rayCount);
+    for (std::size_t i{0}; i < rayCount; ++i) {
+        const Ray& ray{sim.rays[i]};
+        table[i] = Format::RayEntry{static_cast<std::uint8_t>(ray.scenario), {0, 0, 0}, ray.startFrame};
+        initial[i] = ray.position();
+    }
+    write(table.data(), table.size() * sizeof(Format::RayEntry));
+    if (failed) {
+        std::cerr << "Failed to write " << path << "\n";
+        std::fclose(file);
+        file = nullptr;
+        return;
+    }
+
+    started.assign(rayCount, 0);
+    rayLastFrame.assign(rayCount, 0);
+    state.assign(rayCount, RayState::ACTIVE);
+    writer = std::thread(&Recorder::writerLoop, this);
+}
+
+Recorder::~Recorder() {
+    close();
+}
+
+void Recorder::capture(const Simulation::Simulator& sim, std::size_t frozenBefore) {
+    if (!file) {
+        return;
+    }
+    const std::uint32_t frame{static_cast<std::uint32_t>(sim.frame)};
+
+    // Only rays that were active during the step moved: those still active
+    // and those that just retired
+    auto record = [&](std::size_t id) {
+        const Ray& ray{sim.rays[id]};
+        if (!started[id]) {
+            // Where the ray was when this step began
+            started[id] = 1;
+            sample(static_cast<std::uint32_t>(id), frame - 1, initial[id], 0.0);
+        }
+        sample(static_cast<std::uint32_t>(id), frame, ray.position(), ray.deflection);
+        rayLastFrame[id] = frame;
+    };
+    for (const std::size_t id : sim.active) {
+        record(id);
+    }
+    for (std::size_t i{frozenBefore}; i < sim.frozen.size(); ++i) {
+        const std::size_t id{sim.frozen[i]};
+        record(id);
+        state[id] = sim.rays[id].isCaptured() ? RayState::CAPTURED : RayState::ESCAPED;
+    }
+
+    lastFrame = sim.frame;
+    if (frame - windowStart >= WINDOW) {
+        submitWindow();
+    }
+}
+
+void Recorder::sample(std::uint32_t ray, std::uint32_t frame, glm::vec2 position, double deflection) {
+    window.push_back(Sample{ray, frame, position, static_cast<float>(deflection)});
+}
+
+void Recorder::submitWindow() {
+    std::unique_lock<std::mutex> lock{mutex};
+    changed.wait(lock, [this] { return queue.size() < MAX_QUEUED; });
+    queue.push_back(std::move(window));
+    if (!spare.empty()) {
+        window = std::move(spare.back());
+        spare.pop_back();
+    } else {
+        window = std::vector<Sample>{};
+    }
+    window.clear();
+    windowStart = static_cast<std::uint32_t>(lastFrame);
+    lock.unlock();
+    changed.notify_all();
+}
+
+void Recorder::writerLoop() {
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;) {
+        changed.wait(lock, [this] { return !queue.empty() || stopping; });
+        if (queue.empty()) {
+            return;
+        }
+
+        // The window stays queued while it is written, so at most
+        // MAX_QUEUED windows of samples exist at once
+        std::vector<Sample> samples{std::move(queue.front())};
+        lock.unlock();
+        writeBlock(samples);
+        samples.clear();
+        lock.lock();
+
+        queue.erase(queue.begin());
+        spare.push_back(std::move(samples));
+        changed.notify_all();
+    }
+}
+
+void Recorder::writeBlock(const std::vector<Sample>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+
+    // Counting sort by ray; stable, so each ray's samples stay in step order
+    const std::size_t rayCount{initial.size()};
+    rayCounts.assign(rayCount + 1, 0);
+    for (const Sample& s : samples) {
+        ++rayCounts[s.ray + 1];
+    }
+    for (std::size_t i{0}; i < rayCount; ++i) {
+        rayCounts[i + 1] += rayCounts[i];
+    }
+    std::vector<glm::vec2> positions(samples.size());
+    std::vector<float> deflections(samples.size());
+    std::vector<std::uint32_t> frames(samples.size());
+    {
+        std::vector<std::uint32_t> next(rayCounts.begin(), rayCounts.end() - 1);
+        for (const Sample& s : samples) {
+            const std::uint32_t at{next[s.ray]++};
+            positions[at] = s.position;
+            deflections[at] = s.deflection;
+            frames[at] = s.frame;
+        }
+    }
+
+    // A run is a ray's samples over consecutive steps (normally one per ray)
+    std::vector<BlockRun> blockRuns;
+    for (std::uint32_t ray{0}; ray < rayCount; ++ray) {
+        for (std::uint32_t i{rayCounts[ray]}; i < rayCounts[ray + 1];) {
+            std::uint32_t end{i + 1};
+            while (end < rayCounts[ray + 1] && frames[end] == frames[end - 1] + 1) {
+                ++end;
+            }
+            blockRuns.push_back(BlockRun{ray, frames[i], end - i, i});
+            i = end;
+        }
+    }
+
+    const BlockHeader header{BLOCK_MAGIC, static_cast<std::uint32_t>(blockRuns.size()), samples.size()};
+    const std::uint64_t positionBase{offset + sizeof(header) + blockRuns.size() * sizeof(BlockRun)};
+    const std::uint64_t deflectionBase{positionBase + samples.size() * sizeof(glm::vec2)};
+    for (const BlockRun& run : blockRuns) {
+        runs.push_back(Run{run.ray, run.frame, run.count,
+                           positionBase + run.first * sizeof(glm::vec2),
+                           deflectionBase + run.first * sizeof(float)});
+    }
+
+    write(&header, sizeof(header));
+    write(blockRuns.data(), blockRuns.size() * sizeof(BlockRun));
+    write(positions.data(), positions.size() * sizeof(glm::vec2));
+    write(deflections.data(), deflections.size() * sizeof(float));
+
+    // Keep the next block 8-byte aligned for the mapped reader
+    const std::uint64_t zero{0};
+    write(&zero, (8 - offset % 8) % 8);
+}
+
+void Recorder::write(const void* data, std::size_t bytes) {
+    if (bytes > 0 && std::fwrite(data, 1, bytes, file) != bytes) {
+        failed = true;
+    }
+    offset += bytes;
+}
+
+bool Recorder::close() {
+    if (!file) {
+        return !failed;
+    }
+    if (!window.empty()) {
+        submitWindow();
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    changed.notify_all();
+    writer.join();
+
+    writeIndex();
+    if (std::fclose(file) != 0) {
+        failed = true;
+    }
+    file = nullptr;
+    if (failed) {
+        std::cerr << "Failed to write recording " << path << "\n";
+    }
+    return !failed;
+}
+
+bool Recorder::writeIndex() {
+    const std::uint64_t indexOffset{offset};
+    const std::size_t rayCount{initial.size()};
+
+    const IndexHeader header{static_cast<std::uint32_t>(lastFrame), 0};
+    write(&header, sizeof(header));
+
+    std::vector<Format::RayIndex> rayIndex(rayCount);
+    for (std::size_t i{0}; i < rayCount; ++i) {
+        rayIndex[i] = Format::RayIndex{rayLastFrame[i], state[i], {0, 0, 0}};
+    }
+    write(rayIndex.data(), rayIndex.size() * sizeof(Format::RayIndex));
+
+    // Runs were appended window by window; regroup them per ray
+    std::vector<std::uint64_t> runStart(rayCount + 1, 0);
+    for (const Run& run : runs) {
+        ++runStart[run.ray + 1];
+    }
+    for (std::size_t i{0}; i < rayCount; ++i) {
+        runStart[i + 1] += runStart[i];
+    }
+    std::vector<Format::RunEntry> entries(runs.size());
+    {
+        std::vector<std::uint64_t> next(runStart.begin(), runStart.end() - 1);
+        for (const Run& run : runs) {
+            entries[next[run.ray]++] = Format::RunEntry{run.frame, run.count, run.positions, run.deflections};
+        }
+    }
+    write(runStart.data(), runStart.size() * sizeof(std::uint64_t));
+    write(entries.data(), entries.size() * sizeof(Format::RunEntry));
+
+    Trailer trailer{indexOffset, {}};
+    std::memcpy(trailer.magic, END_MAGIC, sizeof(END_MAGIC));
+    write(&trailer, sizeof(trailer));
+    return !failed;
+}
+
+Replay::Replay()
+    : data{nullptr}, size{0}, rays{0}, frames{0}, step{0.0},
+      rayTable{nullptr}, rayIndex{nullptr}, runStart{nullptr}, runTable{nullptr}
+#ifdef _WIN32
+      , fileHandle{INVALID_HANDLE_VALUE}, mappingHandle{nullptr}
+#endif
+{
+}
+
+Replay::~Replay() {
+    close();
+}
+
+void Replay::close() {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+    }
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    if (data) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+bool Replay::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize{};
+    if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize)) {
+        std::cerr << "Failed to open recording " << path << "\n";
+        close();
+        return false;
+    }
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+    if (size > 0) {
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle) {
+            data = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        }
+    }
+#else
+    const int fd{::open(path.c_str(), O_RDONLY)};
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Failed to open recording " << path << "\n";
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    size = static_cast<std::size_t>(info.st_size);
+    if (size > 0) {
+        void* mapped{mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+        if (mapped != MAP_FAILED) {
+            data = static_cast<const unsigned char*>(mapped);
+        }
+    }
+    ::close(fd);
+#endif
+    if (!data) {
+        std::cerr << "Failed to map recording " << path << "\n";
+        close();
+        return false;
+    }
+
+    // Header, trailer and table bounds; nothing else is touched until drawn
+    auto fail = [&](const char* why) {
+        std::cerr << "Bad recording " << path << ": " << why << "\n";
+        close();
+        return false;
+    };
+    if (size < sizeof(FileHeader) + sizeof(Trailer)) {
+        return fail("too short");
+    }
+    FileHeader header;
+    Trailer trailer;
+    std::memcpy(&header, data, sizeof(header));
+    std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+        return fail("not a recording, or another version");
+    }
+    if (std::memcmp(trailer.magic, END_MAGIC, sizeof(END_MAGIC)) != 0) {
+        return fail("missing index (recording was not closed)");
+    }
+
+    // Every offset and count below comes from the file; sizes are bounded
+    // before they are multiplied, so none of the arithmetic can wrap
+    const std::uint64_t body{size - sizeof(Trailer)};
+    rays = header.rayCount;
+    step = header.stepSize;
+    if (rays > body / sizeof(Format::RayEntry)) {
+        return fail("index corrupt");
+    }
+    const std::uint64_t tableEnd{sizeof(FileHeader) + rays * sizeof(Format::RayEntry)};
+    const std::uint64_t indexOffset{trailer.indexOffset};
+    if (indexOffset < tableEnd || indexOffset % 8 != 0 || indexOffset > body) {
+        return fail("index out of range");
+    }
+    const std::uint64_t runStartOffset{indexOffset + sizeof(IndexHeader) + rays * sizeof(Format::RayIndex)};
+    const std::uint64_t runTableOffset{runStartOffset + (rays + 1) * sizeof(std::uint64_t)};
+    if (runTableOffset > body) {
+        return fail("index out of range");
+    }
+    IndexHeader index;
+    std::memcpy(&index, data + indexOffset, sizeof(index));
+    if (index.frames > static_cast<std::uint32_t>(std::numeric_limits<int>::max())) {
+        return fail("index corrupt");
+    }
+    frames = static_cast<int>(index.frames);
+
+    rayTable = reinterpret_cast<const Format::RayEntry*>(data + sizeof(FileHeader));
+    rayIndex = reinterpret_cast<const Format::RayIndex*>(data + indexOffset + sizeof(IndexHeader));
+    runStart = reinterpret_cast<const std::uint64_t*>(data + runStartOffset);
+    runTable = reinterpret_cast<const Format::RunEntry*>(data + runTableOffset);
+    if (runStart[rays] > (body - runTableOffset) / sizeof(Format::RunEntry)) {
+        return fail("run table out of range");
+    }
+
+    // Each ray's runs: a slice of the run table, in frame order without
+    // overlap, with samples inside the data blocks between the ray table
+    // and the index. O(rays + runs); the blocks themselves are not read.
+    if (runStart[0] != 0) {
+        return fail("index corrupt");
+    }
+    for (std::size_t i{0}; i < rays; ++i) {
+        if (runStart[i] > runStart[i + 1] || rayTable[i].scenario > static_cast<std::uint8_t>(RayScenario::ORBITING)) {
+            return fail("index corrupt");
+        }
+        std::uint64_t nextFrame{0};
+        for (std::uint64_t k{runStart[i]}; k < runStart[i + 1]; ++k) {
+            const Format::RunEntry& run{runTable[k]};
+            const std::uint64_t count{run.count};
+            if (count == 0 || run.frame < nextFrame || run.frame + count - 1 > UINT32_MAX ||
+                run.positions % 4 != 0 || run.deflections % 4 != 0 ||
+                run.positions < tableEnd || run.positions > indexOffset ||
+                count > (indexOffset - run.positions) / sizeof(glm::vec2) ||
+                run.deflections < tableEnd || run.deflections > indexOffset ||
+                count > (indexOffset - run.deflections) / sizeof(float)) {
+                return fail("index corrupt");
+            }
+            nextFrame = run.frame + count;
+        }
+    }
+    return true;
+}
+
+void Replay::build(int frame, std::size_t trailLength, ReplayFrame& out) const {
+    out.trails.clear();
+    out.heads.clear();
+    out.headScenarios.clear();
+    if (!data || frame < 0) {
+        return;
+    }
+    const std::uint32_t at{static_cast<std::uint32_t>(frame)};
+    trailLength = std::max<std::size_t>(2, trailLength);
+
+    for (std::size_t i{0}; i < rays; ++i) {
+        const Format::RunEntry* first{runTable + runStart[i]};
+        const Format::RunEntry* last{runTable + runStart[i + 1]};
+        if (first == last || at < first->frame) {
+            continue;
+        }
+
+        // Steps [lo, hi] of the trail: the ray stops moving at lastFrame
+        const Format::RayIndex& index{rayIndex[i]};
+        const std::uint32_t hi{std::min(at, index.lastFrame)};
+        const std::uint32_t lo{std::max<std::uint32_t>(
+            first->frame, hi + 1 >= trailLength ? hi + 1 - static_cast<std::uint32_t>(trailLength) : 0)};
+
+        // Last run starting at or before lo
+        const Format::RunEntry* run{std::upper_bound(first, last, lo, [](std::uint32_t f, const Format::RunEntry& r) {
+            return f < r.frame;
+        }) - 1};
+
+        const std::size_t begin{out.trails.positions.size()};
+        float deflection{0.0f};
+        for (; run != last && run->frame <= hi; ++run) {
+            const std::uint32_t from{std::max(lo, run->frame)};
+            const std::uint32_t to{std::min(hi, run->frame + run->count - 1)};
+            if (from > to) {
+                continue;
+            }
+            const glm::vec2* points{reinterpret_cast<const glm::vec2*>(data + run->positions)};
+            const float* deflections{reinterpret_cast<const float*>(data + run->deflections)};
+            for (std::uint32_t f{from}; f <= to; ++f) {
+                out.trails.positions.push_back(points[f - run->frame]);
+            }
+            deflection = deflections[to - run->frame];
+        }
+
+        const std::size_t count{out.trails.positions.size() - begin};
+        if (count == 0) {
+            continue;
+        }
+        const RayScenario scenario{static_cast<RayScenario>(rayTable[i].scenario)};
+        const glm::vec2 head{out.trails.positions.back()};
+        if (count >= 2) {
+            float r, g, b;
+            Rendering::rayColor(scenario, deflection, r, g, b);
+            for (std::size_t k{0}; k < count; ++k) {
+                const float alpha{0.2f + 0.8f * static_cast<float>(k) / static_cast<float>(count - 1)};
+                out.trails.colors.push_back(glm::vec4(r, g, b, alpha));
+            }
+            out.trails.firsts.push_back(static_cast<int>(begin));
+            out.trails.counts.push_back(static_cast<int>(count));
+        } else {
+            out.trails.positions.resize(begin);
+        }
+
+        // Heads for rays still moving; captured and escaped rays keep only their trail
+        if (at < index.lastFrame || index.state == RayState::ACTIVE) {
+            out.heads.push_back(head);
+            out.headScenarios.push_back(scenario);
+        }
+    }
+}
+
+} // namespace Recording
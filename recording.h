@@ -0,0 +1,176 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ray.h"
+#include "trail_vertices.h"
+
+namespace Simulation {
+    struct Simulator;
+}
+
+// Trajectory recording and replay.
+//
+// A recording holds each ray's position and deflection at every simulation
+// step, laid out for replay rather than for writing:
+//   header      magic, version, ray count, window, step size
+//   ray table   scenario and start step per ray
+//   blocks      one per window of steps: a run table (ray, first step,
+//               sample count) then a position column and a deflection
+//               column, each run's samples contiguous
+//   index       per ray: last step, final state and its runs' offsets
+//   trailer     index offset and end magic
+// Blocks are appended by a background thread while the simulation runs;
+// the index goes last when the recording is closed. Replay maps the file
+// and reads any step's trails straight from the mapping.
+namespace Recording {
+    // On-disk records (defined in recording.cpp)
+    namespace Format {
+        struct RayEntry;
+        struct RayIndex;
+        struct RunEntry;
+    }
+
+    // Final state of a recorded ray
+    enum class RayState : std::uint8_t {
+        ACTIVE,     // Still moving when the recording ended
+        CAPTURED,
+        ESCAPED
+    };
+
+    // Streams a simulator's steps to a recording file. Feed it through
+    // Simulator::recorder; samples are buffered for a window of steps, then
+    // regrouped per ray and written by a background thread.
+    struct Recorder {
+        // Create the file and write the header and ray table; check ok()
+        Recorder(const std::string& path, const Simulation::Simulator& sim);
+        ~Recorder();
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        bool ok() const { return file != nullptr; }
+
+        // Record the step that just ran, given the frozen set's size before it
+        void capture(const Simulation::Simulator& sim, std::size_t frozenBefore);
+
+        // Flush buffered steps, write the index and close the file.
+        // Called by the destructor if needed; returns false on a write error.
+        bool close();
+
+        // Steps recorded so far
+        int frames() const { return lastFrame; }
+
+    private:
+        struct Sample {
+            std::uint32_t ray;
+            std::uint32_t frame;
+            glm::vec2 position;
+            float deflection;
+        };
+
+        struct Run {
+            std::uint32_t ray;
+            std::uint32_t frame;
+            std::uint32_t count;
+            std::uint64_t positions;    // File offsets of the run's first sample
+            std::uint64_t deflections;
+        };
+
+        std::FILE* file;
+        std::string path;
+        std::uint64_t offset;                  // Bytes written so far
+        bool failed;
+        int lastFrame;
+
+        std::vector<glm::vec2> initial;        // Starting position per ray
+        std::vector<unsigned char> started;    // Ray has been sampled
+        std::vector<std::uint32_t> rayLastFrame;
+        std::vector<RayState> state;
+
+        // Samples of the current window, in step order (simulation thread)
+        std::vector<Sample> window;
+        std::uint32_t windowStart;
+
+        // Hand-off of full windows to the writer, at most two in flight
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<std::vector<Sample>> queue;
+        std::vector<std::vector<Sample>> spare;  // Drained buffers for reuse
+        bool stopping;
+        std::thread writer;
+
+        // Writer thread only
+        std::vector<Run> runs;
+        std::vector<std::uint32_t> rayCounts;
+
+        void sample(std::uint32_t ray, std::uint32_t frame, glm::vec2 position, double deflection);
+        void submitWindow();
+        void writerLoop();
+        void writeBlock(const std::vector<Sample>& samples);
+        void write(const void* data, std::size_t bytes);
+        bool writeIndex();
+    };
+
+    // One replayed step, ready to draw
+    struct ReplayFrame {
+        Rendering::TrailVertices trails;
+        std::vector<glm::vec2> heads;          // Rays still moving at this step
+        std::vector<RayScenario> headScenarios;
+    };
+
+    // Memory-mapped recording. Opening reads the header, trailer and index
+    // and checks every ray's runs, in time proportional to rays plus runs;
+    // the sample blocks are not read, and trail points come from the
+    // mapping on demand.
+    struct Replay {
+        Replay();
+        ~Replay();
+
+        Replay(const Replay&) = delete;
+        Replay& operator=(const Replay&) = delete;
+
+        // Map a recording; false (with a message) if missing, truncated or
+        // not closed
+        bool open(const std::string& path);
+
+        std::size_t rayCount() const { return rays; }
+
+        // Last recorded step
+        int frameCount() const { return frames; }
+
+        double stepSize() const { return step; }
+
+        // Bytes mapped
+        std::size_t fileSize() const { return size; }
+
+        // Trails of every ray that has started by frame, each ending at its
+        // position at that step and at most trailLength points long, with
+        // the same coloring and fade as live trails
+        void build(int frame, std::size_t trailLength, ReplayFrame& out) const;
+
+    private:
+        const unsigned char* data;
+        std::size_t size;
+        std::size_t rays;
+        int frames;
+        double step;
+        const Format::RayEntry* rayTable;
+        const Format::RayIndex* rayIndex;
+        const std::uint64_t* runStart;    // Per ray, rayCount + 1 entries
+        const Format::RunEntry* runTable;
+#ifdef _WIN32
+        void* fileHandle;
+        void* mappingHandle;
+#endif
+
+        void close();
+    };
+}
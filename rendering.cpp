@@ -1,8 +1,13 @@
 #include "rendering.h"
 #include "constants.h"
+#include "metric.h"
 #include "physics.h"
+#include "profiler.h"
+#include "scenario.h"
+#include <algorithm>
 #include <iostream>
 #include <random>
+#include <string>
 #include <cmath>
 
 namespace Rendering {
@@ -12,15 +17,26 @@ RenderEngine::RenderEngine(
     int width,
     int height,
     const char* title,
-    std::vector<Ray>& raysRef
-): rays{&raysRef}, frame{0} {
+    Simulation::Simulator& simRef,
+    bool retainedTrails,
+    bool pipelined,
+    const Simulation::ClockSettings& clockSettings,
+    int windowStars,
+    bool visible,
+    bool bufferedStars
+): sim{&simRef}, starCount{windowStars}, retainedStars{bufferedStars}, trailIndex{simRef.trails}, frozenIndexed{0},
+    frameHalf{Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT}, frameView{camera.view(Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT, 0)},
+    dragging{false}, dragCursor{0.0, 0.0}, burstSize{Visual::BURST_RAYS}, aiming{false}, aimOrigin{0.0, 0.0},
+    beamBuffer{0}, beamVertexCount{0}, clock{clockSettings}, lastFrameTime{-1.0},
+    replay{nullptr}, replayStep{0}, replayTitleStep{-1}, replayPaused{false} {
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW\n";
         std::exit(-1);
     }
 
-    // Create window
+    // Create window (hidden, it still provides the context)
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
     window = glfwCreateWindow(width, height, title, nullptr, nullptr);
     if (!window) {
         std::cerr << "Failed to create window\n";
@@ -29,6 +45,11 @@ RenderEngine::RenderEngine(
     }
 
     glfwMakeContextCurrent(window);
+    glfwSetWindowUserPointer(window, this);
+    glfwSetKeyCallback(window, onKey);
+    glfwSetScrollCallback(window, onScroll);
+    glfwSetMouseButtonCallback(window, onMouseButton);
+    glfwSetCursorPosCallback(window, onCursor);
 
     // Initialize GLEW
     glewExperimental = GL_TRUE;
@@ -47,11 +68,32 @@ RenderEngine::RenderEngine(
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
 
-    // Generate background stars
-    stars = generateStars(Visual::NUM_STARS);
+    // Generate background stars once
+    buildStars(starCount, Visual::VIEW_WIDTH, Visual::VIEW_HEIGHT);
+
+    if (retainedTrails) {
+        trailRenderer = std::make_unique<TrailRenderer>(sim->trails);
+        if (!trailRenderer->ready()) {
+            trailRenderer.reset();
+        }
+    }
+
+    // Last, so the simulation thread starts once everything else is ready
+    if (pipelined) {
+        pipeline = std::make_unique<Simulation::Pipeline>(*sim);
+    }
 }
 
 RenderEngine::~RenderEngine() {
+    // Stop the simulation thread first
+    pipeline.reset();
+
+    // GL objects must go before the context
+    trailRenderer.reset();
+    starField.reset();
+    if (beamBuffer) {
+        glDeleteBuffers(1, &beamBuffer);
+    }
     if (window) {
         glfwDestroyWindow(window);
     }
@@ -59,17 +101,28 @@ RenderEngine::~RenderEngine() {
 }
 
 void RenderEngine::beginFrame(float viewWidth, float viewHeight) {
+    PROFILE_SCOPE("beginFrame");
     glClear(GL_COLOR_BUFFER_BIT);
     glClearColor(0.02f, 0.02f, 0.05f, 1.0f);
 
+    // Level of detail follows the pixels of whatever is bound, window or
+    // offscreen target
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    frameHalf = glm::vec2(viewWidth, viewHeight);
+    frameView = camera.view(viewWidth, viewHeight, viewport[2]);
+
+    const glm::dvec2 half{camera.halfExtents(viewWidth, viewHeight)};
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    glOrtho(-viewWidth, viewWidth, -viewHeight, viewHeight, -1.0, 1.0);
+    glOrtho(camera.center.x - half.x, camera.center.x + half.x,
+            camera.center.y - half.y, camera.center.y + half.y, -1.0, 1.0);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 }
 
 void RenderEngine::endFrame() {
+    PROFILE_SCOPE("endFrame");
     glfwSwapBuffers(window);
     glfwPollEvents();
 }
@@ -79,59 +132,386 @@ bool RenderEngine::shouldClose() const {
 }
 
 void RenderEngine::updatePhysics() {
-    // Integrate all active rays
-    for (auto& ray : *rays) {
-        ray.integrate(Simulation::INTEGRATION_STEP, Simulation::MAX_DISTANCE, frame);
+    PROFILE_SCOPE("updatePhysics");
+    const double now{glfwGetTime()};
+    const double elapsed{lastFrameTime < 0.0 ? 0.0 : now - lastFrameTime};
+    lastFrameTime = now;
+
+    if (replay || !clock.settings.maxThroughput) {
+        advance(elapsed);
+        return;
+    }
+
+    // As many steps as fit the frame budget; pipelined, take what the
+    // simulation thread delivers before the budget runs out
+    int steps{0};
+    double spent{0.0};
+    while (clock.fitsBudget(steps, spent)) {
+        if (!pipeline) {
+            sim->step();
+        } else if (steps == 0) {
+            pipeline->advance();
+        } else if (!pipeline->advanceWithin(clock.settings.frameBudget - spent)) {
+            break;
+        }
+        ++steps;
+        spent = glfwGetTime() - now;
+    }
+    if (!pipeline) {
+        sim->syncAngles();
+    }
+    PROFILE_COUNTER("simulation steps", steps);
+}
+
+int RenderEngine::advance(double elapsed) {
+    const int due{clock.stepsDue(elapsed)};
+
+    // Playback follows the same clock, without integrating anything
+    if (replay) {
+        const int from{replayStep};
+        if (!replayPaused) {
+            replayStep = std::min(replay->frameCount(), replayStep + due);
+        }
+        return replayStep - from;
+    }
+
+    for (int steps{0}; steps < due; ++steps) {
+        if (pipeline) {
+            pipeline->advance();
+        } else {
+            sim->step();
+        }
+    }
+    if (!pipeline) {
+        sim->syncAngles();
+    }
+    PROFILE_COUNTER("simulation steps", due);
+    return due;
+}
+
+void RenderEngine::buildStars(int count, float viewWidth, float viewHeight) {
+    // With shaders the GPU copy is all that is drawn
+    starField.reset();
+    stars = generateStars(count, sim->seed, viewWidth, viewHeight);
+    if (!retainedStars) {
+        return;
+    }
+    starField = std::make_unique<StarField>(stars);
+    if (starField->ready()) {
+        stars = std::vector<glm::vec2>{};
+    } else {
+        starField.reset();
+    }
+}
+
+void RenderEngine::coverStars(float viewWidth, float viewHeight) {
+    const double area{static_cast<double>(viewWidth) * viewHeight};
+    const double windowArea{static_cast<double>(Visual::VIEW_WIDTH) * Visual::VIEW_HEIGHT};
+    buildStars(static_cast<int>(std::lround(starCount * area / windowArea)), viewWidth, viewHeight);
+}
+
+int RenderEngine::shownStep() const {
+    if (replay) {
+        return replayStep;
+    }
+    return pipeline ? pipeline->view().frame : sim->frame;
+}
+
+void RenderEngine::setReplay(const Recording::Replay& recording, int startStep) {
+    replay = &recording;
+    replayStep = std::max(0, std::min(startStep, recording.frameCount()));
+}
+
+void RenderEngine::onKey(GLFWwindow* window, int key, int, int action, int) {
+    RenderEngine* engine{static_cast<RenderEngine*>(glfwGetWindowUserPointer(window))};
+    if (!engine || action == GLFW_RELEASE) {
+        return;
+    }
+    if (key == GLFW_KEY_R) {
+        if (action == GLFW_PRESS) {
+            engine->camera.reset();
+        }
+        return;
+    }
+    if (!engine->replay) {
+        return;
+    }
+
+    int target{engine->replayStep};
+    switch (key) {
+        case GLFW_KEY_SPACE:
+            if (action == GLFW_PRESS) {
+                engine->replayPaused = !engine->replayPaused;
+            }
+            return;
+        case GLFW_KEY_RIGHT: target += 1; break;
+        case GLFW_KEY_LEFT: target -= 1; break;
+        case GLFW_KEY_UP: target += 100; break;
+        case GLFW_KEY_DOWN: target -= 100; break;
+        case GLFW_KEY_HOME: target = 0; break;
+        case GLFW_KEY_END: target = engine->replay->frameCount(); break;
+        default: return;
+    }
+
+    // Seeking pauses so the chosen step stays on screen
+    engine->replayPaused = true;
+    engine->replayStep = std::max(0, std::min(target, engine->replay->frameCount()));
+}
+
+glm::dvec2 RenderEngine::planePoint(double x, double y) const {
+    int width{0};
+    int height{0};
+    glfwGetWindowSize(window, &width, &height);
+    const glm::dvec2 half{camera.halfExtents(frameHalf.x, frameHalf.y)};
+    return camera.center + glm::dvec2((2.0 * x / std::max(width, 1) - 1.0) * half.x,
+                                      (1.0 - 2.0 * y / std::max(height, 1)) * half.y);
+}
+
+void RenderEngine::onScroll(GLFWwindow* window, double, double dy) {
+    RenderEngine* engine{static_cast<RenderEngine*>(glfwGetWindowUserPointer(window))};
+    if (!engine) {
+        return;
+    }
+    double x{0.0};
+    double y{0.0};
+    glfwGetCursorPos(window, &x, &y);
+    engine->camera.zoomAt(engine->planePoint(x, y), std::pow(Visual::ZOOM_STEP, dy));
+}
+
+void RenderEngine::onMouseButton(GLFWwindow* window, int button, int action, int) {
+    RenderEngine* engine{static_cast<RenderEngine*>(glfwGetWindowUserPointer(window))};
+    if (!engine) {
+        return;
+    }
+    double x{0.0};
+    double y{0.0};
+    glfwGetCursorPos(window, &x, &y);
+
+    if (button == GLFW_MOUSE_BUTTON_LEFT) {
+        engine->dragging = action == GLFW_PRESS;
+        engine->dragCursor = glm::dvec2(x, y);
+    } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+        // Press picks the origin, release the aim
+        if (action == GLFW_PRESS) {
+            engine->aiming = true;
+            engine->aimOrigin = engine->planePoint(x, y);
+        } else if (engine->aiming) {
+            engine->aiming = false;
+            engine->spawnBurst(engine->aimOrigin, engine->planePoint(x, y));
+        }
+    }
+}
+
+void RenderEngine::onCursor(GLFWwindow* window, double x, double y) {
+    RenderEngine* engine{static_cast<RenderEngine*>(glfwGetWindowUserPointer(window))};
+    if (!engine || !engine->dragging) {
+        return;
+    }
+
+    // Keep the plane point under the cursor
+    engine->camera.pan(engine->planePoint(engine->dragCursor.x, engine->dragCursor.y) - engine->planePoint(x, y));
+    engine->dragCursor = glm::dvec2(x, y);
+}
+
+void RenderEngine::spawnBurst(glm::dvec2 origin, glm::dvec2 aim) {
+    PROFILE_SCOPE("spawnBurst");
+    if (replay || burstSize <= 0) {
+        return;
+    }
+
+    // The same rays a scenario file's point or cone emitter would give
+    Scenario::Emitter emitter{Scenario::EmitterKind::POINT};
+    emitter.x = origin.x;
+    emitter.y = origin.y;
+    emitter.count = burstSize;
+    const glm::dvec2 offset{aim - origin};
+    const double aimDistance{Visual::BURST_AIM_PIXELS * static_cast<double>(frameView.pixel)};
+    if (offset.x * offset.x + offset.y * offset.y > aimDistance * aimDistance) {
+        emitter.kind = Scenario::EmitterKind::CONE;
+        emitter.spread = Visual::BURST_SPREAD;
+        emitter.aimed = true;
+        emitter.aimX = aim.x;
+        emitter.aimY = aim.y;
     }
-    ++frame;
+    std::vector<Ray> burst{Scenario::generate({emitter}, sim->stepSize)};
+    Physics::initializeRays(burst);
+
+    if (pipeline) {
+        pipeline->spawn(burst);
+    } else {
+        sim->spawn(burst);
+    }
+}
+
+void RenderEngine::indexTrails(const std::vector<Ray>& rays, const TrailStore& trails,
+                               const std::vector<std::size_t>& active, const std::vector<std::size_t>& frozen,
+                               std::size_t recycled) {
+    PROFILE_SCOPE("drawFrame/index");
+    for (const std::size_t id : active) {
+        trailIndex.update(trails, rays[id].trailSlot);
+    }
+
+    // Finished trails never change again, until recycled rays are active
+    // and indexed above
+    frozenIndexed = std::max(frozenIndexed, recycled);
+    for (; frozenIndexed < recycled + frozen.size(); ++frozenIndexed) {
+        trailIndex.update(trails, rays[frozen[frozenIndexed - recycled]].trailSlot);
+    }
+}
+
+void RenderEngine::setBeamField(const Physics::BeamField& field) {
+    // Positions then colors, two vertices per ray
+    const float tickLength{0.04f * Visual::VIEW_WIDTH};
+    const float x{static_cast<float>(field.startX)};
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec3> colors;
+    positions.reserve(2 * field.size());
+    colors.reserve(2 * field.size());
+
+    for (std::size_t i{0}; i < field.size(); ++i) {
+        // Captured rays dark red, escaped rays on the parallel-ray gradient
+        glm::vec3 color{0.4f, 0.0f, 0.0f};
+        if (!field.captured[i]) {
+            const float t{std::min(1.0f, field.deflection[i] / static_cast<float>(M_PI))};
+            color = glm::vec3(t, 0.5f * (1.0f - t), 1.0f - t);
+        }
+        positions.push_back(glm::vec2(x, field.y[i]));
+        positions.push_back(glm::vec2(x + tickLength, field.y[i]));
+        colors.push_back(color);
+        colors.push_back(color);
+    }
+
+    if (!beamBuffer) {
+        glGenBuffers(1, &beamBuffer);
+    }
+    const GLsizeiptr positionBytes{static_cast<GLsizeiptr>(positions.size() * sizeof(glm::vec2))};
+    const GLsizeiptr colorBytes{static_cast<GLsizeiptr>(colors.size() * sizeof(glm::vec3))};
+    glBindBuffer(GL_ARRAY_BUFFER, beamBuffer);
+    glBufferData(GL_ARRAY_BUFFER, positionBytes + colorBytes, nullptr, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, positions.data());
+    glBufferSubData(GL_ARRAY_BUFFER, positionBytes, colorBytes, colors.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    beamVertexCount = static_cast<GLsizei>(positions.size());
 }
 
 void RenderEngine::drawFrame() {
-    // Background stars
-    drawStars(stars);
+    PROFILE_SCOPE("drawFrame");
+
+    // Background stars, far enough away to stay put while the camera moves
+    {
+        PROFILE_SCOPE("drawFrame/stars");
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(-frameHalf.x, frameHalf.x, -frameHalf.y, frameHalf.y, -1.0, 1.0);
+        if (starField) {
+            starField->draw(shownStep());
+        } else {
+            drawStars(stars, shownStep());
+        }
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
 
-    // Photon sphere outline (dashed for visual distinction)
-    glColor3f(0.0f, 0.8f, 0.8f);
-    glLineWidth(2.0f);
-    const float photonRadius{static_cast<float>(1.5 * BlackHole::rs)};
-    drawDashedCircle(0.0f, 0.0f, photonRadius, Visual::CIRCLE_SEGMENTS);
+    {
+        PROFILE_SCOPE("drawFrame/circles");
 
-    // Event horizon (black)
-    glColor3f(0.0f, 0.0f, 0.0f);
-    const float eventRadius{static_cast<float>(BlackHole::rs)};
-    drawCircle(0.0f, 0.0f, eventRadius, Visual::CIRCLE_SEGMENTS);
+        // Photon sphere outline (dashed for visual distinction) of the
+        // active metric; the flat control has none
+        glColor3f(0.0f, 0.8f, 0.8f);
+        glLineWidth(2.0f);
+        const float photonRadius{static_cast<float>(Physics::photonSphereRadius())};
+        if (photonRadius > 0.0f) {
+            drawDashedCircle(0.0f, 0.0f, photonRadius, Visual::CIRCLE_SEGMENTS);
+        }
+
+        // Event horizon (black)
+        glColor3f(0.0f, 0.0f, 0.0f);
+        const float eventRadius{static_cast<float>(Physics::horizonRadius())};
+        drawCircle(0.0f, 0.0f, eventRadius, Visual::CIRCLE_SEGMENTS);
+    }
+
+    // Lookup-classified beam, static since it was uploaded
+    if (beamBuffer) {
+        PROFILE_SCOPE("drawFrame/beam");
+        const std::size_t colorOffset{static_cast<std::size_t>(beamVertexCount) * sizeof(glm::vec2)};
+        glBindBuffer(GL_ARRAY_BUFFER, beamBuffer);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, nullptr);
+        glColorPointer(3, GL_FLOAT, 0, reinterpret_cast<const void*>(colorOffset));
+        glLineWidth(1.0f);
+        glDrawArrays(GL_LINES, 0, beamVertexCount);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
 
     // Mark the point source location
     drawPointSource(Visual::POINT_SOURCE_X, Visual::POINT_SOURCE_Y);
 
-    // Color-coded ray trails
-    drawRays(*rays, frame);
+    // Color-coded ray trails, from the pipeline's copy when the simulator
+    // is busy on its own thread
+    PROFILE_SCOPE("drawFrame/rays");
+    if (replay) {
+        replay->build(replayStep, sim->trails.settings.capacity, replayScratch);
+        [[maybe_unused]] const std::size_t replayed{drawReplay(replayScratch)};
+        PROFILE_COUNTER("trail vertices", replayed);
+        if (replayStep != replayTitleStep) {
+            const std::string title{"2D Black Hole Simulator - Replay step " + std::to_string(replayStep) +
+                                    " / " + std::to_string(replay->frameCount())};
+            glfwSetWindowTitle(window, title.c_str());
+            replayTitleStep = replayStep;
+        }
+        return;
+    }
+
+    const std::vector<Ray>& rays{pipeline ? pipeline->view().rays : sim->rays};
+    const TrailStore& trails{pipeline ? pipeline->view().trails : sim->trails};
+    const std::vector<std::size_t>& active{pipeline ? pipeline->view().active : sim->active};
+    const std::vector<std::size_t>& frozen{pipeline ? pipeline->view().frozen : sim->frozen};
+    const std::size_t recycled{pipeline ? pipeline->view().recycled : sim->recycled};
+    indexTrails(rays, trails, active, frozen, recycled);
+    [[maybe_unused]] std::size_t vertices{0};
+    if (trailRenderer) {
+        vertices = trailRenderer->draw(rays, trails, active, frozen, recycled, trailIndex, frameView);
+        glEnable(GL_BLEND);
+        drawRayHeads(rays, trails, active);
+        glDisable(GL_BLEND);
+    } else {
+        vertices = drawRays(rays, trails, pipeline ? pipeline->view().frame : sim->frame, trailIndex, frameView);
+    }
+    PROFILE_COUNTER("trail vertices", vertices);
 }
 
-std::vector<glm::vec2> generateStars(int count) {
+std::vector<glm::vec2> generateStars(int count, unsigned seed, float halfWidth, float halfHeight) {
     std::vector<glm::vec2> stars;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> distX(-Visual::VIEW_WIDTH, Visual::VIEW_WIDTH);
-    std::uniform_real_distribution<float> distY(-Visual::VIEW_HEIGHT, Visual::VIEW_HEIGHT);
+    stars.reserve(static_cast<std::size_t>(std::max(count, 0)));
+    std::mt19937 gen(seed);
+
+    // 24 bits of the engine per coordinate: uniform_real_distribution's
+    // output differs between standard libraries
+    auto uniform = [&gen](float halfExtent) {
+        return halfExtent * (static_cast<float>(gen() >> 8) * (2.0f / 16777216.0f) - 1.0f);
+    };
 
     for (int i{0}; i < count; ++i) {
-        stars.push_back(glm::vec2(distX(gen), distY(gen)));
+        const float x{uniform(halfWidth)};
+        const float y{uniform(halfHeight)};
+        stars.push_back(glm::vec2(x, y));
     }
     return stars;
 }
 
-void drawStars(const std::vector<glm::vec2>& stars) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> brightness(0.5f, 1.0f);
+void drawStars(const std::vector<glm::vec2>& stars, int step) {
+    const std::uint32_t stepKey{static_cast<std::uint32_t>(step)};
 
     glPointSize(2.0f);
     glBegin(GL_POINTS);
-    for (const auto& star : stars) {
-        float b = brightness(gen);
+    for (std::size_t i{0}; i < stars.size(); ++i) {
+        const float b{starBrightness(static_cast<std::uint32_t>(i), stepKey)};
         glColor3f(b, b, b);  // Grayscale brightness
-        glVertex2f(star.x, star.y);
+        glVertex2f(stars[i].x, stars[i].y);
     }
     glEnd();
 }
@@ -175,71 +555,95 @@ void drawDashedCircle(float x, float y, float radius, int segments) {
     }
 }
 
-void drawRays(const std::vector<Ray>& rays, int currentFrame) {
+// Set the head dot color for a scenario
+static void headColor(RayScenario scenario) {
+    if (scenario == RayScenario::POINT_SOURCE) {
+        glColor3f(0.5f, 1.0f, 0.0f);  // Lime green
+    } else if (scenario == RayScenario::ORBITING) {
+        glColor3f(1.0f, 0.2f, 1.0f);  // Magenta
+    } else {
+        glColor3f(1.0f, 1.0f, 0.0f);  // Yellow
+    }
+}
+
+// Emit one head vertex (inside glBegin(GL_POINTS)) for a ray that has not been captured
+static void drawHead(const Ray& ray, const TrailStore& trails) {
+    if (trails.size(ray.trailSlot) == 0 || ray.isCaptured()) {
+        return;
+    }
+
+    // Color-code dots by scenario
+    headColor(ray.scenario);
+    const glm::vec2 head{trails.back(ray.trailSlot)};
+    glVertex2f(head.x, head.y);
+}
+
+// Submit line strips as client-side arrays
+static void drawStrips(const TrailVertices& vertices) {
+    if (vertices.firsts.empty()) {
+        return;
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, vertices.positions.data());
+    glColorPointer(4, GL_FLOAT, 0, vertices.colors.data());
+    glMultiDrawArrays(GL_LINE_STRIP, vertices.firsts.data(), vertices.counts.data(),
+                      static_cast<GLsizei>(vertices.firsts.size()));
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+std::size_t drawRays(const std::vector<Ray>& rays, const TrailStore& trails, int currentFrame,
+                     const TrailIndex& index, const View& view) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glLineWidth(1.5f);
 
-    for (const auto& ray : rays) {
-        // Only draw rays that have been activated
-        if (!ray.isActive(currentFrame) || ray.trail.size() < 2) {
-            continue;
-        }
+    // Build once into reused arrays, then submit as client-side arrays
+    static TrailVertices vertices;
+    buildTrailVertices(rays, trails, currentFrame, index, view, vertices);
+    drawStrips(vertices);
 
-        float r, g, b;
-
-        // Different color schemes for different scenarios
-        if (ray.scenario == RayScenario::POINT_SOURCE) {
-            // Point source rays: Green to Yellow gradient
-            const float maxDeflection{static_cast<float>(M_PI)};
-            const float t{std::min(1.0f, static_cast<float>(ray.deflection) / maxDeflection)};
-            r = 0.5f + 0.5f * t;  // 0.5 to 1.0
-            g = 1.0f;             // Always green
-            b = 0.0f;
-        } else if (ray.scenario == RayScenario::ORBITING) {
-            // Orbiting ray: Bright magenta/purple
-            r = 1.0f;
-            g = 0.2f;
-            b = 1.0f;
-        } else {
-            // Parallel rays: Blue to red gradient (original)
-            const float maxDeflection{static_cast<float>(M_PI)};
-            const float t{std::min(1.0f, static_cast<float>(ray.deflection) / maxDeflection)};
-            r = t;
-            g = 0.5f * (1.0f - t);
-            b = 1.0f - t;
+    // Draw current ray positions as bright dots
+    glPointSize(3.0f);
+    glBegin(GL_POINTS);
+    for (const auto& ray : rays) {
+        if (ray.isActive(currentFrame)) {
+            drawHead(ray, trails);
         }
+    }
+    glEnd();
 
-        // Draw trail with fading
-        glBegin(GL_LINE_STRIP);
-        for (size_t i{0}; i < ray.trail.size(); ++i) {
-            const float alpha{0.2f + 0.8f * static_cast<float>(i) / static_cast<float>(ray.trail.size() - 1)};
+    glDisable(GL_BLEND);
+    return vertices.positions.size();
+}
 
-            glColor4f(r, g, b, alpha);
-            glVertex2f(ray.trail[i].x, ray.trail[i].y);
-        }
-        glEnd();
+void drawRayHeads(const std::vector<Ray>& rays, const TrailStore& trails,
+                  const std::vector<std::size_t>& ids) {
+    glPointSize(3.0f);
+    glBegin(GL_POINTS);
+    for (const std::size_t id : ids) {
+        drawHead(rays[id], trails);
     }
+    glEnd();
+}
+
+std::size_t drawReplay(const Recording::ReplayFrame& frame) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glLineWidth(1.5f);
+    drawStrips(frame.trails);
 
-    // Draw current ray positions as bright dots
     glPointSize(3.0f);
     glBegin(GL_POINTS);
-    for (const auto& ray : rays) {
-        if (ray.isActive(currentFrame) && !ray.trail.empty() && !ray.isCaptured()) {
-            // Color-code dots by scenario
-            if (ray.scenario == RayScenario::POINT_SOURCE) {
-                glColor3f(0.5f, 1.0f, 0.0f);  // Lime green
-            } else if (ray.scenario == RayScenario::ORBITING) {
-                glColor3f(1.0f, 0.2f, 1.0f);  // Magenta
-            } else {
-                glColor3f(1.0f, 1.0f, 0.0f);  // Yellow
-            }
-            glVertex2f(ray.trail.back().x, ray.trail.back().y);
-        }
+    for (std::size_t i{0}; i < frame.heads.size(); ++i) {
+        headColor(frame.headScenarios[i]);
+        glVertex2f(frame.heads[i].x, frame.heads[i].y);
     }
     glEnd();
 
     glDisable(GL_BLEND);
+    return frame.trails.positions.size();
 }
 
 void drawPointSource(float x, float y) {
@@ -3,31 +3,100 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
+#include "camera.h"
+#include "constants.h"
+#include "deflection_table.h"
+#include "frame_pipeline.h"
 #include "ray.h"
+#include "recording.h"
+#include "sim_clock.h"
+#include "simulation.h"
+#include "star_field.h"
+#include "trail_index.h"
+#include "trail_renderer.h"
 
 // Rendering namespace for all OpenGL drawing operations
 namespace Rendering {
     // RenderEngine handles all GLFW/OpenGL initialization and frame rendering
     struct RenderEngine {
         GLFWwindow* window;
-        std::vector<glm::vec2> stars;
-        std::vector<Ray>* rays;
-        int frame;
+        Simulation::Simulator* sim;
+        int starCount;                             // Stars over the window's view
+        bool retainedStars;                        // Draw stars from a GPU buffer when shaders allow
+        std::vector<glm::vec2> stars;              // Kept only for immediate-mode stars
+        std::unique_ptr<StarField> starField;      // Null when drawing stars in immediate mode
+        std::unique_ptr<Simulation::Pipeline> pipeline;  // Null when physics runs in lock-step
+        std::unique_ptr<TrailRenderer> trailRenderer;  // Null when using immediate mode
+        TrailIndex trailIndex;    // Culling grid over the drawn trails
+        std::size_t frozenIndexed; // Rays ever frozen whose trails are indexed for good
+        Camera camera;            // Mouse pan and zoom
+        glm::vec2 frameHalf;      // Base half extents of the current frame
+        View frameView;           // What the current frame shows, at its pixel size
+        bool dragging;            // Left button held: cursor motion pans
+        glm::dvec2 dragCursor;    // Cursor position at the last pan
+        int burstSize;            // Rays per right-click burst (0 = spawning off)
+        bool aiming;              // Right button held: a burst is being aimed
+        glm::dvec2 aimOrigin;     // Plane point the burst starts from
+        GLuint beamBuffer;        // Static ticks for a lookup-classified beam (0 if none)
+        GLsizei beamVertexCount;
+        Simulation::Clock clock;  // Simulation steps per displayed frame
+        double lastFrameTime;     // glfwGetTime() at the previous updatePhysics (< 0 before the first)
+
+        // Recording played back instead of the simulator (not owned; null when live)
+        const Recording::Replay* replay;
+        Recording::ReplayFrame replayScratch;
+        int replayStep;           // Step on screen
+        int replayTitleStep;      // Step shown in the window title
+        bool replayPaused;
 
         // Initialize GLFW, GLEW, and create window with rendering state
+        // retainedTrails: draw trails from GPU buffers (falls back to immediate mode)
+        // pipelined: step the simulator on its own thread, one frame ahead
+        // starCount: background stars, placed from the simulator's seed
+        // visible: false for a hidden window that only hosts the GL context
+        // retainedStars: draw stars from a GPU buffer (falls back to immediate mode)
         RenderEngine(int width, int height, const char* title,
-                     std::vector<Ray>& raysRef);
+                     Simulation::Simulator& simRef, bool retainedTrails = true,
+                     bool pipelined = false,
+                     const Simulation::ClockSettings& clockSettings = Simulation::ClockSettings{},
+                     int starCount = Visual::NUM_STARS, bool visible = true, bool retainedStars = true);
 
         // Cleanup
         ~RenderEngine();
 
-        // Setup projection and clear screen (call at start of each frame)
+        // Setup projection and clear screen (call at start of each frame).
+        // The camera shows part of the +-viewWidth, +-viewHeight frame;
+        // scrolling zooms about the cursor, dragging pans and R resets.
         void beginFrame(float viewWidth, float viewHeight);
 
-        // Update physics simulation for all rays
+        // Run the simulation steps the clock says are due since the last
+        // frame (pipelined: take that many published steps)
         void updatePhysics();
 
+        // The same for a frame that lasted elapsed seconds, whatever the wall
+        // clock says (offscreen capture). Returns the steps advanced.
+        int advance(double elapsed);
+
+        // Upload a classified beam once as colored ticks along its launch line
+        void setBeamField(const Physics::BeamField& field);
+
+        // Play a recording from startStep instead of stepping the simulator.
+        // Space pauses, Left/Right step one step, Down/Up jump 100 steps,
+        // Home/End seek to either end.
+        void setReplay(const Recording::Replay& recording, int startStep);
+
+        // Spawn burstSize rays at origin: a point source, or a fan of
+        // Visual::BURST_SPREAD toward aim when aim is a few pixels away.
+        // Right-click spawns at the cursor; right-drag aims.
+        void spawnBurst(glm::dvec2 origin, glm::dvec2 aim);
+
+        // Place the stars over a view of the given half extents instead of
+        // the window's, at the same density (offscreen capture at another
+        // aspect ratio)
+        void coverStars(float viewWidth, float viewHeight);
+
         // Draw entire scene (stars, black hole, rays, point source)
         void drawFrame();
 
@@ -36,13 +105,36 @@ namespace Rendering {
 
         // Check if window should close
         bool shouldClose() const;
+
+    private:
+        // Simulation step on screen (replayed, published or current)
+        int shownStep() const;
+
+        // Generate and upload count stars within the half extents
+        void buildStars(int count, float viewWidth, float viewHeight);
+
+        // Bring the trail index up to date with the trails about to be drawn
+        // (recycled is Simulator::recycled)
+        void indexTrails(const std::vector<Ray>& rays, const TrailStore& trails,
+                         const std::vector<std::size_t>& active, const std::vector<std::size_t>& frozen,
+                         std::size_t recycled);
+
+        // Plane point under a window position (screen coordinates)
+        glm::dvec2 planePoint(double x, double y) const;
+
+        static void onKey(GLFWwindow* window, int key, int scancode, int action, int mods);
+        static void onScroll(GLFWwindow* window, double dx, double dy);
+        static void onMouseButton(GLFWwindow* window, int button, int action, int mods);
+        static void onCursor(GLFWwindow* window, double x, double y);
     };
 
-    // Generate random background stars
-    std::vector<glm::vec2> generateStars(int count);
+    // Generate random background stars within +-halfWidth, +-halfHeight (the
+    // same seed gives the same sky with any standard library)
+    std::vector<glm::vec2> generateStars(int count, unsigned seed, float halfWidth = Visual::VIEW_WIDTH,
+                                         float halfHeight = Visual::VIEW_HEIGHT);
 
-    // Draw background stars
-    void drawStars(const std::vector<glm::vec2>& stars);
+    // Draw background stars in immediate mode, twinkling like StarField
+    void drawStars(const std::vector<glm::vec2>& stars, int step);
 
     // Draw filled circle (for event horizon)
     void drawCircle(float x, float y, float radius, int segments);
@@ -53,8 +145,20 @@ namespace Rendering {
     // Draw dashed circle (for photon sphere with visual distinction)
     void drawDashedCircle(float x, float y, float radius, int segments);
 
-    // Draw all active rays with color coding
-    void drawRays(const std::vector<Ray>& rays, int currentFrame);
+    // Draw all active rays with color coding (fixed-function path: trails
+    // built on the CPU by buildTrailVertices, culled and thinned for the
+    // view, and sent as client arrays)
+    // Returns the number of trail vertices drawn
+    std::size_t drawRays(const std::vector<Ray>& rays, const TrailStore& trails, int currentFrame,
+                         const TrailIndex& index, const View& view);
+
+    // Draw current positions of the given rays as bright dots
+    void drawRayHeads(const std::vector<Ray>& rays, const TrailStore& trails,
+                      const std::vector<std::size_t>& ids);
+
+    // Draw one replayed step's trails and heads
+    // Returns the number of trail vertices drawn
+    std::size_t drawReplay(const Recording::ReplayFrame& frame);
 
     // Draw point source marker
     void drawPointSource(float x, float y);
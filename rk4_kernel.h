@@ -0,0 +1,176 @@
+#pragma once
+
+// Lane-generic RK4 kernels for RayBatch (SI) and GeoBatch (geometrized).
+// Included by the scalar and SIMD translation units; each one instantiates
+// it with its own lane type V. The lane types live in an anonymous namespace
+// in their unit, which gives every instantiation internal linkage, so code
+// built with different instruction sets never gets merged by the linker.
+//
+// V must provide:
+//   WIDTH, Real, Mask, load, store, set, loadFrames, live, select,
+//   storeMask and operators + - * / on V.
+//
+// For the SI kernel, operation order mirrors Physics::geodesicRHS /
+// Physics::rk4Step so every lane produces the same result as the per-Ray
+// path. That fixes its five divisions per RHS evaluation (20 per step),
+// and the divider, not lane width, bounds its throughput.
+
+#include <cstddef>
+#include "constants.h"
+
+namespace Physics {
+    // Arguments for one batch kernel invocation over [0, count)
+    struct BatchKernelArgs {
+        double* r;
+        double* phi;
+        double* v_r;
+        double* v_phi;
+        const double* E;
+        const int* startFrame;
+        unsigned char* stepped;   // Out: 1 if the ray was advanced
+        std::size_t count;
+        double dlambda;
+        double maxDistance;
+        int currentFrame;
+    };
+
+    // Batch kernel entry point; returns the number of rays processed
+    // (a multiple of the kernel width; the caller finishes the tail)
+    using BatchKernel = std::size_t (*)(const BatchKernelArgs& args);
+
+    // Arguments for one geometrized kernel invocation over [0, count).
+    // Radii are in units of rs and dsigma in units of Units::AFFINE; the
+    // limits must be exactly representable in Real.
+    template <typename Real>
+    struct GeoKernelArgs {
+        Real* r;
+        Real* phi;
+        Real* v_r;
+        Real* v_phi;
+        const Real* E;
+        const int* startFrame;
+        unsigned char* stepped;   // Out: 1 if the ray was advanced
+        std::size_t count;
+        double dsigma;
+        double captureRadius;
+        double maxDistance;
+        int currentFrame;
+    };
+
+    template <typename Real>
+    using GeoKernel = std::size_t (*)(const GeoKernelArgs<Real>& args);
+
+namespace Kernel {
+
+template <typename V>
+inline void geodesicRHS(V r, V v_r, V v_phi, V E, V rhs[4]) {
+    const V rs{V::set(BlackHole::rs)};
+    const V one{V::set(1.0)};
+    const V two{V::set(2.0)};
+
+    const V f{one - rs / r};
+
+    rhs[0] = v_r;
+    rhs[1] = v_phi;
+
+    const V dt_dlambda{E / f};
+    rhs[2] = -(rs / (two * r * r)) * f * (dt_dlambda * dt_dlambda)
+             + (rs / (two * r * r * f)) * (v_r * v_r)
+             + (r - rs) * (v_phi * v_phi);
+
+    rhs[3] = V::set(-2.0) * v_r * v_phi / r;
+}
+
+// Same equations with rs = 1 and c = 1, over a shared 1 / (r (r - 1)):
+//   r'' = (v_r² - E²) / (2 r (r - 1)) + (r - 1) v_φ²
+//   φ'' = -2 v_r v_φ (r - 1) / (r (r - 1))
+// One division instead of four, which matters most in single precision.
+template <typename V>
+inline void geodesicRHSGeo(V r, V v_r, V v_phi, V E, V rhs[4]) {
+    const V rm1{r - V::set(1.0)};
+    const V inv{V::set(1.0) / (r * rm1)};
+
+    rhs[0] = v_r;
+    rhs[1] = v_phi;
+    rhs[2] = V::set(0.5) * (v_r * v_r - E * E) * inv + rm1 * (v_phi * v_phi);
+    rhs[3] = V::set(-2.0) * v_r * v_phi * rm1 * inv;
+}
+
+template <typename V, void (*RHS)(V, V, V, V, V*)>
+inline void rk4(V y[4], V E, double dlambda) {
+    const V h{V::set(dlambda)};
+    const V half{V::set(dlambda / 2.0)};
+    const V sixth{V::set(dlambda / 6.0)};
+    const V two{V::set(2.0)};
+    V k1[4], k2[4], k3[4], k4[4], t[4];
+
+    RHS(y[0], y[2], y[3], E, k1);
+
+    for (int i{0}; i < 4; ++i) {
+        t[i] = y[i] + k1[i] * half;
+    }
+    RHS(t[0], t[2], t[3], E, k2);
+
+    for (int i{0}; i < 4; ++i) {
+        t[i] = y[i] + k2[i] * half;
+    }
+    RHS(t[0], t[2], t[3], E, k3);
+
+    for (int i{0}; i < 4; ++i) {
+        t[i] = y[i] + k3[i] * h;
+    }
+    RHS(t[0], t[2], t[3], E, k4);
+
+    for (int i{0}; i < 4; ++i) {
+        y[i] = y[i] + sixth * (k1[i] + two * k2[i] + two * k3[i] + k4[i]);
+    }
+}
+
+template <typename V>
+std::size_t rk4Batch(const BatchKernelArgs& a) {
+    const V frame{V::set(static_cast<double>(a.currentFrame))};
+    const V captureRadius{V::set(BlackHole::rs * 1.01)};
+    const V maxDistance{V::set(a.maxDistance)};
+
+    std::size_t i{0};
+    for (; i + V::WIDTH <= a.count; i += V::WIDTH) {
+        V y[4]{V::load(a.r + i), V::load(a.phi + i), V::load(a.v_r + i), V::load(a.v_phi + i)};
+        const typename V::Mask live{V::live(y[0], V::loadFrames(a.startFrame + i), frame,
+                                            captureRadius, maxDistance)};
+        V next[4]{y[0], y[1], y[2], y[3]};
+        rk4<V, geodesicRHS<V>>(next, V::load(a.E + i), a.dlambda);
+
+        V::store(a.r + i, V::select(live, next[0], y[0]));
+        V::store(a.phi + i, V::select(live, next[1], y[1]));
+        V::store(a.v_r + i, V::select(live, next[2], y[2]));
+        V::store(a.v_phi + i, V::select(live, next[3], y[3]));
+        V::storeMask(a.stepped + i, live);
+    }
+    return i;
+}
+
+template <typename V>
+std::size_t rk4GeoBatch(const GeoKernelArgs<typename V::Real>& a) {
+    const V frame{V::set(static_cast<double>(a.currentFrame))};
+    const V captureRadius{V::set(a.captureRadius)};
+    const V maxDistance{V::set(a.maxDistance)};
+
+    std::size_t i{0};
+    for (; i + V::WIDTH <= a.count; i += V::WIDTH) {
+        V y[4]{V::load(a.r + i), V::load(a.phi + i), V::load(a.v_r + i), V::load(a.v_phi + i)};
+        const typename V::Mask live{V::live(y[0], V::loadFrames(a.startFrame + i), frame,
+                                            captureRadius, maxDistance)};
+        V next[4]{y[0], y[1], y[2], y[3]};
+        rk4<V, geodesicRHSGeo<V>>(next, V::load(a.E + i), a.dsigma);
+
+        V::store(a.r + i, V::select(live, next[0], y[0]));
+        V::store(a.phi + i, V::select(live, next[1], y[1]));
+        V::store(a.v_r + i, V::select(live, next[2], y[2]));
+        V::store(a.v_phi + i, V::select(live, next[3], y[3]));
+        V::storeMask(a.stepped + i, live);
+    }
+    return i;
+}
+
+} // namespace Kernel
+} // namespace Physics
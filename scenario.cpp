@@ -0,0 +1,304 @@
+#include "scenario.h"
+#include "constants.h"
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace Scenario {
+
+namespace {
+
+constexpr double DEGREES{M_PI / 180.0};
+
+bool parseNumber(const std::string& text, double& value) {
+    char* end{nullptr};
+    value = std::strtod(text.c_str(), &end);
+    return end != text.c_str() && *end == '\0';
+}
+
+// Number with an optional "rs" suffix (Schwarzschild radii)
+bool parseLength(const std::string& text, double& value) {
+    char* end{nullptr};
+    value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str()) {
+        return false;
+    }
+    const std::string suffix{end};
+    if (suffix == "rs") {
+        value *= BlackHole::rs;
+        return true;
+    }
+    return suffix.empty();
+}
+
+bool parseInt(const std::string& text, int& value) {
+    char* end{nullptr};
+    const long parsed{std::strtol(text.c_str(), &end, 10)};
+    if (end == text.c_str() || *end != '\0' || parsed < 0 || parsed > 1000000000L) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parseKind(const std::string& text, EmitterKind& kind) {
+    if (text == "ray") {
+        kind = EmitterKind::RAY;
+    } else if (text == "parallel") {
+        kind = EmitterKind::PARALLEL;
+    } else if (text == "point") {
+        kind = EmitterKind::POINT;
+    } else if (text == "cone") {
+        kind = EmitterKind::CONE;
+    } else if (text == "grid") {
+        kind = EmitterKind::GRID;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseColor(const std::string& text, RayScenario& color) {
+    if (text == "parallel") {
+        color = RayScenario::PARALLEL;
+    } else if (text == "point") {
+        color = RayScenario::POINT_SOURCE;
+    } else if (text == "orbiting") {
+        color = RayScenario::ORBITING;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Apply one key=value pair; false if the key is unknown or the value bad
+bool applyKey(Emitter& e, const std::string& key, const std::string& value) {
+    double angle{0.0};
+    if (key == "x") return parseLength(value, e.x);
+    if (key == "y") return parseLength(value, e.y);
+    if (key == "width") return parseLength(value, e.width);
+    if (key == "height") return parseLength(value, e.height);
+    if (key == "count") return parseInt(value, e.count);
+    if (key == "nx") return parseInt(value, e.nx);
+    if (key == "ny") return parseInt(value, e.ny);
+    if (key == "start") return parseNumber(value, e.startTime) && e.startTime >= 0.0 && std::isfinite(e.startTime);
+    if (key == "color") return parseColor(value, e.color);
+    if (key == "aimx") {
+        e.aimed = true;
+        return parseLength(value, e.aimX);
+    }
+    if (key == "aimy") {
+        e.aimed = true;
+        return parseLength(value, e.aimY);
+    }
+    if (key == "angle" || key == "spread") {
+        if (!parseNumber(value, angle)) {
+            return false;
+        }
+        (key == "angle" ? e.angle : e.spread) = angle * DEGREES;
+        return true;
+    }
+    return false;
+}
+
+// Parameter along a row of n evenly spaced rays (centered when alone)
+double spacing(int i, int n) {
+    return n > 1 ? static_cast<double>(i) / static_cast<double>(n - 1) : 0.5;
+}
+
+// First step index whose time is at or after the emitter's start; the
+// slack keeps times that are whole multiples of the step exact. A start
+// past the last int step is clamped there, so its rays never start.
+int startStep(const Emitter& e, double stepSize) {
+    const double step{std::ceil(e.startTime / stepSize - 1e-9)};
+    const int last{std::numeric_limits<int>::max()};
+    if (!(step <= static_cast<double>(last))) {
+        std::cerr << "Warning: start time " << e.startTime << " is past step " << last << " at --step "
+                  << stepSize << "; its rays never start\n";
+        return last;
+    }
+    return static_cast<int>(step);
+}
+
+double direction(const Emitter& e) {
+    return e.aimed ? std::atan2(e.aimY - e.y, e.aimX - e.x) : e.angle;
+}
+
+} // namespace
+
+Emitter::Emitter(EmitterKind emitterKind)
+    : kind{emitterKind},
+      color{RayScenario::PARALLEL},
+      startTime{0.0},
+      count{1},
+      nx{1},
+      ny{1},
+      x{0.0},
+      y{0.0},
+      width{0.0},
+      height{0.0},
+      angle{0.0},
+      spread{0.0},
+      aimed{false},
+      aimX{0.0},
+      aimY{0.0} {
+    if (kind == EmitterKind::RAY) {
+        color = RayScenario::ORBITING;
+    } else if (kind == EmitterKind::POINT || kind == EmitterKind::CONE) {
+        color = RayScenario::POINT_SOURCE;
+    }
+}
+
+std::size_t Emitter::rayCount() const {
+    switch (kind) {
+        case EmitterKind::RAY: return 1;
+        case EmitterKind::GRID: return static_cast<std::size_t>(nx) * static_cast<std::size_t>(ny);
+        default: return static_cast<std::size_t>(count);
+    }
+}
+
+std::vector<Emitter> builtin(const std::string& name) {
+    std::vector<Emitter> emitters;
+
+    if (name == "all" || name == "orbiting") {
+        Emitter orbiting{EmitterKind::RAY};
+        orbiting.x = -0.9 * Visual::VIEW_WIDTH;
+        orbiting.y = 2.577934 * BlackHole::rs;
+        orbiting.startTime = Visual::ORBITING_START;
+        emitters.push_back(orbiting);
+    }
+    if (name == "all" || name == "point") {
+        // Fan aimed at the black hole
+        Emitter cone{EmitterKind::CONE};
+        cone.x = Visual::POINT_SOURCE_X;
+        cone.y = Visual::POINT_SOURCE_Y;
+        cone.count = 25;
+        cone.spread = M_PI / 3.0;
+        cone.aimed = true;
+        cone.startTime = Visual::POINT_SOURCE_START;
+        emitters.push_back(cone);
+    }
+    if (name == "all" || name == "parallel") {
+        Emitter beam{EmitterKind::PARALLEL};
+        beam.x = Visual::PARALLEL_START_X;
+        beam.height = Visual::VIEW_HEIGHT;
+        beam.count = 70;
+        beam.startTime = Visual::PARALLEL_START;
+        emitters.push_back(beam);
+    }
+    return emitters;
+}
+
+bool load(const std::string& path, std::vector<Emitter>& emitters) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to open scenario file " << path << "\n";
+        return false;
+    }
+
+    std::string line;
+    int lineNumber{0};
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        const std::size_t comment{line.find('#')};
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        std::istringstream tokens(line);
+        std::string word;
+        if (!(tokens >> word)) {
+            continue;
+        }
+
+        EmitterKind kind;
+        if (!parseKind(word, kind)) {
+            std::cerr << path << ":" << lineNumber << ": unknown emitter '" << word << "'\n";
+            return false;
+        }
+
+        Emitter emitter{kind};
+        while (tokens >> word) {
+            const std::size_t equals{word.find('=')};
+            if (equals == std::string::npos ||
+                !applyKey(emitter, word.substr(0, equals), word.substr(equals + 1))) {
+                std::cerr << path << ":" << lineNumber << ": bad parameter '" << word << "'\n";
+                return false;
+            }
+        }
+
+        if (emitter.rayCount() == 0) {
+            std::cerr << path << ":" << lineNumber << ": emitter has no rays\n";
+            return false;
+        }
+        emitters.push_back(emitter);
+    }
+    return true;
+}
+
+std::vector<Ray> generate(const std::vector<Emitter>& emitters, double stepSize) {
+    // One allocation for the whole scene
+    std::size_t total{0};
+    for (const auto& e : emitters) {
+        total += e.rayCount();
+    }
+    std::vector<Ray> rays;
+    rays.reserve(total);
+
+    for (const auto& e : emitters) {
+        const double c{Physics::c};
+        const int start{startStep(e, stepSize)};
+        switch (e.kind) {
+            case EmitterKind::RAY: {
+                const double a{direction(e)};
+                rays.emplace_back(e.x, e.y, c * std::cos(a), c * std::sin(a), e.color, start);
+                break;
+            }
+            case EmitterKind::PARALLEL: {
+                const double vx{c * std::cos(e.angle)};
+                const double vy{c * std::sin(e.angle)};
+                for (int i{0}; i < e.count; ++i) {
+                    const double startY{e.y - e.height + spacing(i, e.count) * 2.0 * e.height};
+                    rays.emplace_back(e.x, startY, vx, vy, e.color, start);
+                }
+                break;
+            }
+            case EmitterKind::POINT: {
+                for (int i{0}; i < e.count; ++i) {
+                    const double a{e.angle + 2.0 * M_PI * static_cast<double>(i) / static_cast<double>(e.count)};
+                    rays.emplace_back(e.x, e.y, c * std::cos(a), c * std::sin(a), e.color, start);
+                }
+                break;
+            }
+            case EmitterKind::CONE: {
+                const double baseAngle{direction(e)};
+                for (int i{0}; i < e.count; ++i) {
+                    const double angleOffset{e.count > 1
+                        ? -e.spread / 2.0 + e.spread * static_cast<double>(i) / static_cast<double>(e.count - 1)
+                        : 0.0};
+                    const double a{baseAngle + angleOffset};
+                    rays.emplace_back(e.x, e.y, c * std::cos(a), c * std::sin(a), e.color, start);
+                }
+                break;
+            }
+            case EmitterKind::GRID: {
+                const double vx{c * std::cos(e.angle)};
+                const double vy{c * std::sin(e.angle)};
+                for (int j{0}; j < e.ny; ++j) {
+                    const double gy{e.y - e.height + spacing(j, e.ny) * 2.0 * e.height};
+                    for (int i{0}; i < e.nx; ++i) {
+                        const double gx{e.x - e.width + spacing(i, e.nx) * 2.0 * e.width};
+                        rays.emplace_back(gx, gy, vx, vy, e.color, start);
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return rays;
+}
+
+} // namespace Scenario
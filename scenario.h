@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "constants.h"
+#include "ray.h"
+
+// Ray scenarios as data: a list of emitters, each expanding to a family of
+// rays. The built-in scenes and scenario files produce the same emitters.
+//
+// Scenario file format: one emitter per line, "kind key=value ...", with
+// '#' comments. Lengths are meters, or Schwarzschild radii with an "rs"
+// suffix; angles are degrees.
+//   ray      x y angle|aimx,aimy               one explicit ray
+//   parallel x y height count angle            beam along a vertical line, y +- height
+//   point    x y count                         isotropic emitter
+//   cone     x y count spread angle|aimx,aimy  fan of rays around a direction
+//   grid     x y width height nx ny angle      nx*ny rays over a rectangle
+// Every kind also takes start (simulation time, affine parameter units) and
+// color (parallel, point, orbiting).
+namespace Scenario {
+    enum class EmitterKind {
+        RAY,
+        PARALLEL,
+        POINT,
+        CONE,
+        GRID
+    };
+
+    struct Emitter {
+        EmitterKind kind;
+        RayScenario color;   // Color scheme (and scenario name in outputs)
+        double startTime;    // Simulation time the rays start at
+        int count;           // Rays for parallel, point and cone
+        int nx;              // Grid columns and rows
+        int ny;
+        double x;            // Origin, beam line or grid center
+        double y;
+        double width;        // Grid half-width
+        double height;       // Beam or grid half-height
+        double angle;        // Direction (radians)
+        double spread;       // Cone opening (radians)
+        bool aimed;          // Direction points at (aimX, aimY) instead of angle
+        double aimX;
+        double aimY;
+
+        Emitter(EmitterKind kind = EmitterKind::RAY);
+
+        // Rays this emitter expands to
+        std::size_t rayCount() const;
+    };
+
+    // Built-in scenes: all, orbiting, point, parallel
+    std::vector<Emitter> builtin(const std::string& name);
+
+    // Parse a scenario file (reports errors with line numbers)
+    bool load(const std::string& path, std::vector<Emitter>& emitters);
+
+    // Expand emitters into rays, reserving the full count up front. Start
+    // times become the first simulation step at or after them, for a
+    // simulator advancing stepSize per step.
+    std::vector<Ray> generate(const std::vector<Emitter>& emitters,
+                              double stepSize = Simulation::INTEGRATION_STEP);
+}
@@ -0,0 +1,56 @@
+#include "shader.h"
+#include <iostream>
+
+namespace Rendering {
+
+namespace {
+
+GLuint compileShader(const char* label, GLenum type, const char* source) {
+    const GLuint shader{glCreateShader(type)};
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint ok{GL_FALSE};
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << label << " shader compile failed: " << log << "\n";
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+} // namespace
+
+GLuint linkProgram(const char* label, const char* vertexSource, const char* fragmentSource) {
+    const GLuint vertex{compileShader(label, GL_VERTEX_SHADER, vertexSource)};
+    const GLuint fragment{compileShader(label, GL_FRAGMENT_SHADER, fragmentSource)};
+    if (vertex == 0 || fragment == 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return 0;
+    }
+
+    const GLuint program{glCreateProgram()};
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glBindAttribLocation(program, 0, "position");
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint ok{GL_FALSE};
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << label << " shader link failed: " << log << "\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+} // namespace Rendering
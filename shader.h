@@ -0,0 +1,10 @@
+#pragma once
+
+#include <GL/glew.h>
+
+namespace Rendering {
+    // Compile and link a vertex/fragment program with attribute 0 bound to
+    // "position". Returns 0 (after printing the log, prefixed with label)
+    // if either stage fails.
+    GLuint linkProgram(const char* label, const char* vertexSource, const char* fragmentSource);
+}
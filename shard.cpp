@@ -0,0 +1,393 @@
+#include "shard.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+namespace Sharding {
+
+namespace {
+
+// A spawned shard process
+struct Child {
+#ifdef _WIN32
+    HANDLE process{nullptr};
+#else
+    pid_t pid{-1};
+#endif
+};
+
+#ifdef _WIN32
+// Quote one argument for CreateProcess's command line parsing
+std::string quote(const std::string& arg) {
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+        return arg;
+    }
+    std::string quoted{"\""};
+    std::size_t backslashes{0};
+    for (const char c : arg) {
+        if (c == '\\') {
+            ++backslashes;
+            continue;
+        }
+        // Backslashes are literal unless they precede a quote
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(backslashes * 2, '\\');
+    return quoted + "\"";
+}
+#endif
+
+// Start args[0] with args, its stdout and stderr sent to logPath
+bool spawn(const std::vector<std::string>& args, const std::string& logPath, Child& child) {
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES inherit{sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+    HANDLE log{CreateFileA(logPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inherit, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, nullptr)};
+    if (log == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    std::string commandLine;
+    for (const std::string& arg : args) {
+        commandLine += (commandLine.empty() ? "" : " ") + quote(arg);
+    }
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startup.hStdOutput = log;
+    startup.hStdError = log;
+    PROCESS_INFORMATION info{};
+    const BOOL started{CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr,
+                                      &startup, &info)};
+    CloseHandle(log);
+    if (!started) {
+        return false;
+    }
+    CloseHandle(info.hThread);
+    child.process = info.hProcess;
+    return true;
+#else
+    std::vector<char*> argv;
+    for (const std::string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    posix_spawn_file_actions_adddup2(&actions, 1, 2);
+    const int error{posix_spawnp(&child.pid, argv[0], &actions, nullptr, argv.data(), environ)};
+    posix_spawn_file_actions_destroy(&actions);
+    return error == 0;
+#endif
+}
+
+// Wait for a child and return its exit code (-1 if it did not exit normally)
+int join(Child& child) {
+#ifdef _WIN32
+    WaitForSingleObject(child.process, INFINITE);
+    DWORD code{0};
+    const bool ok{GetExitCodeProcess(child.process, &code) != 0};
+    CloseHandle(child.process);
+    return ok ? static_cast<int>(code) : -1;
+#else
+    int status{0};
+    if (waitpid(child.pid, &status, 0) < 0 || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+#endif
+}
+
+// Ray index at the start of a CSV row
+std::size_t rowId(const std::string& line) {
+    return static_cast<std::size_t>(std::strtoull(line.c_str(), nullptr, 10));
+}
+
+// Open every shard's copy of a file and check their headers agree; the
+// header goes to out
+bool openShards(const std::string& output, int count, const std::string& suffix,
+                std::vector<std::ifstream>& inputs, std::ofstream& out, const std::string& outPath) {
+    inputs.resize(static_cast<std::size_t>(count));
+    std::string header;
+    for (int i{0}; i < count; ++i) {
+        const std::string path{Shard{i, count}.path(output) + suffix};
+        std::ifstream& in{inputs[static_cast<std::size_t>(i)]};
+        in.open(path);
+        std::string line;
+        if (!in || !std::getline(in, line)) {
+            std::cerr << "Failed to read shard file " << path << "\n";
+            return false;
+        }
+        if (i == 0) {
+            header = line;
+        } else if (line != header) {
+            std::cerr << "Shard file " << path << " has a different layout\n";
+            return false;
+        }
+    }
+    out.open(outPath);
+    if (!out) {
+        std::cerr << "Failed to open " << outPath << " for writing\n";
+        return false;
+    }
+    out << header << '\n';
+    return true;
+}
+
+// Interleave the shards' results rows back into ray order
+// Returns the number of rays merged, or -1 on a mismatch
+long long mergeResults(const std::string& output, int count) {
+    std::vector<std::ifstream> inputs;
+    std::ofstream out;
+    if (!openShards(output, count, "", inputs, out, output)) {
+        return -1;
+    }
+
+    std::string line;
+    std::size_t ray{0};
+    while (std::getline(inputs[ray % inputs.size()], line)) {
+        if (rowId(line) != ray) {
+            std::cerr << "Shard results are out of order at ray " << ray << "\n";
+            return -1;
+        }
+        out << line << '\n';
+        ++ray;
+    }
+
+    // Shards hold every count-th ray, so all run out at the same point
+    for (std::ifstream& in : inputs) {
+        if (std::getline(in, line)) {
+            std::cerr << "Shard results do not belong to one ray set\n";
+            return -1;
+        }
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << output << "\n";
+        return -1;
+    }
+    return static_cast<long long>(ray);
+}
+
+// Interleave the shards' trail rows, each ray's points kept together
+bool mergeTrails(const std::string& output, int count, std::size_t rays) {
+    const std::string path{output + ".trails.csv"};
+    std::vector<std::ifstream> inputs;
+    std::ofstream out;
+    if (!openShards(output, count, ".trails.csv", inputs, out, path)) {
+        return false;
+    }
+
+    // Next unread row of each shard
+    std::vector<std::string> next(inputs.size());
+    std::vector<unsigned char> more(inputs.size());
+    for (std::size_t i{0}; i < inputs.size(); ++i) {
+        more[i] = static_cast<bool>(std::getline(inputs[i], next[i]));
+    }
+
+    for (std::size_t ray{0}; ray < rays; ++ray) {
+        const std::size_t s{ray % inputs.size()};
+        while (more[s] && rowId(next[s]) == ray) {
+            out << next[s] << '\n';
+            more[s] = static_cast<bool>(std::getline(inputs[s], next[s]));
+        }
+    }
+    for (const unsigned char left : more) {
+        if (left) {
+            std::cerr << "Shard trails do not match the merged results\n";
+            return false;
+        }
+    }
+    if (!out) {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Shard::Shard(int shardIndex, int shardCount) : index{shardIndex}, count{shardCount} {
+}
+
+std::vector<Ray> Shard::select(std::vector<Ray> rays) const {
+    if (!sharded()) {
+        return rays;
+    }
+    std::vector<Ray> kept;
+    kept.reserve(rays.size() / static_cast<std::size_t>(count) + 1);
+    for (std::size_t i{static_cast<std::size_t>(index)}; i < rays.size(); i += static_cast<std::size_t>(count)) {
+        kept.push_back(rays[i]);
+    }
+    return kept;
+}
+
+std::string Shard::path(const std::string& output) const {
+    if (!sharded()) {
+        return output;
+    }
+    return output + ".shard-" + std::to_string(index) + "-of-" + std::to_string(count);
+}
+
+Stats::Stats()
+    : rays{0}, framesRun{0}, lastFrame{0}, totalSteps{0}, rhsEvaluations{0}, trailBytes{0},
+      elapsed{0.0}, trails{false} {
+}
+
+bool Stats::write(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+    out.precision(17);
+    out << "rays " << rays << "\n"
+        << "frames_run " << framesRun << "\n"
+        << "last_frame " << lastFrame << "\n"
+        << "ray_steps " << totalSteps << "\n"
+        << "rhs_evaluations " << rhsEvaluations << "\n"
+        << "trail_bytes " << trailBytes << "\n"
+        << "elapsed " << elapsed << "\n"
+        << "trails " << (trails ? 1 : 0) << "\n";
+    return static_cast<bool>(out);
+}
+
+bool Stats::read(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Failed to read shard statistics " << path << "\n";
+        return false;
+    }
+    std::string key;
+    while (in >> key) {
+        if (key == "rays") {
+            in >> rays;
+        } else if (key == "frames_run") {
+            in >> framesRun;
+        } else if (key == "last_frame") {
+            in >> lastFrame;
+        } else if (key == "ray_steps") {
+            in >> totalSteps;
+        } else if (key == "rhs_evaluations") {
+            in >> rhsEvaluations;
+        } else if (key == "trail_bytes") {
+            in >> trailBytes;
+        } else if (key == "elapsed") {
+            in >> elapsed;
+        } else if (key == "trails") {
+            int value{0};
+            in >> value;
+            trails = value != 0;
+        } else {
+            std::cerr << "Unknown entry '" << key << "' in " << path << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int merge(const std::string& output, int count) {
+    std::cout << "Merging " << count << " shards into " << output << "\n";
+
+    Stats total;
+    bool trails{true};
+    for (int i{0}; i < count; ++i) {
+        Stats stats;
+        if (!stats.read(Shard{i, count}.path(output) + ".stats")) {
+            return -1;
+        }
+        total.rays += stats.rays;
+        total.framesRun = std::max(total.framesRun, stats.framesRun);
+        total.lastFrame = std::max(total.lastFrame, stats.lastFrame);
+        total.totalSteps += stats.totalSteps;
+        total.rhsEvaluations += stats.rhsEvaluations;
+        total.trailBytes += stats.trailBytes;
+        total.elapsed = std::max(total.elapsed, stats.elapsed);
+        trails = trails && stats.trails;
+    }
+
+    const long long rays{mergeResults(output, count)};
+    if (rays < 0) {
+        return -1;
+    }
+    if (rays != total.rays) {
+        std::cerr << "Shard statistics count " << total.rays << " rays but results hold " << rays << "\n";
+        return -1;
+    }
+    std::cout << "Results written to " << output << "\n";
+    if (trails) {
+        if (!mergeTrails(output, count, static_cast<std::size_t>(rays))) {
+            return -1;
+        }
+        std::cout << "Trails written to " << output << ".trails.csv\n";
+    }
+
+    std::cout << "Shards:     " << count << "\n"
+              << "Frames:     " << total.framesRun << " (last step " << total.lastFrame << ")\n"
+              << "Rays:       " << total.rays << "\n"
+              << "Ray steps:  " << total.totalSteps << "\n"
+              << "RHS evals:  " << total.rhsEvaluations << "\n"
+              << "Trail mem:  " << total.trailBytes / 1024 << " KiB across shards\n"
+              << "Elapsed:    " << total.elapsed << " s (slowest shard)\n";
+    return 0;
+}
+
+int runLocal(int argc, char** argv, const std::string& output, int count) {
+    // Same arguments minus the fan-out itself
+    std::vector<std::string> args{argv[0]};
+    for (int i{1}; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--shards") == 0) {
+            ++i;
+            continue;
+        }
+        args.push_back(argv[i]);
+    }
+
+    std::cout << "Running " << count << " shards as local processes\n";
+    std::vector<Child> children(static_cast<std::size_t>(count));
+    int failed{0};
+    int started{0};
+    for (int i{0}; i < count; ++i) {
+        const Shard shard{i, count};
+        std::vector<std::string> shardArgs{args};
+        shardArgs.push_back("--shard");
+        shardArgs.push_back(std::to_string(i) + "/" + std::to_string(count));
+        if (!spawn(shardArgs, shard.path(output) + ".log", children[static_cast<std::size_t>(i)])) {
+            std::cerr << "Failed to start shard " << i << "\n";
+            ++failed;
+            break;
+        }
+        ++started;
+    }
+
+    for (int i{0}; i < started; ++i) {
+        const int code{join(children[static_cast<std::size_t>(i)])};
+        if (code != 0) {
+            std::cerr << "Shard " << i << " failed (exit code " << code << "), see "
+                      << Shard{i, count}.path(output) << ".log\n";
+            ++failed;
+        }
+    }
+    if (failed > 0) {
+        return -1;
+    }
+    return merge(output, count);
+}
+
+} // namespace Sharding
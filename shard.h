@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "ray.h"
+
+// Sharded batch runs: the generated ray set is split across independent
+// processes, each writing its own results, and merged afterwards. Rays never
+// interact, so a merged run is identical to a single-process one.
+namespace Sharding {
+    // Rays index, index + count, index + 2 * count, ... of the generated set.
+    // Striding keeps each shard's mix of scenarios and start times, and so
+    // its run time, close to the others'.
+    struct Shard {
+        int index;
+        int count;
+
+        Shard(int index = 0, int count = 1);
+
+        bool sharded() const { return count > 1; }
+
+        // Position in the full ray set of this shard's local ray
+        std::size_t globalId(std::size_t local) const {
+            return local * static_cast<std::size_t>(count) + static_cast<std::size_t>(index);
+        }
+
+        // Keep only this shard's rays, in order
+        std::vector<Ray> select(std::vector<Ray> rays) const;
+
+        // OUTPUT.shard-i-of-N: where this shard writes results for OUTPUT
+        std::string path(const std::string& output) const;
+    };
+
+    // Per-shard run statistics, written next to the shard's results
+    struct Stats {
+        long long rays;
+        long long framesRun;
+        long long lastFrame;
+        long long totalSteps;
+        long long rhsEvaluations;
+        long long trailBytes;
+        double elapsed;
+        bool trails;          // Shard also wrote its trails
+
+        Stats();
+
+        bool write(const std::string& path) const;
+        bool read(const std::string& path);
+    };
+
+    // Combine the count shards of OUTPUT into OUTPUT (and OUTPUT.trails.csv
+    // when the shards wrote trails), byte-identical to a single-process run,
+    // and print the summed statistics. Returns a process exit code.
+    int merge(const std::string& output, int count);
+
+    // Run count shards as local child processes of this executable with
+    // the same arguments, wait for all of them, then merge. Each child's
+    // console output goes to its shard's .log file. Returns a process exit
+    // code.
+    int runLocal(int argc, char** argv, const std::string& output, int count);
+}
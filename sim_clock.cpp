@@ -0,0 +1,43 @@
+#include "sim_clock.h"
+#include "constants.h"
+#include <cmath>
+
+namespace Simulation {
+
+ClockSettings::ClockSettings()
+    : stepsPerSecond{STEPS_PER_SECOND},
+      speed{1.0},
+      maxThroughput{false},
+      frameBudget{FRAME_BUDGET},
+      maxSubsteps{MAX_SUBSTEPS} {
+}
+
+Clock::Clock(const ClockSettings& clockSettings)
+    : settings{clockSettings}, accumulator{0.0}, droppedSteps{0} {
+}
+
+int Clock::stepsDue(double elapsed) {
+    const double period{1.0 / (settings.stepsPerSecond * settings.speed)};
+    accumulator += elapsed;
+    const double due{std::floor(accumulator / period)};
+    accumulator -= due * period;
+
+    // A long stall (window drag, breakpoint) must not trigger a burst of
+    // catch-up steps that makes the next frame slow too
+    if (due > settings.maxSubsteps) {
+        droppedSteps += static_cast<long long>(due) - settings.maxSubsteps;
+        return settings.maxSubsteps;
+    }
+    return static_cast<int>(due);
+}
+
+bool Clock::fitsBudget(int steps, double spent) const {
+    if (steps == 0) {
+        return true;
+    }
+    // Assume the next step costs the frame's average so far
+    const double perStep{spent / static_cast<double>(steps)};
+    return spent + perStep <= settings.frameBudget;
+}
+
+} // namespace Simulation
@@ -0,0 +1,35 @@
+#pragma once
+
+// Fixed-timestep simulation clock.
+// The simulator always advances in fixed steps of affine parameter; the
+// clock decides how many of those steps each displayed frame runs, so the
+// simulation rate no longer depends on the display's refresh rate.
+namespace Simulation {
+    struct ClockSettings {
+        double stepsPerSecond;  // Simulation steps per wall-clock second at 1x
+        double speed;           // Time-warp factor (> 1 fast-forwards)
+        bool maxThroughput;     // Ignore the rate: step for frameBudget every frame
+        double frameBudget;     // Seconds of stepping per frame in maxThroughput mode
+        int maxSubsteps;        // Most steps a fixed-rate frame may run; time beyond is dropped
+
+        ClockSettings();
+    };
+
+    // Accumulates wall time and converts it into whole simulation steps
+    struct Clock {
+        ClockSettings settings;
+        double accumulator;       // Wall time not yet simulated (seconds)
+        long long droppedSteps;   // Steps skipped because a frame hit maxSubsteps
+
+        explicit Clock(const ClockSettings& settings = ClockSettings{});
+
+        // Fixed-rate mode: steps to run for a frame that took elapsed seconds.
+        // Leftover time carries over to the next frame.
+        int stepsDue(double elapsed);
+
+        // Max-throughput mode: whether one more step is expected to fit the
+        // frame budget, given steps already run this frame and the seconds
+        // they took. The first step of a frame always runs.
+        bool fitsBudget(int steps, double spent) const;
+    };
+}
@@ -0,0 +1,317 @@
+#include "simulation.h"
+#include "checkpoint.h"
+#include "constants.h"
+#include "metric.h"
+#include "physics.h"
+#include "profiler.h"
+#include "recording.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <utility>
+
+namespace Simulation {
+
+Settings::Settings()
+    : backend{Backend::RAY},
+      stepSize{INTEGRATION_STEP},
+      threads{1},
+      adaptive{ADAPTIVE_RTOL, ADAPTIVE_MIN_STEP, ADAPTIVE_MAX_STEP},
+      seed{0},
+      precision{Precision::DOUBLE} {
+}
+
+Simulator::Simulator(std::vector<Ray> initialRays, const Settings& settings)
+    : rays{std::move(initialRays)}, frame{0}, stepSize{settings.stepSize}, seed{settings.seed},
+      totalSteps{0}, rhsEvaluations{0}, backend{settings.backend}, precision{settings.precision},
+      trails{rays.size(), settings.trails}, recycled{0},
+      adaptiveSettings{settings.adaptive}, recorder{nullptr}, checkpoints{nullptr} {
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        rays[i].trailSlot = i;
+        rays[i].recordPosition(trails);
+    }
+
+    // Latest start first so activation pops from the back
+    pending.resize(rays.size());
+    for (std::size_t i{0}; i < rays.size(); ++i) {
+        pending[i] = rays.size() - 1 - i;
+    }
+    std::stable_sort(pending.begin(), pending.end(), [this](std::size_t a, std::size_t b) {
+        return rays[a].startFrame > rays[b].startFrame;
+    });
+    active.reserve(rays.size());
+    frozen.reserve(rays.size());
+
+    if (backend == Backend::ADAPTIVE) {
+        adaptive.resize(rays.size());
+    }
+    if (backend == Backend::CARTESIAN) {
+        cartesian.reserve(rays.size());
+        for (const Ray& ray : rays) {
+            cartesian.push_back(Physics::toCartesian(ray));
+        }
+    }
+    if (settings.threads != 1) {
+        pool = std::make_unique<ThreadPool>(settings.threads);
+    }
+}
+
+void Simulator::reserve(std::size_t count) {
+    if (count <= capacity()) {
+        return;
+    }
+    rays.reserve(count);
+    trails.resize(count);
+    pending.reserve(count);
+    active.reserve(count);
+    frozen.reserve(count);
+    stepped.reserve(count);
+    if (backend == Backend::BATCH) {
+        batch.reserve(count);
+    } else if (backend == Backend::GEOMETRIZED) {
+        if (precision == Precision::FLOAT) {
+            geoFloat.reserve(count);
+        } else {
+            geoDouble.reserve(count);
+        }
+    } else if (backend == Backend::ADAPTIVE) {
+        adaptive.resize(count);
+    } else if (backend == Backend::CARTESIAN) {
+        cartesian.reserve(count);
+    }
+}
+
+std::size_t Simulator::spawn(const std::vector<Ray>& burst) {
+    PROFILE_SCOPE("Simulator::spawn");
+    if (recorder || checkpoints) {
+        std::cerr << "Rays cannot be spawned while recording or checkpointing\n";
+        return 0;
+    }
+
+    // Unused slots first, then the longest-finished rays
+    const std::size_t unused{std::min(burst.size(), capacity() - rays.size())};
+    const std::size_t reused{std::min(burst.size() - unused, frozen.size())};
+    for (std::size_t i{0}; i < unused; ++i) {
+        place(rays.size(), burst[i]);
+    }
+    for (std::size_t i{0}; i < reused; ++i) {
+        place(frozen[i], burst[unused + i]);
+    }
+    frozen.erase(frozen.begin(), frozen.begin() + static_cast<std::ptrdiff_t>(reused));
+    recycled += reused;
+
+    const std::size_t spawned{unused + reused};
+    if (spawned < burst.size()) {
+        std::cerr << "Ray pool full: spawned " << spawned << " of " << burst.size() << " rays\n";
+    }
+    PROFILE_COUNTER("spawned rays", spawned);
+    return spawned;
+}
+
+void Simulator::place(std::size_t id, const Ray& ray) {
+    if (id == rays.size()) {
+        rays.push_back(ray);
+    } else {
+        rays[id] = ray;
+    }
+    Ray& placed{rays[id]};
+    placed.trailSlot = id;
+    placed.startFrame = frame;
+    trails.clear(id);
+    placed.recordPosition(trails);
+
+    if (backend == Backend::ADAPTIVE) {
+        adaptive[id] = Physics::AdaptiveState{};
+    } else if (backend == Backend::CARTESIAN) {
+        if (id == cartesian.size()) {
+            cartesian.push_back(Physics::toCartesian(placed));
+        } else {
+            cartesian[id] = Physics::toCartesian(placed);
+        }
+    }
+    activate(id);
+}
+
+int Simulator::threadCount() const {
+    return pool ? pool->size() : 1;
+}
+
+int Simulator::step() {
+    PROFILE_SCOPE("Simulator::step");
+    activateStarted();
+    PROFILE_COUNTER("active rays", active.size());
+
+    // Rays are independent, so any partition gives identical results
+    std::atomic<int> steps{0};
+    std::atomic<long long> evaluations{0};
+    if (pool) {
+        pool->parallelFor(active.size(), PARALLEL_CHUNK, [&](std::size_t begin, std::size_t end) {
+            const StepCounts counts{stepRange(begin, end)};
+            steps += counts.steps;
+            evaluations += counts.rhsEvaluations;
+        });
+    } else {
+        const StepCounts counts{stepRange(0, active.size())};
+        steps = counts.steps;
+        evaluations = counts.rhsEvaluations;
+    }
+    totalSteps += steps;
+    rhsEvaluations += evaluations;
+    PROFILE_COUNTER("ray steps", steps.load());
+
+    const std::size_t frozenBefore{frozen.size()};
+    retireFinished();
+    ++frame;
+    if (recorder) {
+        syncAngles();
+        recorder->capture(*this, frozenBefore);
+    }
+    if (checkpoints) {
+        checkpoints->capture(*this);
+    }
+    return steps;
+}
+
+void Simulator::syncAngles() {
+    if (backend != Backend::CARTESIAN) {
+        return;
+    }
+    for (const std::size_t id : active) {
+        Physics::storePolar(cartesian[id], rays[id]);
+    }
+}
+
+void Simulator::activateStarted() {
+    while (!pending.empty() && rays[pending.back()].isActive(frame)) {
+        const std::size_t id{pending.back()};
+        pending.pop_back();
+        activate(id);
+    }
+}
+
+void Simulator::activate(std::size_t id) {
+    active.push_back(id);
+    if (backend == Backend::BATCH) {
+        batch.push(rays[id], id);
+        stepped.push_back(0);
+    } else if (backend == Backend::GEOMETRIZED) {
+        if (precision == Precision::FLOAT) {
+            geoFloat.push(rays[id], id);
+        } else {
+            geoDouble.push(rays[id], id);
+        }
+        stepped.push_back(0);
+    }
+}
+
+void Simulator::retireFinished() {
+    std::size_t i{0};
+    while (i < active.size()) {
+        const Ray& ray{rays[active[i]]};
+        if (!ray.isCaptured() && !ray.hasEscaped(MAX_DISTANCE)) {
+            ++i;
+            continue;
+        }
+
+        if (backend == Backend::CARTESIAN) {
+            Physics::storePolar(cartesian[active[i]], rays[active[i]]);
+        }
+        frozen.push_back(active[i]);
+        active[i] = active.back();
+        active.pop_back();
+        if (backend == Backend::BATCH) {
+            batch.remove(i);
+            stepped.pop_back();
+        } else if (backend == Backend::GEOMETRIZED) {
+            if (precision == Precision::FLOAT) {
+                geoFloat.remove(i);
+            } else {
+                geoDouble.remove(i);
+            }
+            stepped.pop_back();
+        }
+    }
+}
+
+Simulator::StepCounts Simulator::stepRange(std::size_t begin, std::size_t end) {
+    int steps{0};
+    long long evaluations{0};
+    if (backend == Backend::BATCH) {
+        steps = Physics::rk4StepBatch(batch, stepSize, MAX_DISTANCE, frame,
+                                      stepped.data(), begin, end);
+
+        // Publish new state only for rays that moved
+        for (std::size_t i{begin}; i < end; ++i) {
+            if (stepped[i]) {
+                Ray& ray{rays[batch.ids[i]]};
+                batch.store(i, ray);
+                ray.recordPosition(trails);
+                ray.updateDeflection();
+            }
+        }
+        evaluations = 4LL * steps;
+    } else if (backend == Backend::GEOMETRIZED) {
+        return precision == Precision::FLOAT ? stepGeometrized(geoFloat, begin, end)
+                                             : stepGeometrized(geoDouble, begin, end);
+    } else if (backend == Backend::ADAPTIVE) {
+        for (std::size_t i{begin}; i < end; ++i) {
+            const std::size_t id{active[i]};
+            Ray& ray{rays[id]};
+            if (ray.isCaptured() || ray.hasEscaped(MAX_DISTANCE)) {
+                continue;
+            }
+
+            // Each step still covers stepSize of affine parameter; the
+            // solver picks its own steps and dense output fills the step
+            Physics::AdaptiveState& state{adaptive[id]};
+            if (!state.started) {
+                Physics::adaptiveInit(state, ray, stepSize);
+                evaluations += 1;
+            }
+            state.frameLambda += stepSize;
+            evaluations += Physics::adaptiveAdvance(state, ray, state.frameLambda, adaptiveSettings);
+            ray.recordPosition(trails);
+            ray.updateDeflection();
+            ++steps;
+        }
+    } else if (backend == Backend::CARTESIAN) {
+        for (std::size_t i{begin}; i < end; ++i) {
+            const std::size_t id{active[i]};
+            Ray& ray{rays[id]};
+            if (ray.isCaptured() || ray.hasEscaped(MAX_DISTANCE)) {
+                continue;
+            }
+
+            // The trail takes the position as is; angles wait for syncAngles()
+            Physics::CartesianState& state{cartesian[id]};
+            ray.r = Physics::rk4StepCartesian(state, ray.E, stepSize);
+            trails.push(ray.trailSlot, glm::vec2(static_cast<float>(state.x), static_cast<float>(state.y)));
+            ++steps;
+        }
+        evaluations = 4LL * steps;
+    } else {
+        steps = Physics::integrateRays(rays, active.data() + begin, end - begin, stepSize, MAX_DISTANCE,
+                                       frame, trails);
+        evaluations = 4LL * steps;
+    }
+    return {steps, evaluations};
+}
+
+template <typename Real>
+Simulator::StepCounts Simulator::stepGeometrized(GeoBatch<Real>& geo, std::size_t begin, std::size_t end) {
+    const int steps{Physics::rk4StepBatch(geo, stepSize / Units::AFFINE, MAX_DISTANCE, frame,
+                                          stepped.data(), begin, end)};
+
+    // World coordinates only from here on: trails and deflection are SI
+    for (std::size_t i{begin}; i < end; ++i) {
+        if (stepped[i]) {
+            Ray& ray{rays[geo.ids[i]]};
+            geo.store(i, ray);
+            ray.recordPosition(trails);
+            ray.updateDeflection();
+        }
+    }
+    return {steps, 4LL * steps};
+}
+
+} // namespace Simulation
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "dopri.h"
+#include "metric.h"
+#include "physics.h"
+#include "ray.h"
+#include "ray_batch.h"
+#include "thread_pool.h"
+#include "trail_store.h"
+
+namespace Checkpoint {
+    struct Writer;
+}
+
+namespace Recording {
+    struct Recorder;
+}
+
+// Simulation namespace (constants live in constants.h)
+namespace Simulation {
+    // How ray state is integrated each frame
+    enum class Backend {
+        RAY,    // Per-Ray RK4 (reference path)
+        BATCH,  // Structure-of-arrays SIMD RK4 kernel
+        ADAPTIVE, // Dormand-Prince 5(4) with dense output per frame
+        CARTESIAN, // Trig-free RK4 on Cartesian state; angles computed on demand
+        GEOMETRIZED // SIMD RK4 kernel in geometrized units at a chosen precision
+    };
+
+    // Scalar type of the GEOMETRIZED backend's integration state
+    enum class Precision {
+        DOUBLE,
+        FLOAT   // Twice the SIMD width and half the bandwidth; see README
+    };
+
+    // Simulator configuration
+    struct Settings {
+        Backend backend;
+        double stepSize;                      // Affine parameter per step
+        int threads;                          // 1 = calling thread, <= 0 = all cores
+        Physics::AdaptiveSettings adaptive;   // ADAPTIVE backend error control
+        TrailSettings trails;                 // Trail storage policy
+        unsigned seed;                        // Seed for the run's random choices (background stars)
+        Precision precision;                  // GEOMETRIZED backend scalar type
+        Physics::MetricSettings metric;       // Spacetime; applied with Physics::setMetric (RAY backend)
+
+        Settings();
+    };
+
+    // Simulator owns the ray set and advances it one fixed step at a time,
+    // independently of any window or rendering context. frame counts steps
+    // taken; how many steps a displayed frame runs is up to the caller
+    // (see Clock).
+    //
+    // Rays move through three sets: pending (waiting for startFrame),
+    // active (integrated every frame) and frozen (captured or escaped, never
+    // touched again). Per-frame cost scales with the active set only.
+    //
+    // A ray's index in rays is its id and its trail slot, and stays the same
+    // for as long as it lives. reserve() makes room for rays spawned later,
+    // so spawning never moves rays or trails that a renderer is looking at.
+    struct Simulator {
+        std::vector<Ray> rays;
+        int frame;
+        double stepSize;
+        unsigned seed;
+        long long totalSteps;
+        long long rhsEvaluations;
+        Backend backend;
+        Precision precision;
+
+        // Bounded trail storage, one slot per ray (Ray::trailSlot)
+        TrailStore trails;
+
+        // Scheduling sets, as indices into rays
+        std::vector<std::size_t> pending;   // Sorted so the next ray to start is last
+        std::vector<std::size_t> active;    // Compact, unordered
+        std::vector<std::size_t> frozen;    // In the order rays finished; spawn() takes from the front
+        std::size_t recycled;               // Rays spawn() took back out of frozen so far
+
+        // Hot state for the BATCH backend; entry i is the ray active[i]
+        RayBatch batch;
+        std::vector<unsigned char> stepped;
+
+        // Per-ray solver state for the ADAPTIVE backend
+        std::vector<Physics::AdaptiveState> adaptive;
+        Physics::AdaptiveSettings adaptiveSettings;
+
+        // Per-ray state for the CARTESIAN backend. Moving rays keep r current
+        // (capture and escape tests need it) but their phi, v_r, v_phi and
+        // deflection only as of the last syncAngles().
+        std::vector<Physics::CartesianState> cartesian;
+
+        // Hot state for the GEOMETRIZED backend, in geometrized units; the
+        // one matching precision mirrors the active set like batch does
+        GeoBatch<double> geoDouble;
+        GeoBatch<float> geoFloat;
+
+        // Workers for parallel integration (null when single-threaded)
+        std::unique_ptr<ThreadPool> pool;
+
+        // Fed every step when set (not owned)
+        Recording::Recorder* recorder;
+        Checkpoint::Writer* checkpoints;
+
+        // Take ownership of a generated ray set and record starting positions
+        explicit Simulator(std::vector<Ray> initialRays, const Settings& settings = Settings{});
+
+        // Make room for capacity rays in all: the ray array, trail slots and
+        // scheduling sets are allocated now, not when rays are spawned. Call
+        // before anything mirrors the trail store (renderer, pipeline).
+        void reserve(std::size_t capacity);
+
+        // Rays there is room for (reserve(), or the initial ray count)
+        std::size_t capacity() const { return trails.slotCount(); }
+
+        // Start rays at the current position of the simulation: each goes
+        // into an unused slot or, once those run out, replaces the ray that
+        // finished longest ago, reusing its slot and trail storage. Finished
+        // rays are thus the free list, in the order they finished. Rays
+        // start on the next step whatever their startFrame, with their
+        // trails and solver state begun afresh. Returns the number spawned,
+        // which falls short when every slot holds a pending or active ray,
+        // and is 0 while recording or checkpointing (both expect a fixed ray
+        // set).
+        std::size_t spawn(const std::vector<Ray>& burst);
+
+        // Number of threads used by step()
+        int threadCount() const;
+
+        // Simulation time reached (affine parameter)
+        double time() const { return frame * stepSize; }
+
+        // Integrate all active rays by one step
+        // Returns the number of rays advanced
+        int step();
+
+        // Bring the angle-derived fields of moving rays up to date. Only the
+        // CARTESIAN backend defers them; call before reading rays outside
+        // step().
+        void syncAngles();
+
+        // True once every ray has started and been captured or escaped
+        bool finished() const { return pending.empty() && active.empty(); }
+
+    private:
+        struct StepCounts {
+            int steps;
+            long long rhsEvaluations;
+        };
+
+        // Integrate active rays [begin, end) (positions in the active set)
+        StepCounts stepRange(std::size_t begin, std::size_t end);
+
+        // GEOMETRIZED step of entries [begin, end) of geo; converts moved
+        // rays back to SI for their trails
+        template <typename Real>
+        StepCounts stepGeometrized(GeoBatch<Real>& geo, std::size_t begin, std::size_t end);
+
+        // Move rays whose startFrame has come from pending to active
+        void activateStarted();
+
+        // Add a ray to the active set (and the backend's batch)
+        void activate(std::size_t id);
+
+        // Put a new ray in slot id, which is either rays.size() or a
+        // recycled slot, and activate it
+        void place(std::size_t id, const Ray& ray);
+
+        // Move captured and escaped rays from active to frozen
+        void retireFinished();
+    };
+}
@@ -0,0 +1,89 @@
+#include "star_field.h"
+#include "shader.h"
+#include <iostream>
+
+namespace Rendering {
+
+namespace {
+
+// Vertex shader: starBrightness(gl_VertexID, step), with starHash(step)
+// precomputed on the CPU as stepKey
+const char* VERTEX_SHADER{R"(
+#version 130
+in vec2 position;
+uniform uint stepKey;
+out vec4 color;
+
+uint starHash(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+void main() {
+    uint h = starHash(uint(gl_VertexID) ^ stepKey);
+    float b = 0.5 + float(h >> 9) * (1.0 / 16777216.0);
+    color = vec4(b, b, b, 1.0);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 0.0, 1.0);
+}
+)"};
+
+const char* FRAGMENT_SHADER{R"(
+#version 130
+in vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
+)"};
+
+} // namespace
+
+StarField::StarField(const std::vector<glm::vec2>& stars)
+    : count{static_cast<GLsizei>(stars.size())}, program{0}, vao{0}, vbo{0}, stepKeyLocation{-1} {
+    if (!GLEW_VERSION_3_0) {
+        std::cerr << "OpenGL 3.0 not available, using immediate-mode stars\n";
+        return;
+    }
+
+    program = linkProgram("Star", VERTEX_SHADER, FRAGMENT_SHADER);
+    if (program == 0) {
+        return;
+    }
+    stepKeyLocation = glGetUniformLocation(program, "stepKey");
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(stars.size() * sizeof(glm::vec2)),
+                 stars.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+StarField::~StarField() {
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+}
+
+void StarField::draw(int step) {
+    if (count == 0) {
+        return;
+    }
+    glPointSize(2.0f);
+    glUseProgram(program);
+    glUniform1ui(stepKeyLocation, starHash(static_cast<std::uint32_t>(step)));
+    glBindVertexArray(vao);
+    glDrawArrays(GL_POINTS, 0, count);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+} // namespace Rendering
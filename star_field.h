@@ -0,0 +1,53 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace Rendering {
+    // Integer mix (lowbias32); the star shader runs the same steps on uint
+    inline std::uint32_t starHash(std::uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Brightness in [0.5, 1) of star id at a simulation step. Exact in
+    // float, so the shader and the immediate-mode path agree.
+    inline float starBrightness(std::uint32_t id, std::uint32_t step) {
+        const std::uint32_t h{starHash(id ^ starHash(step))};
+        return 0.5f + static_cast<float>(h >> 9) * (1.0f / 16777216.0f);
+    }
+
+    // Retained-mode background stars.
+    // Positions are uploaded once to a static vertex buffer and every star is
+    // drawn with one glDrawArrays. Twinkle is starBrightness of gl_VertexID
+    // and the step, computed in the vertex shader, so a frame costs no CPU
+    // work or uploads however many stars there are, and the same seed and
+    // step always give the same picture.
+    struct StarField {
+        // Upload star positions; check ready() before use
+        explicit StarField(const std::vector<glm::vec2>& stars);
+        ~StarField();
+
+        StarField(const StarField&) = delete;
+        StarField& operator=(const StarField&) = delete;
+
+        // False if the context lacks what the field needs (GL 3.0 shaders)
+        bool ready() const { return program != 0; }
+
+        // Draw every star as it twinkles at a simulation step
+        void draw(int step);
+
+    private:
+        GLsizei count;
+        GLuint program;
+        GLuint vao;
+        GLuint vbo;
+        GLint stepKeyLocation;
+    };
+}
@@ -0,0 +1,32 @@
+# The default scene must give byte-identical results and trails through the
+# per-ray integrator, every batch kernel the CPU supports, and any thread
+# count. All of them run the same RK4 arithmetic in the same order.
+
+include("${CMAKE_CURRENT_LIST_DIR}/common.cmake")
+
+set(run --headless --frames ${TEST_FRAMES} --trails)
+
+run_blackhole(ray ${run} --output ray.csv)
+
+foreach(kernel scalar avx2 avx512)
+    execute_process(
+        COMMAND "${BLACKHOLE}" ${run} --integrator batch --simd ${kernel} --output batch-${kernel}.csv
+        WORKING_DIRECTORY "${WORK_DIR}"
+        RESULT_VARIABLE result
+        OUTPUT_FILE "${WORK_DIR}/batch-${kernel}.log"
+        ERROR_FILE "${WORK_DIR}/batch-${kernel}.log")
+    file(READ "${WORK_DIR}/batch-${kernel}.log" log)
+    if(NOT result EQUAL 0 AND log MATCHES "is not available")
+        message(STATUS "batch --simd ${kernel}: not built for or not supported by this CPU, skipped")
+        continue()
+    elseif(NOT result EQUAL 0)
+        message(FATAL_ERROR "batch --simd ${kernel} exited with ${result}\n${log}")
+    endif()
+    expect_same_run(ray.csv batch-${kernel}.csv)
+endforeach()
+
+run_blackhole(ray-threads ${run} --threads 4 --output ray-threads.csv)
+expect_same_run(ray.csv ray-threads.csv)
+
+run_blackhole(batch-threads ${run} --integrator batch --threads 4 --output batch-threads.csv)
+expect_same_run(ray.csv batch-threads.csv)
@@ -0,0 +1,21 @@
+# A run checkpointed at step k and resumed to step n must give
+# byte-identical results and trails to an uninterrupted n-step run. Step k
+# falls after the point-source emitter starts and before the beam does, so
+# the checkpoint holds active, finished and not yet started rays. The
+# adaptive integrator also carries per-ray solver state across the restart.
+
+include("${CMAKE_CURRENT_LIST_DIR}/common.cmake")
+
+set(split 1300)
+math(EXPR remaining "${TEST_FRAMES} - ${split}")
+
+foreach(integrator ray batch adaptive)
+    run_blackhole(${integrator}-full --headless --frames ${TEST_FRAMES} --trails --integrator ${integrator}
+                  --output ${integrator}-full.csv)
+    run_blackhole(${integrator}-first --headless --frames ${split} --integrator ${integrator}
+                  --checkpoint ${integrator}.ckpt --output ${integrator}-first.csv)
+    # The thread count is not part of the state and may change on resume
+    run_blackhole(${integrator}-resumed --headless --resume ${integrator}.ckpt --frames ${remaining} --trails
+                  --threads 4 --output ${integrator}-resumed.csv)
+    expect_same_run(${integrator}-full.csv ${integrator}-resumed.csv)
+endforeach()
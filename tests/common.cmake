@@ -0,0 +1,47 @@
+# Shared helpers for the regression tests. Each test script runs with
+# -DBLACKHOLE=<path to the executable> -DWORK_DIR=<scratch directory>. All
+# but stars.cmake run only headless modes, so no window or GL context is
+# needed.
+
+if(NOT BLACKHOLE OR NOT WORK_DIR)
+    message(FATAL_ERROR "Run with -DBLACKHOLE=<executable> -DWORK_DIR=<directory>")
+endif()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+# The default scene for enough steps that every emitter has started and
+# most rays have finished
+set(TEST_FRAMES 3000)
+
+# Run the executable in WORK_DIR with the given arguments; its output goes
+# to NAME.log. Fails the test unless it exits with 0.
+function(run_blackhole name)
+    execute_process(
+        COMMAND "${BLACKHOLE}" ${ARGN}
+        WORKING_DIRECTORY "${WORK_DIR}"
+        RESULT_VARIABLE result
+        OUTPUT_FILE "${WORK_DIR}/${name}.log"
+        ERROR_FILE "${WORK_DIR}/${name}.log")
+    if(NOT result EQUAL 0)
+        file(READ "${WORK_DIR}/${name}.log" log)
+        message(FATAL_ERROR "${name}: blackhole ${ARGN} exited with ${result}\n${log}")
+    endif()
+endfunction()
+
+# Fail unless two files in WORK_DIR are byte-identical
+function(expect_same expected actual)
+    execute_process(
+        COMMAND "${CMAKE_COMMAND}" -E compare_files "${WORK_DIR}/${expected}" "${WORK_DIR}/${actual}"
+        RESULT_VARIABLE different)
+    if(different)
+        message(FATAL_ERROR "${actual} differs from ${expected}")
+    endif()
+    message(STATUS "${actual} matches ${expected}")
+endfunction()
+
+# Results and trails of a headless run with --trails
+function(expect_same_run expected actual)
+    expect_same("${expected}" "${actual}")
+    expect_same("${expected}.trails.csv" "${actual}.trails.csv")
+endfunction()
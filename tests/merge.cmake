@@ -0,0 +1,21 @@
+# Shards merged with --merge must give byte-identical results and trails to
+# a single-process run, both when the shards are run one by one and when
+# --shards starts them. Five shards do not divide the default scene's 96
+# rays evenly, so the shards differ in size.
+
+include("${CMAKE_CURRENT_LIST_DIR}/common.cmake")
+
+set(run --headless --frames ${TEST_FRAMES} --trails)
+set(shards 5)
+math(EXPR last "${shards} - 1")
+
+run_blackhole(single ${run} --output single.csv)
+
+foreach(index RANGE ${last})
+    run_blackhole(shard-${index} ${run} --shard ${index}/${shards} --output merged.csv)
+endforeach()
+run_blackhole(merge --merge ${shards} --output merged.csv)
+expect_same_run(single.csv merged.csv)
+
+run_blackhole(shards ${run} --shards ${shards} --output spawned.csv)
+expect_same_run(single.csv spawned.csv)
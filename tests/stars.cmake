@@ -0,0 +1,29 @@
+# The star field drawn from its GPU buffer must capture byte-identical
+# frames to the immediate-mode fallback: both take position from the seed
+# and twinkle from the same hash of star index and step. Unlike the other
+# tests this one needs an OpenGL 3.0 context, and reports itself skipped
+# when there is none.
+
+include("${CMAKE_CURRENT_LIST_DIR}/common.cmake")
+
+set(capture --seed 1 --stars 20000 --capture-size 800x600 --capture-frames 30)
+
+execute_process(
+    COMMAND "${BLACKHOLE}" ${capture} --capture retained.y4m
+    WORKING_DIRECTORY "${WORK_DIR}"
+    RESULT_VARIABLE result
+    OUTPUT_FILE "${WORK_DIR}/retained.log"
+    ERROR_FILE "${WORK_DIR}/retained.log")
+file(READ "${WORK_DIR}/retained.log" log)
+if(NOT result EQUAL 0 AND log MATCHES "Failed to initialize GLFW|Failed to create window|Failed to initialize GLEW")
+    message(STATUS "No OpenGL context: skipped")
+    return()
+elseif(NOT result EQUAL 0)
+    message(FATAL_ERROR "retained: blackhole ${capture} exited with ${result}\n${log}")
+elseif(log MATCHES "using immediate-mode stars")
+    message(STATUS "No OpenGL 3.0, both paths are immediate mode: skipped")
+    return()
+endif()
+
+run_blackhole(immediate ${capture} --immediate-stars --capture immediate.y4m)
+expect_same(retained.y4m immediate.y4m)
@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+    : job{nullptr}, generation{0}, remaining{0}, busyWorkers{0}, stopping{false} {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    for (int i{0}; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    // Worker 0 is the thread that calls parallelFor
+    for (int i{1}; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(std::size_t count, std::size_t chunkSize, const RangeFn& fn) {
+    if (count == 0) {
+        return;
+    }
+    chunkSize = std::max<std::size_t>(1, chunkSize);
+
+    // Single thread or a single chunk: no point waking anyone
+    if (workers.empty() || count <= chunkSize) {
+        fn(0, count);
+        return;
+    }
+
+    // Deal chunks round-robin so every worker starts with local work
+    std::size_t chunkCount{0};
+    for (std::size_t begin{0}; begin < count; begin += chunkSize) {
+        Queue& queue{*queues[chunkCount % queues.size()]};
+        std::lock_guard<std::mutex> lock{queue.mutex};
+        queue.chunks.push_back({begin, std::min(count, begin + chunkSize)});
+        ++chunkCount;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        job = &fn;
+        remaining = chunkCount;
+        busyWorkers = static_cast<int>(workers.size());
+        ++generation;
+    }
+    wake.notify_all();
+
+    runChunks(0);
+
+    // Wait for the last chunks and for every worker to let go of the job
+    std::unique_lock<std::mutex> lock{mutex};
+    done.wait(lock, [this] { return remaining == 0 && busyWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::workerLoop(int index) {
+    unsigned long seen{0};
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        runChunks(index);
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            --busyWorkers;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::runChunks(int index) {
+    Chunk chunk;
+    while (popLocal(index, chunk) || steal(index, chunk)) {
+        (*job)(chunk.begin, chunk.end);
+        remaining.fetch_sub(1);
+    }
+}
+
+bool ThreadPool::popLocal(int index, Chunk& chunk) {
+    Queue& queue{*queues[static_cast<std::size_t>(index)]};
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (queue.chunks.empty()) {
+        return false;
+    }
+    chunk = queue.chunks.front();
+    queue.chunks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(int thief, Chunk& chunk) {
+    const std::size_t n{queues.size()};
+    for (std::size_t offset{1}; offset < n; ++offset) {
+        Queue& victim{*queues[(static_cast<std::size_t>(thief) + offset) % n]};
+        std::lock_guard<std::mutex> lock{victim.mutex};
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
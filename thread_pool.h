@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker pool with per-worker task queues and work stealing.
+// parallelFor splits [0, count) into fixed chunks, deals them round-robin
+// to the workers, and idle workers steal chunks from the back of other
+// queues. The calling thread takes part as worker 0.
+struct ThreadPool {
+    // Chunk callback: process [begin, end)
+    using RangeFn = std::function<void(std::size_t begin, std::size_t end)>;
+
+    // threadCount <= 0 uses the hardware concurrency
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Run fn over [0, count) in chunks of chunkSize; blocks until done
+    void parallelFor(std::size_t count, std::size_t chunkSize, const RangeFn& fn);
+
+    // Number of threads taking part (including the caller)
+    int size() const { return static_cast<int>(queues.size()); }
+
+private:
+    struct Chunk {
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const RangeFn* job;
+    unsigned long generation;
+    std::atomic<std::size_t> remaining;
+    int busyWorkers;
+    bool stopping;
+
+    void workerLoop(int index);
+
+    // Drain own queue, then steal until every queue is empty
+    void runChunks(int index);
+
+    bool popLocal(int index, Chunk& chunk);
+    bool steal(int thief, Chunk& chunk);
+};
@@ -0,0 +1,420 @@
+#include "trail_index.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+namespace Rendering {
+
+namespace {
+
+// Pixel of a point at the given pixels per meter, anchored at the origin so
+// panning does not shift which points merge. Offset to stay positive, where
+// truncation is floor without a library call.
+struct Pixel {
+    std::int64_t x;
+    std::int64_t y;
+
+    bool operator==(const Pixel& other) const { return x == other.x && y == other.y; }
+    bool operator!=(const Pixel& other) const { return !(*this == other); }
+};
+
+Pixel pixelOf(glm::vec2 p, double scale) {
+    constexpr double OFFSET{1099511627776.0};  // 2^40, still exact to 1/4096 pixel
+    return Pixel{static_cast<std::int64_t>(p.x * scale + OFFSET),
+                 static_cast<std::int64_t>(p.y * scale + OFFSET)};
+}
+
+bool chunkOrder(ChunkRef a, ChunkRef b) {
+    return a.slot < b.slot || (a.slot == b.slot && a.chunk < b.chunk);
+}
+
+// End a walk's open strip, keeping its pending last point
+void closeStrip(TrailWalk& walk, TrailStrips& out, std::uint64_t base) {
+    if (walk.open) {
+        if (walk.pending) {
+            out.points.push_back(static_cast<std::uint32_t>(walk.previous - base));
+        }
+        out.counts.back() = static_cast<std::uint32_t>(out.points.size() - out.firsts.back());
+        walk.open = false;
+    }
+}
+
+} // namespace
+
+void TrailStrips::clear() {
+    slots.clear();
+    firsts.clear();
+    counts.clear();
+    points.clear();
+}
+
+TrailPick::TrailPick()
+    : view{glm::vec2(0.0f), glm::vec2(0.0f), -1.0f},
+      origin{0}, appended{0}, count{0}, next{0}, first{0},
+      walk{0, glm::vec2(0.0f), 0, 0, false, false, false} {
+}
+
+TrailIndex::TrailIndex(const TrailStore& trails, float extent, int cellCount)
+    : ring{trails.settings.capacity / CHUNK + 2},
+      halfExtent{extent},
+      cellsPerSide{std::max(1, cellCount)},
+      cellScale{cellsPerSide / (2.0 * halfExtent)},
+      chunks(trails.slotCount() * ring, Chunk{NONE, glm::vec2(0.0f), glm::vec2(0.0f), -1}),
+      states(trails.slotCount(), SlotState{0, 0, glm::vec2(0.0f)}),
+      cells(static_cast<std::size_t>(cellsPerSide) * cellsPerSide),
+      cellLimits(cells.size(), MIN_CELL_LIMIT),
+      stamps(chunks.size(), 0),
+      stamp{0} {
+}
+
+void TrailIndex::update(const TrailStore& trails, std::size_t slot) {
+    SlotState& state{states[slot]};
+    const std::size_t count{trails.size(slot)};
+    const std::uint64_t appended{trails.appended(slot)};
+    if (count == 0) {
+        // A cleared trail starts over; its grid entries are all stale now
+        std::fill(chunks.begin() + static_cast<std::ptrdiff_t>(slot * ring),
+                  chunks.begin() + static_cast<std::ptrdiff_t>((slot + 1) * ring),
+                  Chunk{NONE, glm::vec2(0.0f), glm::vec2(0.0f), -1});
+        state = SlotState{appended, 0, glm::vec2(0.0f)};
+        return;
+    }
+
+    // New points, plus the previous last point if decimation replaced it
+    std::size_t fresh{static_cast<std::size_t>(std::min<std::uint64_t>(appended - state.appended, count))};
+    if (fresh < count && trails.at(slot, count - fresh - 1) != state.last) {
+        ++fresh;
+    }
+
+    // The segment ending at a point belongs to that point's chunk
+    const std::uint64_t start{appended - count};
+    for (std::size_t i{count - fresh}; i < count; ++i) {
+        const std::uint32_t number{static_cast<std::uint32_t>((start + i) / CHUNK)};
+        const glm::vec2 point{trails.at(slot, i)};
+        addSegment(slot, number, i > 0 ? trails.at(slot, i - 1) : point, point);
+    }
+    state = SlotState{appended, static_cast<std::uint32_t>(count), trails.back(slot)};
+}
+
+bool TrailIndex::live(ChunkRef ref) const {
+    const SlotState& state{states[ref.slot]};
+    return record(ref.slot, ref.chunk).number == ref.chunk && state.count > 0 &&
+           (static_cast<std::uint64_t>(ref.chunk) + 1) * CHUNK > state.appended - state.count;
+}
+
+void TrailIndex::addSegment(std::size_t slot, std::uint32_t number, glm::vec2 a, glm::vec2 b) {
+    Chunk& chunk{record(slot, number)};
+    if (chunk.number != number) {
+        // Reusing the record leaves the old chunk's grid entries stale
+        chunk = Chunk{number, glm::min(a, b), glm::max(a, b), -1};
+    } else {
+        chunk.lo = glm::min(chunk.lo, glm::min(a, b));
+        chunk.hi = glm::max(chunk.hi, glm::max(a, b));
+    }
+
+    const ChunkRef ref{static_cast<std::uint32_t>(slot), number};
+    const double n{static_cast<double>(cellsPerSide)};
+    const double ax{(static_cast<double>(a.x) + halfExtent) * cellScale};
+    const double ay{(static_cast<double>(a.y) + halfExtent) * cellScale};
+    const double bx{(static_cast<double>(b.x) + halfExtent) * cellScale};
+    const double by{(static_cast<double>(b.y) + halfExtent) * cellScale};
+
+    // Leaving the grid: the part inside lies within the clamped box
+    if (std::min({ax, ay, bx, by}) < 0.0 || std::max({ax, ay, bx, by}) >= n) {
+        auto cell = [n](double v) { return static_cast<int>(std::max(0.0, std::min(v, n - 1.0))); };
+        for (int y{cell(std::min(ay, by))}; y <= cell(std::max(ay, by)); ++y) {
+            for (int x{cell(std::min(ax, bx))}; x <= cell(std::max(ax, bx)); ++x) {
+                addToCell(chunk, x, y, ref);
+            }
+        }
+        return;
+    }
+
+    // Walk the cells the segment crosses, one boundary at a time
+    int x{static_cast<int>(ax)};
+    int y{static_cast<int>(ay)};
+    const int endX{static_cast<int>(bx)};
+    const int endY{static_cast<int>(by)};
+    const int stepX{endX > x ? 1 : -1};
+    const int stepY{endY > y ? 1 : -1};
+    const double inf{std::numeric_limits<double>::infinity()};
+    const double dx{std::abs(bx - ax)};
+    const double dy{std::abs(by - ay)};
+    double nextX{dx > 0.0 ? (stepX > 0 ? x + 1 - ax : ax - x) / dx : inf};
+    double nextY{dy > 0.0 ? (stepY > 0 ? y + 1 - ay : ay - y) / dy : inf};
+
+    addToCell(chunk, x, y, ref);
+    for (int steps{std::abs(endX - x) + std::abs(endY - y)}; steps > 0; --steps) {
+        if (y == endY || (x != endX && nextX < nextY)) {
+            x += stepX;
+            nextX += 1.0 / dx;
+        } else {
+            y += stepY;
+            nextY += 1.0 / dy;
+        }
+        addToCell(chunk, x, y, ref);
+    }
+}
+
+void TrailIndex::addToCell(Chunk& chunk, int x, int y, ChunkRef ref) {
+    // Consecutive segments mostly stay in one cell
+    const int id{y * cellsPerSide + x};
+    if (chunk.lastCell == id) {
+        return;
+    }
+    chunk.lastCell = id;
+
+    std::vector<ChunkRef>& cell{cells[static_cast<std::size_t>(id)]};
+    std::size_t& limit{cellLimits[static_cast<std::size_t>(id)]};
+    if (cell.size() >= limit) {
+        cell.erase(std::remove_if(cell.begin(), cell.end(), [this](ChunkRef e) { return !live(e); }), cell.end());
+        limit = std::max(MIN_CELL_LIMIT, 2 * cell.size());
+    }
+    cell.push_back(ref);
+}
+
+void TrailIndex::query(const View& view, std::vector<ChunkRef>& out) {
+    // Stamps mark chunks already seen through another cell
+    if (++stamp == 0) {
+        std::fill(stamps.begin(), stamps.end(), 0);
+        stamp = 1;
+    }
+
+    auto cell = [this](float v) {
+        const double c{std::floor((static_cast<double>(v) + halfExtent) * cellScale)};
+        return static_cast<int>(std::max(0.0, std::min(c, static_cast<double>(cellsPerSide - 1))));
+    };
+    const std::size_t begin{out.size()};
+    for (int y{cell(view.lo.y)}; y <= cell(view.hi.y); ++y) {
+        for (int x{cell(view.lo.x)}; x <= cell(view.hi.x); ++x) {
+            for (const ChunkRef ref : cells[static_cast<std::size_t>(y * cellsPerSide + x)]) {
+                std::uint32_t& seen{stamps[ref.slot * ring + ref.chunk % ring]};
+                if (seen == stamp || !live(ref)) {
+                    continue;
+                }
+                seen = stamp;
+                const Chunk& chunk{record(ref.slot, ref.chunk)};
+                if (view.overlaps(chunk.lo, chunk.hi)) {
+                    out.push_back(ref);
+                }
+            }
+        }
+    }
+    std::sort(out.begin() + static_cast<std::ptrdiff_t>(begin), out.end(), chunkOrder);
+}
+
+void TrailIndex::query(std::size_t slot, const View& view, std::vector<ChunkRef>& out) const {
+    const SlotState& state{states[slot]};
+    if (state.count == 0) {
+        return;
+    }
+    const std::uint64_t first{(state.appended - state.count) / CHUNK};
+    const std::uint64_t last{(state.appended - 1) / CHUNK};
+    for (std::uint64_t number{first}; number <= last; ++number) {
+        const ChunkRef ref{static_cast<std::uint32_t>(slot), static_cast<std::uint32_t>(number)};
+        const Chunk& chunk{record(slot, ref.chunk)};
+        if (chunk.number == ref.chunk && view.overlaps(chunk.lo, chunk.hi)) {
+            out.push_back(ref);
+        }
+    }
+}
+
+void TrailIndex::visit(const TrailStore& trails, std::size_t slot, std::uint32_t number,
+                       const View& view, std::uint64_t base, TrailWalk& walk, TrailStrips& out) const {
+    const bool lod{view.pixel > 0.0f};
+    const double scale{lod ? 1.0 / view.pixel : 0.0};
+    const std::uint64_t appended{trails.appended(slot)};
+    const std::uint64_t start{appended - trails.size(slot)};
+
+    // A run starts at the chunk's joining point, as far as the trail still
+    // holds it
+    if (!walk.running) {
+        const std::uint64_t lo{std::max(start, std::uint64_t{number} * CHUNK - (number > 0 ? 1 : 0))};
+        if (lo >= appended) {
+            return;
+        }
+        walk.previous = lo;
+        walk.previousPoint = trails.at(slot, static_cast<std::size_t>(lo - start));
+        walk.running = true;
+    }
+
+    // A strip stays open while segments touch the view; within it, a point
+    // in the same pixel as the last one kept waits in pending
+    auto step = [&](std::uint64_t ordinal, glm::vec2 point, bool inView) {
+        if (!inView) {
+            closeStrip(walk, out, base);
+        } else {
+            if (!walk.open) {
+                out.slots.push_back(static_cast<std::uint32_t>(slot));
+                out.firsts.push_back(static_cast<std::uint32_t>(out.points.size()));
+                out.counts.push_back(0);
+                out.points.push_back(static_cast<std::uint32_t>(walk.previous - base));
+                const Pixel kept{pixelOf(walk.previousPoint, scale)};
+                walk.keptX = kept.x;
+                walk.keptY = kept.y;
+                walk.open = true;
+            }
+            const Pixel pixel{pixelOf(point, scale)};
+            walk.pending = lod && pixel == Pixel{walk.keptX, walk.keptY};
+            if (!walk.pending) {
+                out.points.push_back(static_cast<std::uint32_t>(ordinal - base));
+                walk.keptX = pixel.x;
+                walk.keptY = pixel.y;
+            }
+        }
+        walk.previous = ordinal;
+        walk.previousPoint = point;
+    };
+
+    const std::uint64_t from{std::max(walk.previous + 1, std::uint64_t{number} * CHUNK)};
+    const std::uint64_t to{std::min(appended, (std::uint64_t{number} + 1) * CHUNK)};
+    if (from >= to) {
+        return;
+    }
+    const Chunk& chunk{record(slot, number)};
+    if (lod && pixelOf(chunk.lo, scale) == pixelOf(chunk.hi, scale)) {
+        // The whole chunk lies in one pixel that touches the view: only its
+        // last point matters
+        step(to - 1, trails.at(slot, static_cast<std::size_t>(to - 1 - start)), true);
+        return;
+    }
+    for (std::uint64_t ordinal{from}; ordinal < to; ++ordinal) {
+        const glm::vec2 point{trails.at(slot, static_cast<std::size_t>(ordinal - start))};
+        step(ordinal, point, view.overlaps(glm::min(walk.previousPoint, point), glm::max(walk.previousPoint, point)));
+    }
+}
+
+void TrailIndex::select(const TrailStore& trails, const std::vector<ChunkRef>& refs,
+                        const View& view, TrailStrips& out) const {
+    // Runs of consecutive chunks of one trail are walked segment by segment
+    TrailWalk walk{0, glm::vec2(0.0f), 0, 0, false, false, false};
+    std::uint64_t base{0};
+    for (std::size_t i{0}; i < refs.size(); ++i) {
+        const std::uint32_t slot{refs[i].slot};
+        if (i == 0 || slot != refs[i - 1].slot || refs[i].chunk != refs[i - 1].chunk + 1) {
+            closeStrip(walk, out, base);
+            walk.running = false;
+            base = trails.appended(slot) - trails.size(slot);
+        }
+        visit(trails, slot, refs[i].chunk, view, base, walk, out);
+    }
+    closeStrip(walk, out, base);
+}
+
+void TrailIndex::extend(const TrailStore& trails, std::size_t slot, const View& view,
+                        TrailPick& pick, TrailStrips& out) const {
+    const std::size_t count{trails.size(slot)};
+    const std::uint64_t appended{trails.appended(slot)};
+    const std::uint64_t start{appended - count};
+    TrailStrips& kept{pick.strips};
+
+    // Start over for another view, when the trail was cleared (it holds
+    // fewer points than it gained), or when the ring buffer dropped the
+    // point the walk would go on from
+    const std::uint64_t grown{std::min<std::uint64_t>(trails.settings.capacity,
+                                                      pick.count + (appended - pick.appended))};
+    if (view != pick.view || count != grown || pick.next < start / CHUNK ||
+        (pick.walk.running && pick.walk.previous < start)) {
+        pick.view = view;
+        pick.origin = start;
+        pick.next = static_cast<std::uint32_t>(start / CHUNK);
+        pick.first = 0;
+        pick.walk = TrailWalk{0, glm::vec2(0.0f), 0, 0, false, false, false};
+        kept.clear();
+    }
+    pick.appended = appended;
+    pick.count = static_cast<std::uint32_t>(count);
+    if (count == 0) {
+        return;
+    }
+
+    // Trim what the ring buffer dropped. The first strip left starts at the
+    // oldest point, as picking afresh would: it takes the slot of the last
+    // point dropped from it.
+    const std::uint32_t oldest{static_cast<std::uint32_t>(start - pick.origin)};
+    while (pick.first < kept.counts.size() && kept.points[kept.firsts[pick.first]] < oldest) {
+        const std::size_t s{pick.first};
+        const bool open{s + 1 == kept.counts.size() && pick.walk.open};
+        const std::size_t end{open ? kept.points.size() : kept.firsts[s] + kept.counts[s]};
+        std::size_t i{kept.firsts[s]};
+        while (i < end && kept.points[i] < oldest) {
+            ++i;
+        }
+        if (!open && (i == end || (end - i == 1 && kept.points[i] == oldest))) {
+            ++pick.first;
+            continue;
+        }
+        if (i == end || kept.points[i] != oldest) {
+            kept.points[--i] = oldest;
+        }
+        if (!open) {
+            kept.counts[s] = static_cast<std::uint32_t>(end - i);
+        }
+        kept.firsts[s] = static_cast<std::uint32_t>(i);
+    }
+
+    // Compact once the dropped part outweighs the rest, so trimming costs
+    // time proportional to the points dropped
+    const std::size_t garbage{pick.first < kept.counts.size() ? kept.firsts[pick.first] : kept.points.size()};
+    if (garbage > 0 && 2 * garbage >= kept.points.size()) {
+        const auto strips = static_cast<std::ptrdiff_t>(pick.first);
+        kept.slots.erase(kept.slots.begin(), kept.slots.begin() + strips);
+        kept.firsts.erase(kept.firsts.begin(), kept.firsts.begin() + strips);
+        kept.counts.erase(kept.counts.begin(), kept.counts.begin() + strips);
+        kept.points.erase(kept.points.begin(), kept.points.begin() + static_cast<std::ptrdiff_t>(garbage));
+        for (std::uint32_t& f : kept.firsts) {
+            f -= static_cast<std::uint32_t>(garbage);
+        }
+        for (std::uint32_t& p : kept.points) {
+            p -= oldest;
+        }
+        pick.origin = start;
+        pick.first = 0;
+    }
+
+    // Walk the chunks completed since the last call; the chunk holding the
+    // last point may still change
+    auto walkChunk = [&](std::uint32_t number, std::uint64_t base, TrailWalk& walk, TrailStrips& strips) {
+        const Chunk& chunk{record(slot, number)};
+        if (chunk.number == number && view.overlaps(chunk.lo, chunk.hi)) {
+            visit(trails, slot, number, view, base, walk, strips);
+        } else {
+            closeStrip(walk, strips, base);
+            walk.running = false;
+        }
+    };
+    const std::uint32_t last{static_cast<std::uint32_t>((appended - 1) / CHUNK)};
+    for (; pick.next < last; ++pick.next) {
+        walkChunk(pick.next, pick.origin, pick.walk, kept);
+    }
+
+    // Kept strips, renumbered from the oldest point, then the rest of the
+    // trail walked from where the pick stands
+    const std::uint32_t shift{static_cast<std::uint32_t>(start - pick.origin)};
+    for (std::size_t s{pick.first}; s < kept.counts.size(); ++s) {
+        const std::size_t end{s + 1 == kept.counts.size() && pick.walk.open ? kept.points.size()
+                                                                              : kept.firsts[s] + kept.counts[s]};
+        out.slots.push_back(static_cast<std::uint32_t>(slot));
+        out.firsts.push_back(static_cast<std::uint32_t>(out.points.size()));
+        out.counts.push_back(kept.counts[s]);
+        for (std::size_t i{kept.firsts[s]}; i < end; ++i) {
+            out.points.push_back(kept.points[i] - shift);
+        }
+    }
+    TrailWalk walk{pick.walk};
+    for (std::uint32_t number{pick.next}; number <= last; ++number) {
+        walkChunk(number, start, walk, out);
+    }
+    closeStrip(walk, out, start);
+}
+
+std::size_t TrailIndex::entries() const {
+    std::size_t total{0};
+    for (const std::vector<ChunkRef>& cell : cells) {
+        total += cell.size();
+    }
+    return total;
+}
+
+} // namespace Rendering
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "constants.h"
+#include "trail_store.h"
+
+// Culling and level of detail for trail drawing, kept free of GL so it can
+// be benchmarked without a window
+namespace Rendering {
+    // Visible part of the plane and the size of one screen pixel in it
+    struct View {
+        glm::vec2 lo;
+        glm::vec2 hi;
+        float pixel;   // Meters per pixel; 0 keeps every point
+
+        bool overlaps(glm::vec2 boxLo, glm::vec2 boxHi) const {
+            return boxLo.x <= hi.x && boxHi.x >= lo.x && boxLo.y <= hi.y && boxHi.y >= lo.y;
+        }
+
+        bool operator==(const View& other) const {
+            return lo == other.lo && hi == other.hi && pixel == other.pixel;
+        }
+        bool operator!=(const View& other) const { return !(*this == other); }
+    };
+
+    // A chunk of one trail (see TrailIndex)
+    struct ChunkRef {
+        std::uint32_t slot;
+        std::uint32_t chunk;
+    };
+
+    // Trail points picked for drawing, as line strips of trail indices
+    // (0 = oldest point of the trail)
+    struct TrailStrips {
+        std::vector<std::uint32_t> slots;    // Trail of each strip
+        std::vector<std::uint32_t> firsts;   // First entry of each strip in points
+        std::vector<std::uint32_t> counts;   // Entries in each strip
+        std::vector<std::uint32_t> points;
+
+        void clear();
+    };
+
+    // Where a walk along one trail's points stands (see TrailIndex::select)
+    struct TrailWalk {
+        std::uint64_t previous;   // Ordinal (TrailStore::appended() numbering) of the last point visited
+        glm::vec2 previousPoint;
+        std::int64_t keptX;       // Pixel of the last point kept
+        std::int64_t keptY;
+        bool running;             // The last chunk walked touched the view
+        bool open;                // The last strip of the output is open
+        bool pending;             // previous shares that pixel and is kept only if the strip ends
+    };
+
+    // One growing trail's selection, carried from frame to frame by
+    // TrailIndex::extend. Chunks before next no longer change, so their
+    // strips are kept; the last kept strip may still be open.
+    struct TrailPick {
+        View view;                // View it was picked for
+        std::uint64_t origin;     // Ordinal of point 0 in strips
+        std::uint64_t appended;   // TrailStore::appended() and size() at the last extend
+        std::uint32_t count;
+        std::uint32_t next;       // First chunk not yet walked
+        std::size_t first;        // First strip the ring buffer has not dropped
+        TrailWalk walk;
+        TrailStrips strips;
+
+        TrailPick();
+    };
+
+    // Spatial index over trail segments for culling.
+    // Each trail is cut into chunks of CHUNK points in append order; a chunk
+    // also owns the segment joining it to the previous chunk, and keeps a
+    // bounding box that only grows. Chunks are listed in every cell of a
+    // uniform grid their segments cross. update() indexes only the points a
+    // trail gained since its last call, so keeping the index current costs
+    // time proportional to trail growth. Chunks whose points the ring buffer
+    // has dropped go stale and are swept out of a cell when it fills up.
+    struct TrailIndex {
+        static constexpr std::uint32_t CHUNK{16};
+
+        // Empty index for a store's slots over +-halfExtent meters; points
+        // outside still index, into the border cells
+        explicit TrailIndex(const TrailStore& trails,
+                            float halfExtent = static_cast<float>(1.25 * Simulation::MAX_DISTANCE),
+                            int cellsPerSide = Visual::TRAIL_INDEX_CELLS);
+
+        // Index the points a trail gained (or replaced) since the last call
+        void update(const TrailStore& trails, std::size_t slot);
+
+        // Append the chunks of every trail whose box overlaps the view,
+        // sorted by trail and chunk
+        void query(const View& view, std::vector<ChunkRef>& out);
+
+        // The same for one trail, walking its chunks instead of the grid
+        void query(std::size_t slot, const View& view, std::vector<ChunkRef>& out) const;
+
+        // Append the points of the given chunks (grouped by trail in chunk
+        // order, as query() returns them) to out at the view's level of
+        // detail: strips follow the trail while its segments touch the view,
+        // and a point in the same pixel as the last one kept is dropped,
+        // except the last point of a strip
+        void select(const TrailStore& trails, const std::vector<ChunkRef>& chunks,
+                    const View& view, TrailStrips& out) const;
+
+        // Append one trail's points as select() over query(slot, view) would,
+        // but walk only the chunks that gained points since the last call
+        // with the same pick; earlier chunks are final and their strips are
+        // kept in pick, less the points the ring buffer has dropped since.
+        // The pick starts over when the view changes or the trail was cleared.
+        void extend(const TrailStore& trails, std::size_t slot, const View& view,
+                    TrailPick& pick, TrailStrips& out) const;
+
+        // Grid entries, stale ones included (diagnostics)
+        std::size_t entries() const;
+
+    private:
+        struct Chunk {
+            std::uint32_t number;  // Chunk number in the trail, or NONE
+            glm::vec2 lo;
+            glm::vec2 hi;
+            int lastCell;          // Grid cell it was last listed in
+        };
+
+        struct SlotState {
+            std::uint64_t appended;  // TrailStore::appended() at the last update
+            std::uint32_t count;     // TrailStore::size() at the last update
+            glm::vec2 last;          // Last point at the last update
+        };
+
+        static constexpr std::uint32_t NONE{0xffffffffu};
+        static constexpr std::size_t MIN_CELL_LIMIT{64};
+
+        std::size_t ring;                      // Chunk records per slot
+        double halfExtent;
+        int cellsPerSide;
+        double cellScale;                      // Grid cells per meter
+        std::vector<Chunk> chunks;             // slot * ring + chunk % ring
+        std::vector<SlotState> states;
+        std::vector<std::vector<ChunkRef>> cells;
+        std::vector<std::size_t> cellLimits;   // Size at which a cell is swept next
+        std::vector<std::uint32_t> stamps;     // Last query that returned each chunk record
+        std::uint32_t stamp;
+
+        Chunk& record(std::size_t slot, std::uint32_t number) {
+            return chunks[slot * ring + number % ring];
+        }
+        const Chunk& record(std::size_t slot, std::uint32_t number) const {
+            return chunks[slot * ring + number % ring];
+        }
+
+        // A chunk still holds live points and owns its record
+        bool live(ChunkRef ref) const;
+
+        // Walk a chunk that touches the view, appending to out with points
+        // numbered from base; a walk not running starts a new run there
+        void visit(const TrailStore& trails, std::size_t slot, std::uint32_t number,
+                   const View& view, std::uint64_t base, TrailWalk& walk, TrailStrips& out) const;
+
+        // Extend a chunk with the segment a-b and list it in the cells it crosses
+        void addSegment(std::size_t slot, std::uint32_t number, glm::vec2 a, glm::vec2 b);
+        void addToCell(Chunk& chunk, int x, int y, ChunkRef ref);
+    };
+}
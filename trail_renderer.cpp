@@ -0,0 +1,374 @@
+#include "trail_renderer.h"
+#include "constants.h"
+#include "shader.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace Rendering {
+
+namespace {
+
+// Per-ray data texture width (texels); rows are added as needed
+constexpr std::size_t RAY_TEXTURE_WIDTH{1024};
+
+// Vertex shader: recover the ray slot and position within its ring buffer
+// from gl_VertexID, then derive color and fade from the per-ray texel
+// (scenario, deflection, head, count). Matches rayColor() and the alpha
+// ramp of the immediate-mode path.
+const char* VERTEX_SHADER{R"(
+#version 130
+in vec2 position;
+uniform int capacity;
+uniform int textureWidth;
+uniform sampler2D rayData;
+out vec4 color;
+
+void main() {
+    int slot = gl_VertexID / capacity;
+    int phys = gl_VertexID - slot * capacity;
+    vec4 ray = texelFetch(rayData, ivec2(slot % textureWidth, slot / textureWidth), 0);
+    int head = int(ray.z);
+    float count = ray.w;
+    float index = float((phys - head + capacity) % capacity);
+    float alpha = 0.2 + 0.8 * index / max(count - 1.0, 1.0);
+
+    float t = min(1.0, ray.y / 3.14159265);
+    vec3 rgb;
+    if (ray.x < 0.5) {
+        rgb = vec3(t, 0.5 * (1.0 - t), 1.0 - t);      // Parallel: blue to red
+    } else if (ray.x < 1.5) {
+        rgb = vec3(0.5 + 0.5 * t, 1.0, 0.0);          // Point source: green to yellow
+    } else {
+        rgb = vec3(1.0, 0.2, 1.0);                    // Orbiting: magenta
+    }
+    color = vec4(rgb, alpha);
+    gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 0.0, 1.0);
+}
+)"};
+
+const char* FRAGMENT_SHADER{R"(
+#version 130
+in vec4 color;
+
+void main() {
+    gl_FragColor = color;
+}
+)"};
+
+} // namespace
+
+void TrailRenderer::Strips::clear() {
+    ids.clear();
+    counts.clear();
+    offsets.clear();
+    uploaded = 0;
+}
+
+TrailRenderer::TrailRenderer(const TrailStore& trails)
+    : capacity{trails.settings.capacity},
+      slotCount{trails.slotCount()},
+      program{0}, vao{0}, vbo{0}, rayTexture{0},
+      capacityLocation{-1}, rayDataLocation{-1}, rayTextureWidthLocation{-1},
+      mapped{nullptr}, regions{1}, region{0}, fences{},
+      uploaded(trails.slotCount(), 0),
+      rayDataRowLo{0}, rayDataRowHi{0},
+      activeStrips{0, {}, {}, {}, 0, 0}, activePicks(trails.slotCount()), frozenStrips{0, {}, {}, {}, 0, 0},
+      frozenSlots(trails.slotCount(), 0), frozenSeen{0}, frozenRecycled{0},
+      frozenView{glm::vec2(0.0f), glm::vec2(0.0f), -1.0f} {
+    if (!GLEW_VERSION_3_0) {
+        std::cerr << "OpenGL 3.0 not available, using immediate-mode trails\n";
+        return;
+    }
+
+    program = linkProgram("Trail", VERTEX_SHADER, FRAGMENT_SHADER);
+    if (program == 0) {
+        return;
+    }
+    capacityLocation = glGetUniformLocation(program, "capacity");
+    rayDataLocation = glGetUniformLocation(program, "rayData");
+    rayTextureWidthLocation = glGetUniformLocation(program, "textureWidth");
+
+    // One vertex buffer laid out like the TrailStore arena; element lists
+    // join a wrapped ring buffer's ends. Mapped, the buffer holds REGIONS
+    // such arenas back to back.
+    const std::size_t vertexCount{std::max<std::size_t>(1, slotCount * capacity)};
+    const GLsizeiptr bytes{static_cast<GLsizeiptr>(vertexCount * sizeof(glm::vec2))};
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    if (GLEW_ARB_buffer_storage) {
+        const GLbitfield flags{GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT};
+        const GLsizeiptr ringBytes{bytes * static_cast<GLsizeiptr>(REGIONS)};
+        glBufferStorage(GL_ARRAY_BUFFER, ringBytes, nullptr, flags | GL_DYNAMIC_STORAGE_BIT);
+        mapped = static_cast<glm::vec2*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, ringBytes, flags));
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (mapped) {
+        regions = REGIONS;
+        uploaded.assign(regions * slotCount, 0);
+    } else {
+        shadow.resize(vertexCount);
+    }
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenBuffers(1, &activeStrips.buffer);
+    glGenBuffers(1, &frozenStrips.buffer);
+
+    // Per-ray attributes, one RGBA32F texel per ray
+    const std::size_t rows{std::max<std::size_t>(1, (slotCount + RAY_TEXTURE_WIDTH - 1) / RAY_TEXTURE_WIDTH)};
+    rayData.assign(RAY_TEXTURE_WIDTH * rows * 4, 0.0f);
+    glGenTextures(1, &rayTexture);
+    glBindTexture(GL_TEXTURE_2D, rayTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, static_cast<GLsizei>(RAY_TEXTURE_WIDTH),
+                 static_cast<GLsizei>(rows), 0, GL_RGBA, GL_FLOAT, rayData.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+TrailRenderer::~TrailRenderer() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDeleteTextures(1, &rayTexture);
+    glDeleteBuffers(1, &activeStrips.buffer);
+    glDeleteBuffers(1, &frozenStrips.buffer);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+}
+
+void TrailRenderer::uploadSlot(const TrailStore& trails, std::size_t slot) {
+    const std::size_t count{trails.size(slot)};
+    const std::uint64_t appended{trails.appended(slot)};
+    std::uint64_t& done{uploaded[region * slotCount + slot]};
+    if (count == 0) {
+        done = appended;
+        return;
+    }
+
+    // New points since this region's last upload, plus the last point it
+    // had, which decimation may have replaced in place since (any later
+    // replacement hits a new point)
+    const std::size_t fresh{static_cast<std::size_t>(std::min<std::uint64_t>(appended - done, count))};
+    const std::size_t first{count - std::min(count, fresh + 1)};
+    done = appended;
+
+    const std::size_t base{slot * capacity};
+    const std::size_t head{trails.head(slot)};
+    glm::vec2* target{mapped ? mapped + region * slotCount * capacity : shadow.data()};
+    std::size_t lo{capacity};
+    std::size_t hi{0};
+
+    auto write = [&](std::size_t phys, glm::vec2 point) {
+        target[base + phys] = point;
+        lo = std::min(lo, phys);
+        hi = std::max(hi, phys + 1);
+    };
+
+    for (std::size_t i{first}; i < count; ++i) {
+        write((head + i) % capacity, trails.at(slot, i));
+    }
+
+    if (!mapped) {
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        static_cast<GLintptr>((base + lo) * sizeof(glm::vec2)),
+                        static_cast<GLsizeiptr>((hi - lo) * sizeof(glm::vec2)),
+                        shadow.data() + base + lo);
+    }
+}
+
+void TrailRenderer::prepareRay(const Ray& ray, const TrailStore& trails) {
+    const std::size_t slot{ray.trailSlot};
+    uploadSlot(trails, slot);
+
+    float* texel{&rayData[slot * 4]};
+    texel[0] = static_cast<float>(ray.scenario);
+    texel[1] = static_cast<float>(ray.deflection);
+    texel[2] = static_cast<float>(trails.head(slot));
+    texel[3] = static_cast<float>(trails.size(slot));
+
+    const std::size_t row{slot / RAY_TEXTURE_WIDTH};
+    rayDataRowLo = std::min(rayDataRowLo, row);
+    rayDataRowHi = std::max(rayDataRowHi, row + 1);
+}
+
+void TrailRenderer::pick(const TrailStore& trails, const TrailIndex& index, const View& view, Strips& out) {
+    picked.clear();
+    index.select(trails, chunks, view, picked);
+    addPicked(trails, out);
+}
+
+void TrailRenderer::addPicked(const TrailStore& trails, Strips& out) {
+    // Trail index to vertex id: the slot's ring buffer, from its head
+    for (std::size_t s{0}; s < picked.slots.size(); ++s) {
+        const std::size_t slot{picked.slots[s]};
+        const std::size_t base{slot * capacity};
+        const std::size_t head{trails.head(slot)};
+        out.offsets.push_back(reinterpret_cast<const void*>(out.ids.size() * sizeof(GLuint)));
+        out.counts.push_back(static_cast<GLsizei>(picked.counts[s]));
+        for (std::uint32_t k{0}; k < picked.counts[s]; ++k) {
+            const std::size_t i{picked.points[picked.firsts[s] + k]};
+            out.ids.push_back(static_cast<GLuint>(base + (head + i) % capacity));
+        }
+    }
+}
+
+void TrailRenderer::upload(Strips& out) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, out.buffer);
+    if (out.ids.size() > out.allocated) {
+        out.allocated = std::max(out.ids.size(), 2 * out.allocated);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(out.allocated * sizeof(GLuint)),
+                     nullptr, GL_DYNAMIC_DRAW);
+        out.uploaded = 0;
+    }
+    if (out.uploaded < out.ids.size()) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLintptr>(out.uploaded * sizeof(GLuint)),
+                        static_cast<GLsizeiptr>((out.ids.size() - out.uploaded) * sizeof(GLuint)),
+                        out.ids.data() + out.uploaded);
+        out.uploaded = out.ids.size();
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+std::size_t TrailRenderer::draw(const std::vector<Ray>& rays, const TrailStore& trails,
+                         const std::vector<std::size_t>& active, const std::vector<std::size_t>& frozen,
+                         std::size_t recycled, TrailIndex& index, const View& view) {
+    // Take the next region of the ring, waiting only if the GPU may still
+    // read the frame drawn from it REGIONS frames ago
+    region = (region + 1) % regions;
+    if (fences[region]) {
+        glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(fences[region]);
+        fences[region] = nullptr;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // Trails that finished while other regions were written
+    for (const std::size_t slot : settling[region]) {
+        uploadSlot(trails, slot);
+    }
+    settling[region].clear();
+    rayDataRowLo = rayData.size();
+    rayDataRowHi = 0;
+
+    // Recycled rays left the front of frozen and are active again: their
+    // slots no longer hold finished trails, so pick the frozen ones afresh
+    bool repick{view != frozenView};
+    if (recycled != frozenRecycled) {
+        frozenRecycled = recycled;
+        frozenSeen = std::max(frozenSeen, recycled);
+        std::fill(frozenSlots.begin(), frozenSlots.end(), 0);
+        for (std::size_t i{0}; i < frozenSeen - recycled; ++i) {
+            frozenSlots[rays[frozen[i]].trailSlot] = 1;
+        }
+        repick = true;
+    }
+
+    // Finished trails never change again: upload them once to each region,
+    // to the others as their turn comes
+    const std::size_t newlyFrozen{frozenSeen - recycled};
+    for (; frozenSeen < recycled + frozen.size(); ++frozenSeen) {
+        const Ray& ray{rays[frozen[frozenSeen - recycled]]};
+        prepareRay(ray, trails);
+        frozenSlots[ray.trailSlot] = 1;
+        activePicks[ray.trailSlot] = TrailPick{};
+        for (std::size_t r{1}; r < regions; ++r) {
+            settling[(region + r) % regions].push_back(ray.trailSlot);
+        }
+    }
+    for (const std::size_t id : active) {
+        prepareRay(rays[id], trails);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, rayTexture);
+    if (rayDataRowLo < rayDataRowHi) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(rayDataRowLo),
+                        static_cast<GLsizei>(RAY_TEXTURE_WIDTH),
+                        static_cast<GLsizei>(rayDataRowHi - rayDataRowLo), GL_RGBA, GL_FLOAT,
+                        rayData.data() + rayDataRowLo * RAY_TEXTURE_WIDTH * 4);
+    }
+
+    // Frozen trails: through the grid when the view changed, otherwise
+    // only the newly finished ones are added
+    chunks.clear();
+    if (repick) {
+        frozenView = view;
+        frozenStrips.clear();
+        index.query(view, chunks);
+        chunks.erase(std::remove_if(chunks.begin(), chunks.end(),
+                                    [this](ChunkRef ref) { return !frozenSlots[ref.slot]; }),
+                     chunks.end());
+        pick(trails, index, view, frozenStrips);
+    } else if (newlyFrozen < frozen.size()) {
+        for (std::size_t i{newlyFrozen}; i < frozen.size(); ++i) {
+            index.query(rays[frozen[i]].trailSlot, view, chunks);
+        }
+        pick(trails, index, view, frozenStrips);
+    }
+    upload(frozenStrips);
+
+    // Active trails grow every frame: each is walked only where it grew
+    // since the last frame, the rest coming from its pick
+    activeStrips.clear();
+    picked.clear();
+    for (const std::size_t id : active) {
+        const std::size_t slot{rays[id].trailSlot};
+        index.extend(trails, slot, view, activePicks[slot], picked);
+    }
+    addPicked(trails, activeStrips);
+    upload(activeStrips);
+
+    if (!activeStrips.counts.empty() || !frozenStrips.counts.empty()) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glLineWidth(1.5f);
+
+        glUseProgram(program);
+        glUniform1i(capacityLocation, static_cast<GLint>(capacity));
+        glUniform1i(rayTextureWidthLocation, static_cast<GLint>(RAY_TEXTURE_WIDTH));
+        glUniform1i(rayDataLocation, 0);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2),
+                              reinterpret_cast<const void*>(region * slotCount * capacity * sizeof(glm::vec2)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (const Strips* strips : {&frozenStrips, &activeStrips}) {
+            if (!strips->counts.empty()) {
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, strips->buffer);
+                glMultiDrawElements(GL_LINE_STRIP, strips->counts.data(), GL_UNSIGNED_INT,
+                                    strips->offsets.data(), static_cast<GLsizei>(strips->counts.size()));
+            }
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glUseProgram(0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (mapped) {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    return frozenStrips.ids.size() + activeStrips.ids.size();
+}
+
+} // namespace Rendering
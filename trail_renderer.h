@@ -0,0 +1,105 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ray.h"
+#include "trail_index.h"
+#include "trail_store.h"
+
+namespace Rendering {
+    // Retained-mode trail renderer.
+    // Mirrors the TrailStore arena in a GPU vertex buffer and uploads only
+    // points that changed. With ARB_buffer_storage the buffer is persistently
+    // mapped and holds REGIONS copies of the arena, used in turn with one
+    // fence each, so a frame only waits for the GPU to finish the frame drawn
+    // REGIONS frames ago. Each frame it draws the points a
+    // TrailIndex picks for the view, as element lists into that buffer, so
+    // what is drawn tracks what is on screen rather than the trail history.
+    // Scenario color and alpha fade are computed in the vertex shader from
+    // gl_VertexID and a small per-ray texture.
+    struct TrailRenderer {
+        static constexpr std::size_t REGIONS{3};
+
+        // Create GL objects for a store; check ready() before use
+        explicit TrailRenderer(const TrailStore& trails);
+        ~TrailRenderer();
+
+        TrailRenderer(const TrailRenderer&) = delete;
+        TrailRenderer& operator=(const TrailRenderer&) = delete;
+
+        // False if the context lacks what the renderer needs (GL 3.0 shaders)
+        bool ready() const { return program != 0; }
+
+        // Upload changed points and per-ray attributes, then draw what the
+        // index (current for every trail drawn) shows in view. Only active
+        // rays are visited each frame; rays appended to frozen since the last
+        // call are uploaded once, and frozen trails are picked again only
+        // when the view changes or rays were recycled (recycled is
+        // Simulator::recycled). Returns the number of vertices drawn.
+        std::size_t draw(const std::vector<Ray>& rays, const TrailStore& trails,
+                  const std::vector<std::size_t>& active, const std::vector<std::size_t>& frozen,
+                  std::size_t recycled, TrailIndex& index, const View& view);
+
+    private:
+        // Element lists for one glMultiDrawElements
+        struct Strips {
+            GLuint buffer;
+            std::vector<GLuint> ids;             // Vertex ids, strip after strip
+            std::vector<GLsizei> counts;
+            std::vector<const void*> offsets;    // Byte offset of each strip in buffer
+            std::size_t uploaded;                // Leading ids already in buffer
+            std::size_t allocated;               // Ids buffer can hold
+
+            void clear();
+        };
+
+        std::size_t capacity;     // Points per trail in the store
+        std::size_t slotCount;
+
+        GLuint program;
+        GLuint vao;
+        GLuint vbo;
+        GLuint rayTexture;
+        GLint capacityLocation;
+        GLint rayDataLocation;
+        GLint rayTextureWidthLocation;
+
+        glm::vec2* mapped;        // Persistent mapping, or null when using glBufferSubData
+        std::size_t regions;      // Arena copies in the buffer: REGIONS when mapped, else 1
+        std::size_t region;       // Copy this frame writes and draws
+        GLsync fences[REGIONS];   // Last draw from each copy, waited on before writing it
+        std::vector<glm::vec2> shadow;        // CPU copy when not persistently mapped
+        std::vector<std::uint64_t> uploaded;  // TrailStore::appended() at last upload, per region and slot
+        std::vector<std::size_t> settling[REGIONS];  // Frozen slots a region has not caught up with
+        std::vector<float> rayData;           // Per-ray texel: scenario, deflection, head, count
+        std::size_t rayDataRowLo;             // Texture rows written since last upload
+        std::size_t rayDataRowHi;
+        Strips activeStrips;                  // Active trails, extended each frame
+        std::vector<TrailPick> activePicks;   // Per slot: what earlier frames picked of an active trail
+        Strips frozenStrips;                  // Finished trails, picked per view
+        std::vector<char> frozenSlots;        // Slots whose trails are finished
+        std::size_t frozenSeen;               // Rays ever frozen that were uploaded (recycled included)
+        std::size_t frozenRecycled;           // recycled as of the last draw
+        View frozenView;                      // View frozenStrips were picked for
+        std::vector<ChunkRef> chunks;         // Index query scratch
+        TrailStrips picked;                   // Index selection scratch
+
+        // Copy points of one trail that changed since the current region's
+        // last upload
+        void uploadSlot(const TrailStore& trails, std::size_t slot);
+
+        // Upload a ray's trail and attributes
+        void prepareRay(const Ray& ray, const TrailStore& trails);
+
+        // Pick the points of chunks for the view and append them to out
+        void pick(const TrailStore& trails, const TrailIndex& index, const View& view, Strips& out);
+
+        // Append the strips in picked to out as vertex ids
+        void addPicked(const TrailStore& trails, Strips& out);
+
+        // Copy the ids not yet in out's element buffer
+        void upload(Strips& out);
+    };
+}
@@ -0,0 +1,183 @@
+#include "trail_store.h"
+#include "constants.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+// Half-width of the direction interval from the anchor that keeps a point
+// at distance d within tolerance of the line
+double halfAngle(double d, double tolerance) {
+    if (d <= tolerance) {
+        return M_PI;
+    }
+    return std::asin(tolerance / d);
+}
+
+// Direction of v relative to ref, in (-pi, pi]
+double relativeAngle(glm::vec2 ref, double vx, double vy) {
+    const double cross{static_cast<double>(ref.x) * vy - static_cast<double>(ref.y) * vx};
+    const double dot{static_cast<double>(ref.x) * vx + static_cast<double>(ref.y) * vy};
+    return std::atan2(cross, dot);
+}
+
+// Fixed layout of one slot in a saved store
+struct SlotRecord {
+    std::uint32_t head;
+    std::uint32_t count;
+    std::uint64_t appended;
+    float coneRefX;
+    float coneRefY;
+    float coneLo;
+    float coneHi;
+    std::uint8_t coneOpen;
+    std::uint8_t reserved[7];
+};
+
+static_assert(sizeof(SlotRecord) == 40, "saved trail slot layout");
+
+} // namespace
+
+TrailSettings::TrailSettings()
+    : policy{TrailPolicy::DECIMATE},
+      capacity{Visual::TRAIL_CAPACITY},
+      tolerance{Visual::TRAIL_TOLERANCE} {
+}
+
+TrailStore::TrailStore(std::size_t slotCount, const TrailSettings& trailSettings)
+    : settings{trailSettings} {
+    settings.capacity = std::max<std::size_t>(2, settings.capacity);
+    points.resize(slotCount * settings.capacity);
+    slots.resize(slotCount, Slot{0, 0, 0, false, glm::vec2(1.0f, 0.0f), 0.0f, 0.0f});
+}
+
+void TrailStore::clear(std::size_t slot) {
+    slots[slot].head = 0;
+    slots[slot].count = 0;
+    slots[slot].coneOpen = false;
+}
+
+void TrailStore::resize(std::size_t slotCount) {
+    if (slotCount <= slots.size()) {
+        return;
+    }
+    points.resize(slotCount * settings.capacity);
+    slots.resize(slotCount, Slot{0, 0, 0, false, glm::vec2(1.0f, 0.0f), 0.0f, 0.0f});
+}
+
+void TrailStore::applyTail(std::size_t slot, const glm::vec2* tail, std::size_t count,
+                           bool replacesLast, std::uint64_t appended) {
+    std::size_t i{0};
+    if (replacesLast && count > 0 && slots[slot].count > 0) {
+        replaceLast(slot, tail[0]);
+        i = 1;
+    }
+    for (; i < count; ++i) {
+        append(slot, tail[i]);
+    }
+    slots[slot].appended = appended;
+    slots[slot].coneOpen = false;
+}
+
+std::size_t TrailStore::bytes() const {
+    return points.capacity() * sizeof(glm::vec2) + slots.capacity() * sizeof(Slot);
+}
+
+bool TrailStore::write(std::FILE* file) const {
+    std::vector<SlotRecord> records(slots.size());
+    for (std::size_t i{0}; i < slots.size(); ++i) {
+        const Slot& s{slots[i]};
+        records[i] = SlotRecord{s.head, s.count, s.appended, s.coneRef.x, s.coneRef.y,
+                                s.coneLo, s.coneHi, static_cast<std::uint8_t>(s.coneOpen), {}};
+    }
+    return std::fwrite(records.data(), sizeof(SlotRecord), records.size(), file) == records.size() &&
+           std::fwrite(points.data(), sizeof(glm::vec2), points.size(), file) == points.size();
+}
+
+bool TrailStore::read(std::FILE* file) {
+    std::vector<SlotRecord> records(slots.size());
+    if (std::fread(records.data(), sizeof(SlotRecord), records.size(), file) != records.size() ||
+        std::fread(points.data(), sizeof(glm::vec2), points.size(), file) != points.size()) {
+        return false;
+    }
+    for (std::size_t i{0}; i < slots.size(); ++i) {
+        const SlotRecord& r{records[i]};
+        if (r.count > settings.capacity || r.head >= settings.capacity) {
+            return false;
+        }
+        slots[i] = Slot{r.head, r.count, r.appended, r.coneOpen != 0, glm::vec2(r.coneRefX, r.coneRefY),
+                        r.coneLo, r.coneHi};
+    }
+    return true;
+}
+
+void TrailStore::push(std::size_t slot, glm::vec2 point) {
+    Slot& s{slots[slot]};
+    if (settings.policy == TrailPolicy::RING || s.count == 0) {
+        append(slot, point);
+        return;
+    }
+
+    if (s.count == 1) {
+        openCone(s, back(slot), point);
+        append(slot, point);
+        return;
+    }
+
+    // Sleeve test: the new point may replace the provisional last point if the
+    // line from the anchor to it stays within tolerance of every dropped point
+    const glm::vec2 anchor{at(slot, s.count - 2)};
+    const double vx{static_cast<double>(point.x) - anchor.x};
+    const double vy{static_cast<double>(point.y) - anchor.y};
+    const double d{std::sqrt(vx * vx + vy * vy)};
+    const double theta{relativeAngle(s.coneRef, vx, vy)};
+
+    if (s.coneOpen && theta >= s.coneLo && theta <= s.coneHi) {
+        const double half{halfAngle(d, settings.tolerance)};
+        s.coneLo = static_cast<float>(std::max<double>(s.coneLo, theta - half));
+        s.coneHi = static_cast<float>(std::min<double>(s.coneHi, theta + half));
+        replaceLast(slot, point);
+        return;
+    }
+
+    // Direction left the cone: commit the provisional point as the new anchor
+    openCone(s, back(slot), point);
+    append(slot, point);
+}
+
+void TrailStore::openCone(Slot& s, glm::vec2 anchor, glm::vec2 point) const {
+    const double vx{static_cast<double>(point.x) - anchor.x};
+    const double vy{static_cast<double>(point.y) - anchor.y};
+    const double d{std::sqrt(vx * vx + vy * vy)};
+    const double half{halfAngle(d, settings.tolerance)};
+
+    s.coneOpen = true;
+    s.coneRef = d > 0.0 ? glm::vec2(static_cast<float>(vx / d), static_cast<float>(vy / d))
+                        : glm::vec2(1.0f, 0.0f);
+    s.coneLo = static_cast<float>(-half);
+    s.coneHi = static_cast<float>(half);
+}
+
+void TrailStore::append(std::size_t slot, glm::vec2 point) {
+    Slot& s{slots[slot]};
+    const std::size_t capacity{settings.capacity};
+    ++s.appended;
+    if (s.count < capacity) {
+        points[slot * capacity + (s.head + s.count) % capacity] = point;
+        ++s.count;
+    } else {
+        // Full: overwrite the oldest point
+        points[slot * capacity + s.head] = point;
+        s.head = static_cast<std::uint32_t>((s.head + 1) % capacity);
+    }
+}
+
+void TrailStore::replaceLast(std::size_t slot, glm::vec2 point) {
+    const Slot& s{slots[slot]};
+    const std::size_t capacity{settings.capacity};
+    points[slot * capacity + (s.head + s.count - 1) % capacity] = point;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// How trail points are kept
+enum class TrailPolicy {
+    RING,      // Keep the most recent points, oldest dropped when full
+    DECIMATE   // Drop points collinear within a tolerance, then ring
+};
+
+// Trail storage configuration
+struct TrailSettings {
+    TrailPolicy policy;
+    std::size_t capacity;  // Maximum points kept per ray (>= 2)
+    float tolerance;       // DECIMATE: max distance of a dropped point from the kept polyline
+
+    TrailSettings();
+};
+
+// Bounded trail storage for every ray in one contiguous arena.
+// Slot i owns points [i * capacity, (i + 1) * capacity) as a ring buffer,
+// so recording never allocates and slots can be written concurrently.
+struct TrailStore {
+    TrailSettings settings;
+
+    // Allocate slotCount empty trails
+    TrailStore(std::size_t slotCount = 0, const TrailSettings& settings = TrailSettings{});
+
+    // Append a point to a trail (may replace the last point when decimating)
+    void push(std::size_t slot, glm::vec2 point);
+
+    // Forget every point in a trail (appended() carries on counting, so
+    // mirrors see the new points as fresh)
+    void clear(std::size_t slot);
+
+    // Grow to slotCount trails, the new ones empty; never shrinks. Mirrors
+    // size themselves from slotCount(), so grow before creating any.
+    void resize(std::size_t slotCount);
+
+    // Mirror points another store gained: overwrite the last point with
+    // tail[0] when replacesLast is set, append the rest without decimation,
+    // and take the source's appended() count
+    void applyTail(std::size_t slot, const glm::vec2* tail, std::size_t count,
+                   bool replacesLast, std::uint64_t appended);
+
+    // Number of points currently stored for a trail
+    std::size_t size(std::size_t slot) const { return slots[slot].count; }
+
+    // i-th point of a trail, 0 = oldest
+    glm::vec2 at(std::size_t slot, std::size_t i) const {
+        const Slot& s{slots[slot]};
+        return points[slot * settings.capacity + (s.head + i) % settings.capacity];
+    }
+
+    // Most recent point of a trail (trail must not be empty)
+    glm::vec2 back(std::size_t slot) const { return at(slot, slots[slot].count - 1); }
+
+    // Physical index of a trail's oldest point within its slot
+    std::size_t head(std::size_t slot) const { return slots[slot].head; }
+
+    // Total points ever appended to a trail (monotonic; replacing the last
+    // point does not count). Lets mirrors such as GPU buffers copy only
+    // what changed since they last looked.
+    std::uint64_t appended(std::size_t slot) const { return slots[slot].appended; }
+
+    // Number of trails
+    std::size_t slotCount() const { return slots.size(); }
+
+    // Bytes held by the arena and slot table
+    std::size_t bytes() const;
+
+    // Write every slot's ring and decimation state to a binary file, or read
+    // it back into a store with the same settings and slot count. Restored
+    // trails continue exactly as the saved ones would have.
+    bool write(std::FILE* file) const;
+    bool read(std::FILE* file);
+
+private:
+    struct Slot {
+        std::uint32_t head;   // Index of the oldest point within the slot
+        std::uint32_t count;  // Points stored
+        std::uint64_t appended; // Points ever appended
+        bool coneOpen;        // Last point is provisional (DECIMATE)
+        glm::vec2 coneRef;    // Reference direction from the anchor
+        float coneLo;         // Allowed direction interval relative to coneRef
+        float coneHi;
+    };
+
+    std::vector<glm::vec2> points;
+    std::vector<Slot> slots;
+
+    void append(std::size_t slot, glm::vec2 point);
+    void replaceLast(std::size_t slot, glm::vec2 point);
+
+    // Start a new direction cone from the second-to-last (anchor) point
+    void openCone(Slot& s, glm::vec2 anchor, glm::vec2 point) const;
+};
@@ -0,0 +1,96 @@
+#include "trail_vertices.h"
+#include "constants.h"
+#include <algorithm>
+
+namespace Rendering {
+
+void TrailVertices::clear() {
+    positions.clear();
+    colors.clear();
+    firsts.clear();
+    counts.clear();
+}
+
+void rayColor(const Ray& ray, float& r, float& g, float& b) {
+    rayColor(ray.scenario, ray.deflection, r, g, b);
+}
+
+void rayColor(RayScenario scenario, double deflection, float& r, float& g, float& b) {
+    const float maxDeflection{static_cast<float>(M_PI)};
+    const float t{std::min(1.0f, static_cast<float>(deflection) / maxDeflection)};
+
+    if (scenario == RayScenario::POINT_SOURCE) {
+        // Point source rays: Green to Yellow gradient
+        r = 0.5f + 0.5f * t;
+        g = 1.0f;
+        b = 0.0f;
+    } else if (scenario == RayScenario::ORBITING) {
+        // Orbiting ray: Bright magenta/purple
+        r = 1.0f;
+        g = 0.2f;
+        b = 1.0f;
+    } else {
+        // Parallel rays: Blue to red gradient
+        r = t;
+        g = 0.5f * (1.0f - t);
+        b = 1.0f - t;
+    }
+}
+
+void buildTrailVertices(const std::vector<Ray>& rays, const TrailStore& trails,
+                        int currentFrame, TrailVertices& out) {
+    out.clear();
+    for (const auto& ray : rays) {
+        // Only draw rays that have been activated
+        const std::size_t trailSize{trails.size(ray.trailSlot)};
+        if (!ray.isActive(currentFrame) || trailSize < 2) {
+            continue;
+        }
+
+        float r, g, b;
+        rayColor(ray, r, g, b);
+
+        // Trail with fading
+        out.firsts.push_back(static_cast<int>(out.positions.size()));
+        out.counts.push_back(static_cast<int>(trailSize));
+        for (size_t i{0}; i < trailSize; ++i) {
+            const float alpha{0.2f + 0.8f * static_cast<float>(i) / static_cast<float>(trailSize - 1)};
+            out.positions.push_back(trails.at(ray.trailSlot, i));
+            out.colors.push_back(glm::vec4(r, g, b, alpha));
+        }
+    }
+}
+
+void buildTrailVertices(const std::vector<Ray>& rays, const TrailStore& trails, int currentFrame,
+                        const TrailIndex& index, const View& view, TrailVertices& out) {
+    out.clear();
+    std::vector<ChunkRef> chunks;
+    std::vector<const Ray*> owners(trails.slotCount(), nullptr);
+    for (const auto& ray : rays) {
+        if (ray.isActive(currentFrame) && trails.size(ray.trailSlot) >= 2) {
+            owners[ray.trailSlot] = &ray;
+            index.query(ray.trailSlot, view, chunks);
+        }
+    }
+    TrailStrips strips;
+    index.select(trails, chunks, view, strips);
+
+    // Same colors and fading as the full trails
+    for (std::size_t s{0}; s < strips.slots.size(); ++s) {
+        const std::size_t slot{strips.slots[s]};
+        const float last{static_cast<float>(trails.size(slot) - 1)};
+        float r, g, b;
+        rayColor(*owners[slot], r, g, b);
+
+        out.firsts.push_back(static_cast<int>(out.positions.size()));
+        out.counts.push_back(static_cast<int>(strips.counts[s]));
+        for (std::uint32_t k{0}; k < strips.counts[s]; ++k) {
+            const std::uint32_t i{strips.points[strips.firsts[s] + k]};
+            const float alpha{0.2f + 0.8f * static_cast<float>(i) / last};
+            out.positions.push_back(trails.at(slot, i));
+            out.colors.push_back(glm::vec4(r, g, b, alpha));
+        }
+    }
+}
+
+} // namespace Rendering
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "ray.h"
+#include "trail_index.h"
+#include "trail_store.h"
+
+// CPU side of the immediate-mode trail path, kept free of GL so it can be
+// benchmarked without a window
+namespace Rendering {
+    // Line strips for all visible trails: one strip per ray, in the arrays'
+    // order, with per-vertex fading color
+    struct TrailVertices {
+        std::vector<glm::vec2> positions;
+        std::vector<glm::vec4> colors;
+        std::vector<int> firsts;      // First vertex of each strip
+        std::vector<int> counts;      // Vertices in each strip
+
+        void clear();
+    };
+
+    // Ray trail base color by scenario and deflection (immediate-mode path;
+    // the retained renderer's shader uses the same formula)
+    void rayColor(const Ray& ray, float& r, float& g, float& b);
+
+    // Same, from a scenario and deflection (replayed rays)
+    void rayColor(RayScenario scenario, double deflection, float& r, float& g, float& b);
+
+    // Rebuild out with the trails of every ray active at currentFrame
+    void buildTrailVertices(const std::vector<Ray>& rays, const TrailStore& trails,
+                            int currentFrame, TrailVertices& out);
+
+    // The same, culled to the view and thinned to its level of detail
+    // through an index kept current for every active ray. A trail may
+    // split into several strips where it leaves the view.
+    void buildTrailVertices(const std::vector<Ray>& rays, const TrailStore& trails, int currentFrame,
+                            const TrailIndex& index, const View& view, TrailVertices& out);
+}
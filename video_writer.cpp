@@ -0,0 +1,213 @@
+#include "video_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace Capture {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// BT.601 limited range in 8-bit fixed point. Chroma takes the sums over a
+// 2x2 block; the offset (128.5 << 10) keeps them positive before the shift.
+unsigned char luma(int r, int g, int b) {
+    return static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+unsigned char chromaU(int r4, int g4, int b4) {
+    return static_cast<unsigned char>((-38 * r4 - 74 * g4 + 112 * b4 + 131584) >> 10);
+}
+
+unsigned char chromaV(int r4, int g4, int b4) {
+    return static_cast<unsigned char>((112 * r4 - 94 * g4 - 18 * b4 + 131584) >> 10);
+}
+
+} // namespace
+
+WriterStats::WriterStats()
+    : frames{0}, encodeSeconds{0.0}, stalls{0}, stallSeconds{0.0}, maxQueued{0} {
+}
+
+VideoWriter::VideoWriter(const std::string& outputTarget, int frameWidth, int frameHeight, int fps,
+                         std::size_t queueDepth)
+    : target{outputTarget}, width{frameWidth}, height{frameHeight},
+      ppm{outputTarget.find('%') != std::string::npos}, opened{false}, file{nullptr}, current{0},
+      stopping{false}, failed{false} {
+    if (ppm) {
+        image = Lensing::Image{width, height};
+    } else {
+        if (width % 2 != 0 || height % 2 != 0) {
+            std::cerr << "Y4M capture needs an even width and height\n";
+            return;
+        }
+        if (target == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            file = stdout;
+        } else {
+            file = std::fopen(target.c_str(), "wb");
+            if (!file) {
+                std::cerr << "Failed to open " << target << " for capture\n";
+                return;
+            }
+        }
+        std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+        planes.resize(static_cast<std::size_t>(width) * height * 3 / 2);
+    }
+
+    const std::size_t bytes{static_cast<std::size_t>(width) * height * 3};
+    buffers.resize(std::max<std::size_t>(1, queueDepth), std::vector<unsigned char>(bytes));
+    for (std::size_t i{buffers.size()}; i > 0; --i) {
+        spare.push_back(i - 1);
+    }
+    opened = true;
+    writer = std::thread(&VideoWriter::writerLoop, this);
+}
+
+VideoWriter::~VideoWriter() {
+    close();
+}
+
+std::vector<unsigned char>& VideoWriter::acquire() {
+    std::unique_lock<std::mutex> lock{mutex};
+    if (spare.empty()) {
+        const Clock::time_point start{Clock::now()};
+        changed.wait(lock, [this] { return !spare.empty(); });
+        ++counters.stalls;
+        counters.stallSeconds += secondsSince(start);
+    }
+    current = spare.back();
+    spare.pop_back();
+    return buffers[current];
+}
+
+void VideoWriter::submit() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        queue.push_back(current);
+        counters.maxQueued = std::max(counters.maxQueued, queue.size());
+    }
+    changed.notify_all();
+}
+
+void VideoWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock{mutex};
+    for (long long index{0};; ++index) {
+        changed.wait(lock, [this] { return !queue.empty() || stopping; });
+        if (queue.empty()) {
+            return;
+        }
+
+        // The buffer stays out of the spare list while it is written
+        const std::size_t id{queue.front()};
+        queue.erase(queue.begin());
+        const bool skip{failed};
+        lock.unlock();
+
+        const Clock::time_point start{Clock::now()};
+        const bool written{skip || writeFrame(buffers[id], index)};
+        const double seconds{secondsSince(start)};
+
+        lock.lock();
+        if (!written) {
+            // Keep draining so the producer never blocks on a dead writer
+            failed = true;
+            std::cerr << "Failed to write capture frame " << index << "\n";
+        }
+        counters.frames += written && !skip ? 1 : 0;
+        counters.encodeSeconds += seconds;
+        spare.push_back(id);
+        changed.notify_all();
+    }
+}
+
+bool VideoWriter::writeFrame(const std::vector<unsigned char>& rgb, long long index) {
+    return ppm ? writePPM(rgb, index) : writeY4M(rgb);
+}
+
+bool VideoWriter::writeY4M(const std::vector<unsigned char>& rgb) {
+    const std::size_t w{static_cast<std::size_t>(width)};
+    const std::size_t h{static_cast<std::size_t>(height)};
+    unsigned char* y{planes.data()};
+    unsigned char* u{y + w * h};
+    unsigned char* v{u + w * h / 4};
+
+    // Two output rows at a time (top down), read from the bottom-up buffer
+    for (std::size_t row{0}; row < h; row += 2) {
+        const unsigned char* top{&rgb[(h - 1 - row) * w * 3]};
+        const unsigned char* bottom{&rgb[(h - 2 - row) * w * 3]};
+        for (std::size_t x{0}; x < w; x += 2) {
+            const unsigned char* p[4]{top + x * 3, top + x * 3 + 3, bottom + x * 3, bottom + x * 3 + 3};
+            int r{0}, g{0}, b{0};
+            for (const unsigned char* px : p) {
+                r += px[0];
+                g += px[1];
+                b += px[2];
+            }
+            y[row * w + x] = luma(p[0][0], p[0][1], p[0][2]);
+            y[row * w + x + 1] = luma(p[1][0], p[1][1], p[1][2]);
+            y[(row + 1) * w + x] = luma(p[2][0], p[2][1], p[2][2]);
+            y[(row + 1) * w + x + 1] = luma(p[3][0], p[3][1], p[3][2]);
+            u[(row / 2) * (w / 2) + x / 2] = chromaU(r, g, b);
+            v[(row / 2) * (w / 2) + x / 2] = chromaV(r, g, b);
+        }
+    }
+
+    static const char FRAME[]{"FRAME\n"};
+    return std::fwrite(FRAME, 1, sizeof(FRAME) - 1, file) == sizeof(FRAME) - 1 &&
+           std::fwrite(planes.data(), 1, planes.size(), file) == planes.size();
+}
+
+bool VideoWriter::writePPM(const std::vector<unsigned char>& rgb, long long index) {
+    const std::size_t rowBytes{static_cast<std::size_t>(width) * 3};
+    for (int row{0}; row < height; ++row) {
+        const unsigned char* source{&rgb[static_cast<std::size_t>(height - 1 - row) * rowBytes]};
+        std::copy(source, source + rowBytes, image.rgb.begin() + static_cast<std::ptrdiff_t>(row * rowBytes));
+    }
+
+    std::vector<char> path(target.size() + 32);
+    std::snprintf(path.data(), path.size(), target.c_str(), static_cast<int>(index));
+    return Lensing::writePPM(path.data(), image);
+}
+
+bool VideoWriter::close() {
+    if (!opened) {
+        return !failed;
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    changed.notify_all();
+    writer.join();
+    opened = false;
+
+    if (file == stdout) {
+        failed = std::fflush(file) != 0 || failed;
+    } else if (file) {
+        failed = std::fclose(file) != 0 || failed;
+    }
+    file = nullptr;
+    if (failed) {
+        std::cerr << "Failed to write capture " << target << "\n";
+    }
+    return !failed;
+}
+
+WriterStats VideoWriter::stats() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return counters;
+}
+
+} // namespace Capture
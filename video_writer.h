@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lensing.h"
+
+// Streaming video export.
+// Frames are rendered into a fixed pool of buffers and handed through a
+// bounded queue to a background thread, which converts and writes them:
+//   FILE.y4m       YUV4MPEG2, 4:2:0 (C420jpeg, BT.601 limited range)
+//   PATTERN%05d    one binary PPM per frame, numbered from 0
+//   -              YUV4MPEG2 on stdout, to pipe into an encoder
+// The producer only waits when every buffer is queued, i.e. when the
+// writer cannot keep up; that wait is reported as backpressure.
+namespace Capture {
+    struct WriterStats {
+        long long frames;       // Frames written
+        double encodeSeconds;   // Writer thread time converting and writing
+        long long stalls;       // acquire() calls that found no free buffer
+        double stallSeconds;    // Producer time spent waiting in them
+        std::size_t maxQueued;  // Deepest the queue got
+
+        WriterStats();
+    };
+
+    struct VideoWriter {
+        // Open the target and start the writer thread; check ok().
+        // Y4M needs an even width and height.
+        VideoWriter(const std::string& target, int width, int height, int fps,
+                    std::size_t queueDepth);
+        ~VideoWriter();
+
+        VideoWriter(const VideoWriter&) = delete;
+        VideoWriter& operator=(const VideoWriter&) = delete;
+
+        bool ok() const { return opened; }
+
+        // Buffer for the next frame: width x height RGB8, rows bottom to top
+        // as glReadPixels returns them. Waits while every buffer is queued.
+        std::vector<unsigned char>& acquire();
+
+        // Queue the acquired buffer for writing
+        void submit();
+
+        // Write everything queued, stop the writer and close the file.
+        // Called by the destructor if needed; returns false on a write error.
+        bool close();
+
+        WriterStats stats() const;
+
+    private:
+        std::string target;
+        int width;
+        int height;
+        bool ppm;               // PPM sequence rather than Y4M
+        bool opened;
+        std::FILE* file;        // Y4M output (stdout for "-")
+
+        std::vector<std::vector<unsigned char>> buffers;
+        std::size_t current;    // Buffer handed out by acquire()
+
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<std::size_t> queue;  // Buffers waiting to be written, oldest first
+        std::vector<std::size_t> spare;  // Buffers free for acquire()
+        bool stopping;
+        bool failed;
+        WriterStats counters;
+        std::thread writer;
+
+        // Writer thread only
+        std::vector<unsigned char> planes;  // Y, U and V of one Y4M frame
+        Lensing::Image image;               // Top-down copy for one PPM
+
+        void writerLoop();
+        bool writeFrame(const std::vector<unsigned char>& rgb, long long index);
+        bool writeY4M(const std::vector<unsigned char>& rgb);
+        bool writePPM(const std::vector<unsigned char>& rgb, long long index);
+    };
+}